@@ -0,0 +1,244 @@
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+
+#include "BenchmarkScenes.h"
+#include "SimdLanes.h"
+#include "FrameProfiler.h"
+
+
+// Headless physics benchmark, no window or GPU needed.
+// Builds each scene, runs a fixed number of ticks and prints the results as JSON.
+//
+// Benchmark [--scene <name|all>] [--ticks <n>] [--backend <name>] [--iterations <n>] [--substeps <n>] [--no-sleep] [--no-continuous] [--no-speculative] [--rays <n>] [--out <file>] [--trace <file>]
+//
+// --substeps switches to substepped solving with that many substeps a tick, --iterations only applies without it
+// --trace writes a Chrome trace of the last ticks run, each tick counts as a frame
+// --no-continuous turns continuous collision off for the bodies a scene asked for it on
+// --no-speculative only makes contacts once shapes overlap and runs a position round per solver iteration
+// --rays casts that many rays down into each scene once it's run, one at a time and then as a batch
+
+struct BenchmarkOptions {
+	std::string scene = "all";
+	int ticks = 1000;
+	enumSolverBackend::type backend = enumSolverBackend::SCALAR;
+	int iterations = -1; // engine default
+	int substeps = 0; // iterations mode
+	bool allowSleeping = true;
+	bool allowContinuous = true;
+	bool allowSpeculative = true;
+	int rays = 0;
+	const char* outPath = nullptr;
+	const char* tracePath = nullptr;
+};
+
+static const char* backendNames[] = { "scalar", "simd", "simd_scalar", "coloured", "islands" };
+
+
+static bool parseBackend(const char* name, enumSolverBackend::type& backend) {
+	for (int i = 0; i < (int)(sizeof(backendNames) / sizeof(backendNames[0])); i++) {
+		if (std::strcmp(name, backendNames[i]) == 0) {
+			backend = (enumSolverBackend::type)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool parseOptions(int argc, char** argv, BenchmarkOptions& options) {
+	for (int i = 1; i < argc; i++) {
+		const char* arg = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if (std::strcmp(arg, "--scene") == 0 && hasValue) options.scene = argv[++i];
+		else if (std::strcmp(arg, "--ticks") == 0 && hasValue) options.ticks = std::atoi(argv[++i]);
+		else if (std::strcmp(arg, "--iterations") == 0 && hasValue) options.iterations = std::atoi(argv[++i]);
+		else if (std::strcmp(arg, "--substeps") == 0 && hasValue) options.substeps = std::atoi(argv[++i]);
+		else if (std::strcmp(arg, "--out") == 0 && hasValue) options.outPath = argv[++i];
+		else if (std::strcmp(arg, "--trace") == 0 && hasValue) options.tracePath = argv[++i];
+		else if (std::strcmp(arg, "--no-sleep") == 0) options.allowSleeping = false;
+		else if (std::strcmp(arg, "--no-continuous") == 0) options.allowContinuous = false;
+		else if (std::strcmp(arg, "--no-speculative") == 0) options.allowSpeculative = false;
+		else if (std::strcmp(arg, "--rays") == 0 && hasValue) options.rays = std::atoi(argv[++i]);
+		else if (std::strcmp(arg, "--backend") == 0 && hasValue) {
+			if (!parseBackend(argv[++i], options.backend)) {
+				std::fprintf(stderr, "unknown backend '%s'\n", argv[i]);
+				return false;
+			}
+		}
+		else {
+			std::fprintf(stderr, "usage: %s [--scene <name|all>] [--ticks <n>] [--backend <scalar|simd|simd_scalar|coloured|islands>] [--iterations <n>] [--substeps <n>] [--no-sleep] [--no-continuous] [--no-speculative] [--rays <n>] [--out <file>] [--trace <file>]\n", argv[0]);
+			return false;
+		}
+	}
+	return options.ticks > 0 && options.rays >= 0;
+}
+
+// Times 'options.rays' random rays fired down into the scene one at a time, then as one batch, and writes them to 'out'
+static void runRaycasts(PhysicsEngine& engine, const BenchmarkOptions& options, std::mt19937& random, FILE* out) {
+	using clock = std::chrono::steady_clock;
+
+	std::uniform_real_distribution<float> jitter(-0.5f, 0.5f);
+
+	// A grid over the middle of the scene in row order, neighbouring rays share most of their path
+	// the way a sensor sweep or a batch of line of sight checks would
+	int gridSize = (int)std::ceil(std::sqrt((float)options.rays));
+	float cellSize = 20.f / gridSize;
+
+	std::vector<Ray> rays(options.rays);
+	for (int i = 0; i < options.rays; i++) {
+		vec3 origin = vec3(-10.f + ((i % gridSize) + 0.5f + jitter(random)) * cellSize, -10.f + ((i / gridSize) + 0.5f + jitter(random)) * cellSize, 20.f);
+		rays[i] = { origin, vec3(jitter(random) * 0.2f, jitter(random) * 0.2f, -1.f), 40.f };
+	}
+
+	std::vector<RaycastHit> hits(options.rays);
+
+	// the first query refreshes the AABB tree, keep that out of the timings
+	RaycastHit hit;
+	engine.raycast(rays[0].origin, rays[0].direction, rays[0].maxDistance, hit);
+
+	clock::time_point start = clock::now();
+	for (int i = 0; i < options.rays; i++) {
+		engine.raycast(rays[i].origin, rays[i].direction, rays[i].maxDistance, hits[i]);
+	}
+	double singleSeconds = std::chrono::duration<double>(clock::now() - start).count();
+
+	start = clock::now();
+	int hitCount = engine.raycastBatch(rays.data(), options.rays, hits.data());
+	double batchSeconds = std::chrono::duration<double>(clock::now() - start).count();
+
+	std::fprintf(out, "      \"raycasts\": { \"rays\": %d, \"hits\": %d, \"singleMs\": %.3f, \"batchMs\": %.3f },\n",
+		options.rays, hitCount, singleSeconds * 1000.0, batchSeconds * 1000.0);
+}
+
+// Runs one scene from scratch and writes its JSON object to 'out'
+static void runScene(const BenchmarkScenes::Scene& scene, const BenchmarkOptions& options, FILE* out) {
+	using clock = std::chrono::steady_clock;
+
+	// both are too big for the stack
+	std::unique_ptr<ECS::ECSManager> ecs = std::make_unique<ECS::ECSManager>();
+	std::unique_ptr<PhysicsEngine> engine = std::make_unique<PhysicsEngine>();
+
+	BenchmarkScenes::initECS(*ecs);
+	engine->setEntityComponentSystemPtr(ecs.get());
+	engine->solverBackend = options.backend;
+	engine->allowSleeping = options.allowSleeping;
+	if (options.iterations > 0) engine->iterations = options.iterations;
+	if (options.substeps > 0) {
+		engine->stepMode = enumStepMode::SUBSTEPS;
+		engine->substeps = options.substeps;
+	}
+	if (!options.allowSpeculative) {
+		engine->speculativeMargin = 0.f;
+		engine->positionIterations = -1;
+	}
+
+	std::mt19937 random(12345);
+	scene.build(*ecs, *engine, random);
+
+	PhysicsSystem* physicsSystem = ecs->getSystem<PhysicsSystem>();
+	physicsSystem->generateInertiaTensors(ecs.get());
+
+	if (!options.allowContinuous) {
+		for (unsigned int i = 0; i < physicsSystem->entityCount; i++) {
+			ecs->getComponent<PhysicsComponent>(physicsSystem->entities[i]).continuous = false;
+		}
+	}
+
+	clock::time_point start = clock::now();
+	for (int i = 0; i < options.ticks; i++) {
+		PROFILE_FRAME();
+		engine->tickPhysics();
+	}
+	double seconds = std::chrono::duration<double>(clock::now() - start).count();
+
+	// Settled scenes should be close to still, whatever speed is left is solver error
+	float speedSum = 0.f;
+	for (unsigned int i = 0; i < physicsSystem->entityCount; i++) {
+		speedSum += glm::length(ecs->getComponent<PhysicsComponent>(physicsSystem->entities[i]).vel);
+	}
+
+	PhysicsProfile profile = engine->profiler.getTotal();
+	auto ms = [](double phaseSeconds) { return phaseSeconds * 1000.0; };
+
+	std::fprintf(out, "    {\n");
+	std::fprintf(out, "      \"scene\": \"%s\",\n", scene.name);
+	std::fprintf(out, "      \"bodies\": %u,\n", physicsSystem->entityCount);
+	std::fprintf(out, "      \"ticks\": %d,\n", options.ticks);
+	std::fprintf(out, "      \"totalMs\": %.3f,\n", ms(seconds));
+	std::fprintf(out, "      \"msPerTick\": %.4f,\n", ms(seconds) / options.ticks);
+	std::fprintf(out, "      \"ticksPerSecond\": %.1f,\n", options.ticks / seconds);
+
+	std::fprintf(out, "      \"phasesMs\": {\n");
+	for (unsigned int i = 0; i < enumPhysicsPhase::COUNT; i++) {
+		enumPhysicsPhase::type phase = (enumPhysicsPhase::type)i;
+		std::fprintf(out, "        \"%s\": %.3f%s\n", PhysicsProfiler::getPhaseName(phase), ms(profile.phaseSeconds[i]), i + 1 < enumPhysicsPhase::COUNT ? "," : "");
+	}
+	std::fprintf(out, "      },\n");
+
+	// totals over the run, per tick averages and the worst tick
+	std::fprintf(out, "      \"counters\": {\n");
+	for (unsigned int i = 0; i < enumPhysicsCounter::COUNT; i++) {
+		enumPhysicsCounter::type counter = (enumPhysicsCounter::type)i;
+		std::fprintf(out, "        \"%s\": { \"total\": %llu, \"averagePerTick\": %.1f, \"max\": %llu }%s\n", PhysicsProfiler::getCounterName(counter),
+			(unsigned long long)profile.counters[i], (double)profile.counters[i] / options.ticks, (unsigned long long)profile.peakCounters[i], i + 1 < enumPhysicsCounter::COUNT ? "," : "");
+	}
+	std::fprintf(out, "      },\n");
+	if (options.rays > 0) runRaycasts(*engine, options, random, out);
+	std::fprintf(out, "      \"contactsPerSecond\": %.0f,\n", profile.counters[enumPhysicsCounter::CONTACTS_GENERATED] / seconds);
+	std::fprintf(out, "      \"sleepingAtEnd\": %d,\n", engine->getIslands().getSleepingCount());
+	std::fprintf(out, "      \"meanSpeedAtEnd\": %.4f\n", physicsSystem->entityCount > 0 ? speedSum / physicsSystem->entityCount : 0.f);
+	std::fprintf(out, "    }");
+}
+
+int main(int argc, char** argv) {
+	PROFILE_THREAD("Main");
+
+	BenchmarkOptions options;
+	if (!parseOptions(argc, argv, options)) return 1;
+
+	FILE* out = stdout;
+	if (options.outPath) {
+		out = std::fopen(options.outPath, "w");
+		if (!out) {
+			std::fprintf(stderr, "couldn't open '%s'\n", options.outPath);
+			return 1;
+		}
+	}
+
+	std::fprintf(out, "{\n");
+	std::fprintf(out, "  \"backend\": \"%s\",\n", backendNames[options.backend]);
+	std::fprintf(out, "  \"substeps\": %d,\n", options.substeps);
+	std::fprintf(out, "  \"simdLanes\": %d,\n", SIMD_LANES);
+	std::fprintf(out, "  \"hardwareThreads\": %u,\n", std::thread::hardware_concurrency());
+	std::fprintf(out, "  \"scenes\": [\n");
+
+	int sceneCount = 0;
+	for (const BenchmarkScenes::Scene& scene : BenchmarkScenes::scenes) {
+		if (options.scene != "all" && options.scene != scene.name) continue;
+
+		if (sceneCount > 0) std::fprintf(out, ",\n");
+		runScene(scene, options, out);
+		sceneCount++;
+	}
+
+	std::fprintf(out, "\n  ]\n}\n");
+	if (out != stdout) std::fclose(out);
+
+	if (options.tracePath && !FrameProfiler::get().writeTrace(options.tracePath)) {
+		std::fprintf(stderr, "couldn't write trace '%s'\n", options.tracePath);
+		return 1;
+	}
+
+	if (sceneCount == 0) {
+		std::fprintf(stderr, "unknown scene '%s'\n", options.scene.c_str());
+		return 1;
+	}
+	return 0;
+}
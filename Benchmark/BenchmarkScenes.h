@@ -0,0 +1,283 @@
+#pragma once
+
+#include <cmath>
+#include <random>
+#include <string>
+
+#include "ECS.h"
+#include "ECSComponents.h"
+#include "PhysicsEngine.h"
+#include "PhysicsSystem.h"
+#include "CollisionSystem.h"
+#include "glmAddon.h"
+
+
+// Procedural stress scenes. Every scene fits in MAX_ENTITIES along with the floor and is seeded,
+// so runs on different machines simulate exactly the same thing.
+namespace BenchmarkScenes {
+	// Registers the components and systems physics needs, same signatures as GameEngine
+	inline void initECS(ECS::ECSManager& ecs) {
+		ecs.init();
+
+		ecs.registerComponent<MeshComponent>();
+		ecs.registerComponent<TransformComponent>();
+		ecs.registerComponent<MaterialComponent>();
+		ecs.registerComponent<PhysicsComponent>();
+		ecs.registerComponent<CollisionComponent>();
+
+		ecs.registerSystem<PhysicsSystem>();
+		ecs.addSystemComponentType<PhysicsSystem, TransformComponent>();
+		ecs.addSystemComponentType<PhysicsSystem, PhysicsComponent>();
+
+		ecs.registerSystem<CollisionSystem>();
+		ecs.addSystemComponentType<CollisionSystem, CollisionComponent>();
+		ecs.addSystemComponentType<CollisionSystem, TransformComponent>();
+	}
+
+	inline void addFloor(ECS::ECSManager& ecs) {
+		ECS::uint floor = ecs.createEntity();
+		ecs.addComponent<TransformComponent>(floor, { vec3(0), quat(1, 0, 0, 0), vec3(20, 20, 1) });
+		ecs.addComponent<CollisionComponent>(floor, { enumGeometry::PLANE });
+	}
+
+	inline ECS::uint addBody(ECS::ECSManager& ecs, enumGeometry::type geometry, vec3 position, quat rotation, vec3 scale, float invMass, vec3 velocity = vec3(0)) {
+		ECS::uint entity = ecs.createEntity();
+		ecs.addComponent<TransformComponent>(entity, { position, rotation, scale });
+		ecs.addComponent<PhysicsComponent>(entity, { velocity, vec3(0), invMass, vec3(0), vec3(0), glm::identity<mat3>() });
+		ecs.addComponent<CollisionComponent>(entity, { geometry });
+		return entity;
+	}
+
+	// Four square pyramids of 30 boxes, tall resting stacks with lots of persistent contacts
+	inline void buildPyramids(ECS::ECSManager& ecs, PhysicsEngine&, std::mt19937&) {
+		addFloor(ecs);
+
+		const int baseSize = 4;
+		const vec2 centres[4] = { vec2(-6, -6), vec2(6, -6), vec2(-6, 6), vec2(6, 6) };
+
+		for (vec2 centre : centres) {
+			for (int layer = 0; layer < baseSize; layer++) {
+				int size = baseSize - layer;
+				float offset = (size - 1) * 0.5f;
+
+				for (int x = 0; x < size; x++) {
+					for (int y = 0; y < size; y++) {
+						vec3 position = vec3(centre.x + x - offset, centre.y + y - offset, 0.5f + layer);
+						addBody(ecs, enumGeometry::BOX, position, quat(1, 0, 0, 0), vec3(1), 1.f);
+					}
+				}
+			}
+		}
+	}
+
+	// 120 spheres dropped from staggered heights, lots of new contacts every tick
+	inline void buildSphereRain(ECS::ECSManager& ecs, PhysicsEngine&, std::mt19937& random) {
+		addFloor(ecs);
+
+		std::uniform_real_distribution<float> jitter(-0.2f, 0.2f);
+		std::uniform_real_distribution<float> height(2.f, 25.f);
+
+		for (int x = 0; x < 10; x++) {
+			for (int y = 0; y < 12; y++) {
+				vec3 position = vec3(x * 1.5f - 7.f + jitter(random), y * 1.5f - 8.f + jitter(random), height(random));
+				addBody(ecs, enumGeometry::SPHERE, position, quat(1, 0, 0, 0), vec3(0.5f), 1.f);
+			}
+		}
+	}
+
+	// 120 boxes and spheres of random sizes and orientations dropped into one heap
+	inline void buildMixedPile(ECS::ECSManager& ecs, PhysicsEngine&, std::mt19937& random) {
+		addFloor(ecs);
+
+		std::uniform_real_distribution<float> size(0.6f, 1.4f);
+		std::uniform_real_distribution<float> spread(-2.f, 2.f);
+		std::uniform_real_distribution<float> angle(0.f, 360.f);
+
+		for (int i = 0; i < 120; i++) {
+			vec3 position = vec3(spread(random), spread(random), 1.f + i * 0.6f);
+
+			if (i % 2 == 0) {
+				quat rotation = eulerToQuat(vec3(angle(random), angle(random), angle(random)));
+				addBody(ecs, enumGeometry::BOX, position, rotation, vec3(size(random), size(random), size(random)), 1.f);
+			}
+			else {
+				addBody(ecs, enumGeometry::SPHERE, position, quat(1, 0, 0, 0), vec3(size(random) * 0.5f), 1.f);
+			}
+		}
+	}
+
+	// 120 capsules and cylinders of random proportions dropped into one heap, every pair goes through GJK
+	inline void buildConvexPile(ECS::ECSManager& ecs, PhysicsEngine&, std::mt19937& random) {
+		addFloor(ecs);
+
+		std::uniform_real_distribution<float> radius(0.25f, 0.6f);
+		std::uniform_real_distribution<float> height(0.8f, 2.f);
+		std::uniform_real_distribution<float> spread(-2.f, 2.f);
+		std::uniform_real_distribution<float> angle(0.f, 360.f);
+
+		for (int i = 0; i < 120; i++) {
+			vec3 position = vec3(spread(random), spread(random), 1.f + i * 0.6f);
+			quat rotation = eulerToQuat(vec3(angle(random), angle(random), angle(random)));
+			float r = radius(random);
+
+			enumGeometry::type geometry = i % 2 == 0 ? enumGeometry::CAPSULE : enumGeometry::CYLINDER;
+			addBody(ecs, geometry, position, rotation, vec3(r, r, height(random)), 1.f);
+		}
+	}
+
+	// 120 random rocks from four hulls, hull against hull with full face manifolds
+	inline void buildHullPile(ECS::ECSManager& ecs, PhysicsEngine&, std::mt19937& random) {
+		addFloor(ecs);
+
+		std::normal_distribution<float> gaussian;
+		std::uniform_real_distribution<float> stretch(0.5f, 1.f);
+		std::uniform_real_distribution<float> spread(-2.f, 2.f);
+		std::uniform_real_distribution<float> angle(0.f, 360.f);
+
+		// points on a squashed sphere, quickhull keeps the DEFAULT_HULL_VERTICES that matter most
+		CollisionSystem* collisionSystem = ecs.getSystem<CollisionSystem>();
+		int rocks[4];
+		for (int& rock : rocks) {
+			vec3 axes = vec3(stretch(random), stretch(random), stretch(random)) * 0.6f;
+
+			std::vector<vec3> points(500);
+			for (vec3& point : points) {
+				point = normalize(vec3(gaussian(random), gaussian(random), gaussian(random))) * axes;
+			}
+
+			rock = collisionSystem->addHull(ConvexHull::build(points.data(), (int)points.size()));
+		}
+
+		for (int i = 0; i < 120; i++) {
+			vec3 position = vec3(spread(random), spread(random), 1.f + i * 0.6f);
+			quat rotation = eulerToQuat(vec3(angle(random), angle(random), angle(random)));
+
+			ECS::uint entity = addBody(ecs, enumGeometry::CONVEX_HULL, position, rotation, vec3(1), 1.f);
+			ecs.getComponent<CollisionComponent>(entity).shapeID = rocks[i % 4];
+		}
+	}
+
+	// 120 boxes and spheres dropped onto rolling terrain of 5000 triangles, the floor catches anything that rolls off
+	inline void buildMeshTerrain(ECS::ECSManager& ecs, PhysicsEngine&, std::mt19937& random) {
+		addFloor(ecs);
+
+		const int cells = 50;
+		const float size = 20.f;
+
+		std::vector<vec3> vertices;
+		for (int x = 0; x <= cells; x++) {
+			for (int y = 0; y <= cells; y++) {
+				vec2 position = vec2(x, y) * (size / cells) - vec2(size * 0.5f);
+				float height = 0.6f + 0.4f * std::sin(position.x * 0.7f) * std::cos(position.y * 0.5f);
+				vertices.push_back(vec3(position, height));
+			}
+		}
+
+		std::vector<unsigned int> indices;
+		for (int x = 0; x < cells; x++) {
+			for (int y = 0; y < cells; y++) {
+				unsigned int corner = x * (cells + 1) + y;
+				unsigned int quad[4] = { corner, corner + cells + 1, corner + cells + 2, corner + 1 };
+				indices.insert(indices.end(), { quad[0], quad[1], quad[2], quad[0], quad[2], quad[3] });
+			}
+		}
+
+		ECS::uint terrain = ecs.createEntity();
+		ecs.addComponent<TransformComponent>(terrain, { vec3(0), quat(1, 0, 0, 0), vec3(1) });
+		ecs.addComponent<CollisionComponent>(terrain, { enumGeometry::TRIANGLE_MESH, ecs.getSystem<CollisionSystem>()->addTriangleMesh(TriangleMesh::build(vertices, indices)) });
+
+		std::uniform_real_distribution<float> spread(-6.f, 6.f);
+		std::uniform_real_distribution<float> angle(0.f, 360.f);
+
+		for (int i = 0; i < 120; i++) {
+			vec3 position = vec3(spread(random), spread(random), 3.f + i * 0.1f);
+
+			if (i % 2 == 0) {
+				quat rotation = eulerToQuat(vec3(angle(random), angle(random), angle(random)));
+				addBody(ecs, enumGeometry::BOX, position, rotation, vec3(0.8f), 1.f);
+			}
+			else {
+				addBody(ecs, enumGeometry::SPHERE, position, quat(1, 0, 0, 0), vec3(0.4f), 1.f);
+			}
+		}
+	}
+
+	// 5x5x5 lattice of touching spheres with no gravity, all thrown inwards so the whole lattice collides at once
+	inline void buildSphereLattice(ECS::ECSManager& ecs, PhysicsEngine& engine, std::mt19937& random) {
+		engine.gravity = vec3(0);
+
+		std::uniform_real_distribution<float> jitter(-0.5f, 0.5f);
+
+		const int size = 5;
+		const vec3 centre = vec3(0, 0, 10);
+		float offset = (size - 1) * 0.5f;
+
+		for (int x = 0; x < size; x++) {
+			for (int y = 0; y < size; y++) {
+				for (int z = 0; z < size; z++) {
+					vec3 position = centre + vec3(x - offset, y - offset, z - offset);
+					vec3 velocity = (centre - position) * 0.5f + vec3(jitter(random), jitter(random), jitter(random));
+					addBody(ecs, enumGeometry::SPHERE, position, quat(1, 0, 0, 0), vec3(0.5f), 1.f, velocity);
+				}
+			}
+		}
+	}
+
+	// 60 small spheres and thin plates fired at 25 to 50 m/s inside a box of thin static walls, they all use continuous collision
+	inline void buildBullets(ECS::ECSManager& ecs, PhysicsEngine&, std::mt19937& random) {
+		addFloor(ecs);
+
+		const float halfSize = 8.f;
+		const vec3 walls[4][2] = {
+			{ vec3(halfSize, 0, 5.f), vec3(0.1f, 2.f * halfSize, 10.f) },
+			{ vec3(-halfSize, 0, 5.f), vec3(0.1f, 2.f * halfSize, 10.f) },
+			{ vec3(0, halfSize, 5.f), vec3(2.f * halfSize, 0.1f, 10.f) },
+			{ vec3(0, -halfSize, 5.f), vec3(2.f * halfSize, 0.1f, 10.f) }
+		};
+
+		for (const vec3* wall : walls) {
+			ECS::uint entity = ecs.createEntity();
+			ecs.addComponent<TransformComponent>(entity, { wall[0], quat(1, 0, 0, 0), wall[1] });
+			ecs.addComponent<CollisionComponent>(entity, { enumGeometry::BOX });
+		}
+
+		std::uniform_real_distribution<float> heading(0.f, 6.2832f);
+		std::uniform_real_distribution<float> speed(25.f, 50.f);
+		std::uniform_real_distribution<float> height(0.5f, 2.5f);
+		std::uniform_real_distribution<float> spread(-2.f, 2.f);
+
+		for (int i = 0; i < 60; i++) {
+			float angle = heading(random);
+			vec3 position = vec3(spread(random), spread(random), height(random));
+			vec3 velocity = vec3(std::cos(angle), std::sin(angle), -0.2f) * speed(random);
+
+			ECS::uint entity;
+			if (i % 3 == 2) {
+				entity = addBody(ecs, enumGeometry::BOX, position, eulerToQuat(vec3(0, 0, glm::degrees(angle))), vec3(0.6f, 0.6f, 0.08f), 1.f, velocity);
+			}
+			else {
+				entity = addBody(ecs, enumGeometry::SPHERE, position, quat(1, 0, 0, 0), vec3(0.15f), 4.f, velocity);
+			}
+
+			ecs.getComponent<PhysicsComponent>(entity).continuous = true;
+		}
+	}
+
+	using BuildFunction = void(*)(ECS::ECSManager&, PhysicsEngine&, std::mt19937&);
+
+	struct Scene {
+		const char* name;
+		BuildFunction build;
+	};
+
+	inline const Scene scenes[] = {
+		{ "pyramids", buildPyramids },
+		{ "sphere_rain", buildSphereRain },
+		{ "mixed_pile", buildMixedPile },
+		{ "convex_pile", buildConvexPile },
+		{ "hull_pile", buildHullPile },
+		{ "mesh_terrain", buildMeshTerrain },
+		{ "sphere_lattice", buildSphereLattice },
+		{ "bullets", buildBullets },
+	};
+}
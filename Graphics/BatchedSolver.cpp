@@ -0,0 +1,369 @@
+#include "BatchedSolver.h"
+
+#include "IPhysicsEngine.h"
+
+#include <algorithm>
+
+
+template<typename Lanes>
+struct BodyLanes {
+	Lanes velX, velY, velZ;
+	Lanes angVelX, angVelY, angVelZ;
+};
+
+template<typename Lanes>
+SIMD_INLINE static Lanes dot(const Vec3Lanes& a, Lanes x, Lanes y, Lanes z) {
+	return Lanes::load(a.x) * x + Lanes::load(a.y) * y + Lanes::load(a.z) * z;
+}
+
+
+bool BatchedSolver::hasIntrinsics() {
+#if defined(SIMD_AVX2) || defined(SIMD_SSE)
+	return true;
+#else
+	return false;
+#endif
+}
+
+BatchedSolver::BatchedSolver(IPhysicsEngine* interface) : physicsEngine(interface) {
+	for (int lane = 0; lane < SIMD_LANES; lane++) {
+		clearLane(emptyBatch, lane);
+	}
+}
+
+void BatchedSolver::begin(const ContactArena<ContactConstraint>& constraints, const SolverBodyCache& bodies) {
+	buildBatches(constraints);
+
+	for (int i = 0; i < bodies.getBodyCount(); i++) {
+		const SolverBody& body = bodies[i];
+		float* row = velocities[i];
+		row[0] = body.vel.x;
+		row[1] = body.vel.y;
+		row[2] = body.vel.z;
+		row[3] = 0.f;
+		row[4] = body.angVel.x;
+		row[5] = body.angVel.y;
+		row[6] = body.angVel.z;
+		row[7] = 0.f;
+	}
+}
+
+void BatchedSolver::end(ContactArena<ContactConstraint>& constraints, SolverBodyCache& bodies) const {
+	for (int i = 0; i < batches.getCount(); i++) {
+		const ContactBatch& batch = batches[i];
+
+		for (int lane = 0; lane < batch.laneCount; lane++) {
+			ContactConstraint& constraint = constraints[batch.constraintIndex[lane]];
+			constraint.lambdaSum = batch.lambdaSum[lane];
+			constraint.tangentLambdaSum1 = batch.tangentLambdaSum1[lane];
+			constraint.tangentLambdaSum2 = batch.tangentLambdaSum2[lane];
+		}
+	}
+
+	// Static body is skipped, it never moves
+	for (int i = 1; i < bodies.getBodyCount(); i++) {
+		SolverBody& body = bodies[i];
+		const float* row = velocities[i];
+		body.vel = vec3(row[0], row[1], row[2]);
+		body.angVel = vec3(row[4], row[5], row[6]);
+	}
+}
+
+void BatchedSolver::warmStart() {
+	for (int i = 0; i < batches.getCount(); i++) {
+		if (useIntrinsics) warmStartBatch<SimdLanes>(batches[i]);
+		else warmStartBatch<ScalarLanes>(batches[i]);
+	}
+}
+
+void BatchedSolver::solveFriction() {
+	for (int i = 0; i < batches.getCount(); i++) {
+		if (useIntrinsics) solveFrictionBatch<SimdLanes>(batches[i]);
+		else solveFrictionBatch<ScalarLanes>(batches[i]);
+	}
+}
+
+void BatchedSolver::solveImpulse() {
+	for (int i = 0; i < batches.getCount(); i++) {
+		if (useIntrinsics) solveImpulseBatch<SimdLanes>(batches[i]);
+		else solveImpulseBatch<ScalarLanes>(batches[i]);
+	}
+}
+
+void BatchedSolver::applyRestitution() {
+	float elasticity = physicsEngine->elasticity;
+
+	for (int i = 0; i < batches.getCount(); i++) {
+		if (useIntrinsics) applyRestitutionBatch<SimdLanes>(batches[i], elasticity);
+		else applyRestitutionBatch<ScalarLanes>(batches[i], elasticity);
+	}
+}
+
+float BatchedSolver::getLaneOccupancy() const {
+	if (batches.getCount() == 0) return 1.f;
+
+	int usedLanes = 0;
+	for (int i = 0; i < batches.getCount(); i++) {
+		usedLanes += batches[i].laneCount;
+	}
+
+	return (float)usedLanes / (float)(batches.getCount() * SIMD_LANES);
+}
+
+
+template<typename Lanes>
+BodyLanes<Lanes> BatchedSolver::gatherBodies(const int* indices) const {
+	Lanes rows[8];
+	Lanes::loadRows(velocities, indices, rows);
+
+	return { rows[0], rows[1], rows[2], rows[4], rows[5], rows[6] };
+}
+
+template<typename Lanes>
+void BatchedSolver::scatterBodies(const BodyLanes<Lanes>& body, const int* indices) {
+	Lanes zero = Lanes::set1(0.f);
+	Lanes rows[8] = { body.velX, body.velY, body.velZ, zero, body.angVelX, body.angVelY, body.angVelZ, zero };
+
+	Lanes::storeRows(velocities, indices, rows);
+}
+
+// Impulse along 'direction' scaled per lane by 'lambda', angular rows already include inverse inertia
+template<typename Lanes>
+SIMD_INLINE static void applyLanes(BodyLanes<Lanes>& bodyA, BodyLanes<Lanes>& bodyB, const ContactBatch& batch,
+	const Vec3Lanes& direction, const Vec3Lanes& angularA, const Vec3Lanes& angularB, Lanes lambda) {
+
+	Lanes linearA = lambda * Lanes::load(batch.invMassA);
+	Lanes linearB = lambda * Lanes::load(batch.invMassB);
+
+	Lanes dirX = Lanes::load(direction.x);
+	Lanes dirY = Lanes::load(direction.y);
+	Lanes dirZ = Lanes::load(direction.z);
+
+	bodyA.velX = bodyA.velX - dirX * linearA;
+	bodyA.velY = bodyA.velY - dirY * linearA;
+	bodyA.velZ = bodyA.velZ - dirZ * linearA;
+	bodyA.angVelX = bodyA.angVelX - Lanes::load(angularA.x) * lambda;
+	bodyA.angVelY = bodyA.angVelY - Lanes::load(angularA.y) * lambda;
+	bodyA.angVelZ = bodyA.angVelZ - Lanes::load(angularA.z) * lambda;
+
+	bodyB.velX = bodyB.velX + dirX * linearB;
+	bodyB.velY = bodyB.velY + dirY * linearB;
+	bodyB.velZ = bodyB.velZ + dirZ * linearB;
+	bodyB.angVelX = bodyB.angVelX + Lanes::load(angularB.x) * lambda;
+	bodyB.angVelY = bodyB.angVelY + Lanes::load(angularB.y) * lambda;
+	bodyB.angVelZ = bodyB.angVelZ + Lanes::load(angularB.z) * lambda;
+}
+
+// Relative velocity of B against A along one constraint row
+template<typename Lanes>
+SIMD_INLINE static Lanes calcRowVel(const BodyLanes<Lanes>& bodyA, const BodyLanes<Lanes>& bodyB,
+	const Vec3Lanes& direction, const Vec3Lanes& crossA, const Vec3Lanes& crossB) {
+
+	Lanes linear = dot(direction, bodyB.velX - bodyA.velX, bodyB.velY - bodyA.velY, bodyB.velZ - bodyA.velZ);
+	Lanes angularB = dot(crossB, bodyB.angVelX, bodyB.angVelY, bodyB.angVelZ);
+	Lanes angularA = dot(crossA, bodyA.angVelX, bodyA.angVelY, bodyA.angVelZ);
+
+	return linear + angularB - angularA;
+}
+
+template<typename Lanes>
+void BatchedSolver::warmStartBatch(ContactBatch& batch) {
+	BodyLanes<Lanes> bodyA = gatherBodies<Lanes>(batch.bodyA);
+	BodyLanes<Lanes> bodyB = gatherBodies<Lanes>(batch.bodyB);
+
+	applyLanes(bodyA, bodyB, batch, batch.normal, batch.angularA_N, batch.angularB_N, Lanes::load(batch.lambdaSum));
+	applyLanes(bodyA, bodyB, batch, batch.tangent1, batch.angularA_T1, batch.angularB_T1, Lanes::load(batch.tangentLambdaSum1));
+	applyLanes(bodyA, bodyB, batch, batch.tangent2, batch.angularA_T2, batch.angularB_T2, Lanes::load(batch.tangentLambdaSum2));
+
+	scatterBodies(bodyA, batch.bodyA);
+	scatterBodies(bodyB, batch.bodyB);
+}
+
+template<typename Lanes>
+void BatchedSolver::solveFrictionBatch(ContactBatch& batch) {
+	BodyLanes<Lanes> bodyA = gatherBodies<Lanes>(batch.bodyA);
+	BodyLanes<Lanes> bodyB = gatherBodies<Lanes>(batch.bodyB);
+
+	Lanes maxFriction = Lanes::load(batch.lambdaSum) * Lanes::load(batch.friction);
+	Lanes minFriction = -maxFriction;
+
+	Lanes JV1 = calcRowVel(bodyA, bodyB, batch.tangent1, batch.rAxT1, batch.rBxT1);
+	Lanes JV2 = calcRowVel(bodyA, bodyB, batch.tangent2, batch.rAxT2, batch.rBxT2);
+
+	Lanes oldSum1 = Lanes::load(batch.tangentLambdaSum1);
+	Lanes newSum1 = min(max(oldSum1 - JV1 * Lanes::load(batch.tangentMass1), minFriction), maxFriction);
+	newSum1.store(batch.tangentLambdaSum1);
+
+	Lanes oldSum2 = Lanes::load(batch.tangentLambdaSum2);
+	Lanes newSum2 = min(max(oldSum2 - JV2 * Lanes::load(batch.tangentMass2), minFriction), maxFriction);
+	newSum2.store(batch.tangentLambdaSum2);
+
+	applyLanes(bodyA, bodyB, batch, batch.tangent1, batch.angularA_T1, batch.angularB_T1, newSum1 - oldSum1);
+	applyLanes(bodyA, bodyB, batch, batch.tangent2, batch.angularA_T2, batch.angularB_T2, newSum2 - oldSum2);
+
+	scatterBodies(bodyA, batch.bodyA);
+	scatterBodies(bodyB, batch.bodyB);
+}
+
+template<typename Lanes>
+void BatchedSolver::solveImpulseBatch(ContactBatch& batch) {
+	BodyLanes<Lanes> bodyA = gatherBodies<Lanes>(batch.bodyA);
+	BodyLanes<Lanes> bodyB = gatherBodies<Lanes>(batch.bodyB);
+
+	Lanes JV = calcRowVel(bodyA, bodyB, batch.normal, batch.rAxN, batch.rBxN);
+
+	Lanes oldSum = Lanes::load(batch.lambdaSum);
+	Lanes newSum = max(oldSum - (JV + Lanes::load(batch.speculativeVelocity)) * Lanes::load(batch.normalMass), Lanes::set1(0.f));
+	newSum.store(batch.lambdaSum);
+
+	applyLanes(bodyA, bodyB, batch, batch.normal, batch.angularA_N, batch.angularB_N, newSum - oldSum);
+
+	scatterBodies(bodyA, batch.bodyA);
+	scatterBodies(bodyB, batch.bodyB);
+}
+
+template<typename Lanes>
+void BatchedSolver::applyRestitutionBatch(ContactBatch& batch, float elasticity) {
+	BodyLanes<Lanes> bodyA = gatherBodies<Lanes>(batch.bodyA);
+	BodyLanes<Lanes> bodyB = gatherBodies<Lanes>(batch.bodyB);
+
+	// Speculative lanes that pushed also cancel the closing speed they allowed, as in PhysicsSolver::applyRestitution
+	Lanes lambdaSum = Lanes::load(batch.lambdaSum);
+	Lanes speculative = Lanes::load(batch.speculativeVelocity) * Lanes::load(batch.normalMass) * Lanes::set1(1.f + elasticity);
+	Lanes lambda = lambdaSum * Lanes::set1(elasticity) + maskPositive(lambdaSum, speculative);
+
+	applyLanes(bodyA, bodyB, batch, batch.normal, batch.angularA_N, batch.angularB_N, lambda);
+
+	scatterBodies(bodyA, batch.bodyA);
+	scatterBodies(bodyB, batch.bodyB);
+}
+
+
+// Greedy packing: each constraint goes in the first batch that has a free lane and
+// comes after every batch already holding one of its bodies.
+// The static body can share batches freely since nothing writes to it.
+void BatchedSolver::buildBatches(const ContactArena<ContactConstraint>& constraints) {
+	batches.clear();
+
+	for (int i = 0; i < MAX_ENTITIES + 1; i++) {
+		nextBatch[i] = 0;
+	}
+
+	// batches before this are full
+	int firstOpen = 0;
+
+	for (int i = 0; i < constraints.getCount(); i++) {
+		const ContactConstraint& constraint = constraints[i];
+		int bodyA = constraint.bodyA;
+		int bodyB = constraint.bodyB;
+
+		int batchIndex = std::max(firstOpen, std::max(nextBatch[bodyA], nextBatch[bodyB]));
+		while (batchIndex < batches.getCount() && batches[batchIndex].laneCount == SIMD_LANES) {
+			batchIndex++;
+		}
+
+		if (batchIndex == batches.getCount()) {
+			batches.push(emptyBatch);
+		}
+
+		addLane(batches[batchIndex], constraint, i);
+
+		if (bodyA != SolverBodyCache::staticBody) nextBatch[bodyA] = batchIndex + 1;
+		if (bodyB != SolverBodyCache::staticBody) nextBatch[bodyB] = batchIndex + 1;
+
+		while (firstOpen < batches.getCount() && batches[firstOpen].laneCount == SIMD_LANES) {
+			firstOpen++;
+		}
+	}
+}
+
+void BatchedSolver::addLane(ContactBatch& batch, const ContactConstraint& constraint, int constraintIndex) {
+	int lane = batch.laneCount++;
+
+	auto setLane = [lane](Vec3Lanes& lanes, vec3 v) {
+		lanes.x[lane] = v.x;
+		lanes.y[lane] = v.y;
+		lanes.z[lane] = v.z;
+	};
+
+	batch.bodyA[lane] = constraint.bodyA;
+	batch.bodyB[lane] = constraint.bodyB;
+	batch.constraintIndex[lane] = constraintIndex;
+
+	setLane(batch.normal, constraint.normal);
+	setLane(batch.tangent1, constraint.tangent1);
+	setLane(batch.tangent2, constraint.tangent2);
+
+	setLane(batch.rAxN, constraint.rAxN);
+	setLane(batch.rBxN, constraint.rBxN);
+	setLane(batch.rAxT1, constraint.rAxT1);
+	setLane(batch.rBxT1, constraint.rBxT1);
+	setLane(batch.rAxT2, constraint.rAxT2);
+	setLane(batch.rBxT2, constraint.rBxT2);
+
+	setLane(batch.angularA_N, constraint.angularA_N);
+	setLane(batch.angularB_N, constraint.angularB_N);
+	setLane(batch.angularA_T1, constraint.angularA_T1);
+	setLane(batch.angularB_T1, constraint.angularB_T1);
+	setLane(batch.angularA_T2, constraint.angularA_T2);
+	setLane(batch.angularB_T2, constraint.angularB_T2);
+
+	batch.invMassA[lane] = constraint.invMassA;
+	batch.invMassB[lane] = constraint.invMassB;
+
+	batch.normalMass[lane] = constraint.normalMass;
+	batch.tangentMass1[lane] = constraint.tangentMass1;
+	batch.tangentMass2[lane] = constraint.tangentMass2;
+
+	batch.friction[lane] = constraint.friction;
+	batch.speculativeVelocity[lane] = constraint.speculativeVelocity;
+
+	batch.lambdaSum[lane] = constraint.lambdaSum;
+	batch.tangentLambdaSum1[lane] = constraint.tangentLambdaSum1;
+	batch.tangentLambdaSum2[lane] = constraint.tangentLambdaSum2;
+}
+
+// Empty lane: static body on both sides and zero everywhere, so it solves to a zero impulse
+void BatchedSolver::clearLane(ContactBatch& batch, int lane) {
+	auto zeroLane = [lane](Vec3Lanes& lanes) {
+		lanes.x[lane] = 0.f;
+		lanes.y[lane] = 0.f;
+		lanes.z[lane] = 0.f;
+	};
+
+	batch.bodyA[lane] = SolverBodyCache::staticBody;
+	batch.bodyB[lane] = SolverBodyCache::staticBody;
+	batch.constraintIndex[lane] = -1;
+
+	zeroLane(batch.normal);
+	zeroLane(batch.tangent1);
+	zeroLane(batch.tangent2);
+
+	zeroLane(batch.rAxN);
+	zeroLane(batch.rBxN);
+	zeroLane(batch.rAxT1);
+	zeroLane(batch.rBxT1);
+	zeroLane(batch.rAxT2);
+	zeroLane(batch.rBxT2);
+
+	zeroLane(batch.angularA_N);
+	zeroLane(batch.angularB_N);
+	zeroLane(batch.angularA_T1);
+	zeroLane(batch.angularB_T1);
+	zeroLane(batch.angularA_T2);
+	zeroLane(batch.angularB_T2);
+
+	batch.invMassA[lane] = 0.f;
+	batch.invMassB[lane] = 0.f;
+
+	batch.normalMass[lane] = 0.f;
+	batch.tangentMass1[lane] = 0.f;
+	batch.tangentMass2[lane] = 0.f;
+
+	batch.friction[lane] = 0.f;
+	batch.speculativeVelocity[lane] = 0.f;
+
+	batch.lambdaSum[lane] = 0.f;
+	batch.tangentLambdaSum1[lane] = 0.f;
+	batch.tangentLambdaSum2[lane] = 0.f;
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include "ECS.h"
+#include "SimdLanes.h"
+#include "SolverBody.h"
+#include "ContactConstraint.h"
+#include "ContactArena.h"
+
+
+// Three rows of lanes, one per axis
+struct Vec3Lanes {
+	alignas(32) float x[SIMD_LANES];
+	alignas(32) float y[SIMD_LANES];
+	alignas(32) float z[SIMD_LANES];
+};
+
+// SIMD_LANES contact constraints in structure-of-arrays form.
+// No non-static body appears twice in a batch, so every lane can be solved at once.
+// Unused lanes point at the static body with zero masses, which makes their impulses zero.
+struct alignas(32) ContactBatch {
+	alignas(32) int bodyA[SIMD_LANES];
+	alignas(32) int bodyB[SIMD_LANES];
+
+	// -1 for unused lanes
+	int constraintIndex[SIMD_LANES];
+	int laneCount = 0;
+
+	Vec3Lanes normal;
+	Vec3Lanes tangent1;
+	Vec3Lanes tangent2;
+
+	Vec3Lanes rAxN;
+	Vec3Lanes rBxN;
+	Vec3Lanes rAxT1;
+	Vec3Lanes rBxT1;
+	Vec3Lanes rAxT2;
+	Vec3Lanes rBxT2;
+
+	Vec3Lanes angularA_N;
+	Vec3Lanes angularB_N;
+	Vec3Lanes angularA_T1;
+	Vec3Lanes angularB_T1;
+	Vec3Lanes angularA_T2;
+	Vec3Lanes angularB_T2;
+
+	alignas(32) float invMassA[SIMD_LANES];
+	alignas(32) float invMassB[SIMD_LANES];
+
+	alignas(32) float normalMass[SIMD_LANES];
+	alignas(32) float tangentMass1[SIMD_LANES];
+	alignas(32) float tangentMass2[SIMD_LANES];
+
+	alignas(32) float friction[SIMD_LANES];
+	alignas(32) float speculativeVelocity[SIMD_LANES];
+
+	alignas(32) float lambdaSum[SIMD_LANES];
+	alignas(32) float tangentLambdaSum1[SIMD_LANES];
+	alignas(32) float tangentLambdaSum2[SIMD_LANES];
+};
+
+
+// Velocities of one body per lane, transposed out of BatchedSolver's velocity rows
+template<typename Lanes> struct BodyLanes;
+
+
+// Alternate velocity solver backend to PhysicsSolver's per-contact loops.
+// Takes the constraints PhysicsSolver::preStep built, packs them into ContactBatches
+// and runs the same sequential impulse steps on a whole batch at a time.
+// Solve order differs from the scalar backend, so results match it closely but not exactly.
+class BatchedSolver {
+private:
+	struct IPhysicsEngine* physicsEngine;
+
+	ContactArena<ContactBatch> batches;
+
+	// Every lane unused, new batches start as a copy of this
+	ContactBatch emptyBatch;
+
+	// One 8 float row per body: vel.xyz, 0, angVel.xyz, 0
+	// Lanes load whole rows and transpose them instead of gathering each component
+	alignas(32) float velocities[MAX_ENTITIES + 1][8];
+
+	// First batch each body is free to join, used while packing
+	int nextBatch[MAX_ENTITIES + 1];
+
+	// false runs the lanes as plain loops, gives identical results to the intrinsics path
+	bool useIntrinsics = true;
+
+public:
+	BatchedSolver(IPhysicsEngine* interface);
+
+	static constexpr int laneWidth = SIMD_LANES;
+	static bool hasIntrinsics();
+
+	void setUseIntrinsics(bool enabled) { useIntrinsics = enabled; }
+
+	// Packs constraints into batches and copies body velocities in
+	void begin(const ContactArena<ContactConstraint>& constraints, const SolverBodyCache& bodies);
+	// Copies accumulated impulses and body velocities back out
+	void end(ContactArena<ContactConstraint>& constraints, SolverBodyCache& bodies) const;
+
+	void warmStart();
+	void solveFriction();
+	void solveImpulse();
+	void applyRestitution();
+
+	int getBatchCount() const { return batches.getCount(); }
+
+	// Fraction of lanes holding a real constraint
+	float getLaneOccupancy() const;
+
+private:
+	template<typename Lanes> SIMD_INLINE BodyLanes<Lanes> gatherBodies(const int* indices) const;
+	template<typename Lanes> SIMD_INLINE void scatterBodies(const BodyLanes<Lanes>& body, const int* indices);
+
+	template<typename Lanes> void warmStartBatch(ContactBatch& batch);
+	template<typename Lanes> void solveFrictionBatch(ContactBatch& batch);
+	template<typename Lanes> void solveImpulseBatch(ContactBatch& batch);
+	template<typename Lanes> void applyRestitutionBatch(ContactBatch& batch, float elasticity);
+
+	void buildBatches(const ContactArena<ContactConstraint>& constraints);
+	static void addLane(ContactBatch& batch, const ContactConstraint& constraint, int constraintIndex);
+	static void clearLane(ContactBatch& batch, int lane);
+};
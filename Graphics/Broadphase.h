@@ -0,0 +1,176 @@
+#pragma once
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <vector>
+
+#include "ECS.h"
+#include "glmAddon.h"
+
+
+struct AABB {
+	vec3 min = vec3(0);
+	vec3 max = vec3(0);
+
+	bool overlaps(const AABB& other) const {
+		return min.x <= other.max.x && max.x >= other.min.x
+			&& min.y <= other.max.y && max.y >= other.min.y
+			&& min.z <= other.max.z && max.z >= other.min.z;
+	}
+
+	// infinite shapes (planes) get FLT_MAX extents
+	bool isUnbounded() const {
+		return min.x == -FLT_MAX || min.y == -FLT_MAX || min.z == -FLT_MAX
+			|| max.x == FLT_MAX || max.y == FLT_MAX || max.z == FLT_MAX;
+	}
+
+	bool contains(const AABB& other) const {
+		return min.x <= other.min.x && min.y <= other.min.y && min.z <= other.min.z
+			&& max.x >= other.max.x && max.y >= other.max.y && max.z >= other.max.z;
+	}
+
+	vec3 getCentre() const { return (min + max) * 0.5f; }
+
+	float getSurfaceArea() const {
+		vec3 size = max - min;
+		return 2.f * (size.x * size.y + size.y * size.z + size.z * size.x);
+	}
+
+	// Whether origin + t * direction, t in [0, maxDistance], passes through the box grown by 'radius'
+	bool intersectsRay(vec3 origin, vec3 inverseDirection, float maxDistance, float radius = 0.f) const {
+		vec3 t1 = (min - vec3(radius) - origin) * inverseDirection;
+		vec3 t2 = (max + vec3(radius) - origin) * inverseDirection;
+		vec3 tNear = glm::min(t1, t2);
+		vec3 tFar = glm::max(t1, t2);
+
+		float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.f));
+		float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxDistance));
+		return enter <= exit;
+	}
+
+	// 1 / direction for intersectsRay, zero components become huge instead of infinite so a ray lying
+	// on a slab's plane doesn't turn into NaN
+	static vec3 getInverseDirection(vec3 direction) {
+		vec3 inverse;
+		for (int i = 0; i < 3; i++) {
+			inverse[i] = 1.f / (std::abs(direction[i]) > 1e-20f ? direction[i] : std::copysign(1e-20f, direction[i]));
+		}
+		return inverse;
+	}
+
+	static AABB merge(const AABB& a, const AABB& b) { return { glm::min(a.min, b.min), glm::max(a.max, b.max) }; }
+
+	static AABB unbounded() { return { vec3(-FLT_MAX), vec3(FLT_MAX) }; }
+};
+
+struct BroadphasePair {
+	ECS::uint entityA;
+	ECS::uint entityB;
+};
+
+
+// Incremental sweep and prune along the axis of greatest variance.
+// Proxies stay sorted between ticks so insertion sort only has to fix up whatever moved.
+class SweepAndPrune {
+private:
+	struct Proxy {
+		ECS::uint entityID;
+		AABB aabb;
+	};
+
+	unsigned int proxyCount = 0;
+	Proxy proxies[MAX_ENTITIES];
+
+	int sortAxis = 0;
+
+public:
+	void insert(ECS::uint entityID) {
+		assert(proxyCount < MAX_ENTITIES);
+
+		// goes at the end, the next sort will move it into place
+		proxies[proxyCount++] = { entityID, AABB() };
+	}
+
+	void remove(ECS::uint entityID) {
+		for (unsigned int i = 0; i < proxyCount; i++) {
+			if (proxies[i].entityID != entityID) continue;
+
+			// shift down instead of swapping with the last proxy to keep the order intact
+			for (unsigned int n = i + 1; n < proxyCount; n++) {
+				proxies[n - 1] = proxies[n];
+			}
+			proxyCount--;
+			return;
+		}
+	}
+
+	int getSortAxis() const { return sortAxis; }
+	unsigned int getProxyCount() const { return proxyCount; }
+
+	// 'aabbs' is indexed by entity ID
+	void findPairs(const AABB* aabbs, std::vector<BroadphasePair>& pairs) {
+		for (unsigned int i = 0; i < proxyCount; i++) {
+			proxies[i].aabb = aabbs[proxies[i].entityID];
+		}
+
+		chooseSortAxis();
+		insertionSort();
+
+		for (unsigned int i = 0; i < proxyCount; i++) {
+			const Proxy& proxyA = proxies[i];
+			float maxA = proxyA.aabb.max[sortAxis];
+
+			for (unsigned int n = i + 1; n < proxyCount; n++) {
+				const Proxy& proxyB = proxies[n];
+
+				// sorted by min so nothing after this can overlap A on the sort axis
+				if (proxyB.aabb.min[sortAxis] > maxA) break;
+
+				if (proxyA.aabb.overlaps(proxyB.aabb)) {
+					pairs.push_back({ proxyA.entityID, proxyB.entityID });
+				}
+			}
+		}
+	}
+
+private:
+	void chooseSortAxis() {
+		vec3 sum = vec3(0);
+		vec3 sqrSum = vec3(0);
+		unsigned int count = 0;
+
+		for (unsigned int i = 0; i < proxyCount; i++) {
+			if (proxies[i].aabb.isUnbounded()) continue;
+
+			vec3 centre = proxies[i].aabb.getCentre();
+			sum += centre;
+			sqrSum += centre * centre;
+			count++;
+		}
+
+		if (count < 2) return;
+
+		vec3 mean = sum / (float)count;
+		vec3 variance = sqrSum / (float)count - mean * mean;
+
+		sortAxis = 0;
+		if (variance.y > variance[sortAxis]) sortAxis = 1;
+		if (variance.z > variance[sortAxis]) sortAxis = 2;
+	}
+
+	// Near linear when the order barely changes between ticks
+	void insertionSort() {
+		for (unsigned int i = 1; i < proxyCount; i++) {
+			Proxy proxy = proxies[i];
+			float key = proxy.aabb.min[sortAxis];
+
+			unsigned int n = i;
+			while (n > 0 && proxies[n - 1].aabb.min[sortAxis] > key) {
+				proxies[n] = proxies[n - 1];
+				n--;
+			}
+			proxies[n] = proxy;
+		}
+	}
+};
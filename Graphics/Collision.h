@@ -8,10 +8,17 @@ struct CollisionECS {
     ECS::uint entityA = UINT8_MAX;
     ECS::uint entityB = UINT8_MAX;
 
-    glm::vec3 worldNormal;
-    glm::vec3 pointA;
-    glm::vec3 pointB;
-    float depth = 0.f;
+    // dense solver body indices, filled in by PhysicsSolver::assignBodies
+    int bodyA = 0;
+    int bodyB = 0;
+
+    glm::vec3 worldNormal = glm::vec3(0);
+    glm::vec3 pointA = glm::vec3(0);
+    glm::vec3 pointB = glm::vec3(0);
+    float depth = 0.f; // negative for speculative contacts, the gap left between the shapes
+
+    // identifies the contact within its entity pair so it can be matched next tick
+    unsigned int featureID = 0;
 
     float lambdaSum = 0.f;
     float tangentLambdaSum1 = 0.f;
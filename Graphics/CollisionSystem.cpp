@@ -1,11 +1,625 @@
 #include "CollisionSystem.h"
 
+#include <algorithm>
+#include <cmath>
+
+
+const std::vector<BroadphasePair>& CollisionSystem::findPairs(ECS::ECSManager* manager) {
+	pairs.clear();
+
+	// every mode needs them, mesh collisions look up triangles with the body's AABB
+	calcEntityAABBs(manager);
+
+	switch (broadphase) {
+	case enumBroadphase::BRUTE_FORCE:
+		for (int i = 0; i < entityCount; i++) {
+			for (int n = i + 1; n < entityCount; n++) {
+				pairs.push_back({ entities[i], entities[n] });
+			}
+		}
+		break;
+
+	case enumBroadphase::SWEEP_AND_PRUNE:
+		sweepAndPrune.findPairs(aabbs, pairs);
+		break;
+
+	case enumBroadphase::DYNAMIC_AABB_TREE:
+		treeUpdates = updateAABBTree(aabbTree, aabbs, treeProxies, unboundedEntities, unboundedCount);
+
+		for (int i = 0; i < entityCount; i++) {
+			ECS::uint entityA = entities[i];
+			if (treeProxies[entityA] == DynamicAABBTree::nullNode) continue;
+
+			const AABB& aabbA = aabbs[entityA];
+			aabbTree.query(aabbA, [&](ECS::uint entityB) {
+				// tree overlap is against fat AABBs so check the tight ones before reporting
+				if (entityB > entityA && aabbA.overlaps(aabbs[entityB])) {
+					pairs.push_back({ entityA, entityB });
+				}
+			});
+		}
+
+		for (int i = 0; i < unboundedCount; i++) {
+			ECS::uint entityA = unboundedEntities[i];
+
+			for (int n = 0; n < entityCount; n++) {
+				ECS::uint entityB = entities[n];
+
+				// unbounded pairs only get reported once
+				if (treeProxies[entityB] == DynamicAABBTree::nullNode && entityB <= entityA) continue;
+
+				pairs.push_back({ entityA, entityB });
+			}
+		}
+		break;
+	}
+
+	return pairs;
+}
+
+void CollisionSystem::updateEntityStates(ECS::ECSManager* manager) {
+	for (int i = 0; i < entityCount; i++) {
+		ECS::uint entity = entities[i];
+		const CollisionComponent& collision = manager->getComponent<CollisionComponent>(entity);
+		geometries[entity] = collision.geometry;
+		shapeIDs[entity] = collision.shapeID;
+
+		bool hasPhysics = manager->hasComponent<PhysicsComponent>(entity);
+		isSleeping[entity] = hasPhysics && manager->getComponent<PhysicsComponent>(entity).isAsleep;
+		isAwake[entity] = hasPhysics && !isSleeping[entity];
+	}
+}
+
+void CollisionSystem::calcEntityAABBs(ECS::ECSManager* manager) {
+	for (int i = 0; i < entityCount; i++) {
+		ECS::uint entity = entities[i];
+		if (isSleeping[entity]) continue;
+
+		AABB aabb = calcAABB(manager->getComponent<CollisionComponent>(entity), manager->getComponent<TransformComponent>(entity));
+		if (!aabb.isUnbounded()) {
+			aabb.min -= vec3(contactMargin);
+			aabb.max += vec3(contactMargin);
+		}
+		aabbs[entity] = aabb;
+	}
+}
+
+int CollisionSystem::updateAABBTree(DynamicAABBTree& tree, const AABB* bounds, int* proxies, ECS::uint* unbounded, ECS::uint& count) {
+	int updates = 0;
+	count = 0;
+
+	for (int i = 0; i < entityCount; i++) {
+		ECS::uint entity = entities[i];
+		const AABB& aabb = bounds[entity];
+		int& proxy = proxies[entity];
+
+		if (aabb.isUnbounded()) {
+			if (proxy != DynamicAABBTree::nullNode) {
+				tree.destroyProxy(proxy);
+				proxy = DynamicAABBTree::nullNode;
+			}
+
+			unbounded[count++] = entity;
+			continue;
+		}
+
+		if (proxy == DynamicAABBTree::nullNode) {
+			proxy = tree.createProxy(aabb, entity);
+			updates++;
+		}
+		else if (tree.moveProxy(proxy, aabb)) {
+			updates++;
+		}
+	}
+
+	return updates;
+}
+
+AABB CollisionSystem::calcAABB(const CollisionComponent& collision, const TransformComponent& transform) const {
+	switch (collision.geometry) {
+	case enumGeometry::BOX: {
+		vec3 extents = transform.scale * 0.5f;
+		mat3 rotation = glm::mat3_cast(transform.rotation);
+
+		// projects each rotated half-extent onto the world axes
+		vec3 worldExtents = vec3(0);
+		for (int i = 0; i < 3; i++) {
+			worldExtents += abs(rotation[i]) * extents[i];
+		}
+
+		return { transform.position - worldExtents, transform.position + worldExtents };
+	}
+	case enumGeometry::SPHERE: {
+		float radius = (transform.scale.x + transform.scale.y + transform.scale.z) / 3.f;
+		return { transform.position - vec3(radius), transform.position + vec3(radius) };
+	}
+	case enumGeometry::CAPSULE:
+	case enumGeometry::CYLINDER:
+	case enumGeometry::CONVEX_HULL: {
+		AABB aabb;
+		getConvexShape(collision.geometry, collision.shapeID, transform).getBounds(aabb.min, aabb.max);
+		return aabb;
+	}
+	case enumGeometry::TRIANGLE_MESH: {
+		// the local bounds as an oriented box, same as BOX
+		AABB bounds = triangleMeshes[collision.shapeID].getBounds();
+		vec3 centre = transform.position + transform.rotation * (bounds.getCentre() * transform.scale);
+		vec3 extents = (bounds.max - bounds.min) * 0.5f * abs(transform.scale);
+		mat3 rotation = glm::mat3_cast(transform.rotation);
+
+		vec3 worldExtents = vec3(0);
+		for (int i = 0; i < 3; i++) {
+			worldExtents += abs(rotation[i]) * extents[i];
+		}
+
+		return { centre - worldExtents, centre + worldExtents };
+	}
+	default:
+		// planes are infinite regardless of their scale
+		return AABB::unbounded();
+	}
+}
+
+
+void CollisionSystem::updateQueryBounds(ECS::ECSManager* manager) {
+	updateEntityStates(manager);
+
+	// sleeping bodies too, the broadphase doesn't keep theirs up to date
+	for (int i = 0; i < entityCount; i++) {
+		ECS::uint entity = entities[i];
+		queryAABBs[entity] = calcAABB(manager->getComponent<CollisionComponent>(entity), manager->getComponent<TransformComponent>(entity));
+	}
+
+	updateAABBTree(queryTree, queryAABBs, queryProxies, queryUnboundedEntities, queryUnboundedCount);
+}
+
+void CollisionSystem::recordSweepOrigins(ECS::ECSManager* manager) {
+	for (int i = 0; i < entityCount; i++) {
+		ECS::uint entity = entities[i];
+		if (!manager->hasComponent<PhysicsComponent>(entity) || !manager->getComponent<PhysicsComponent>(entity).continuous) continue;
+
+		sweepOrigins[entity] = manager->getComponent<TransformComponent>(entity);
+	}
+}
+
+void CollisionSystem::sweepContinuousBodies(ECS::ECSManager* manager, IPhysicsEngine* physicsEngine) {
+	ECS::uint movers[MAX_ENTITIES];
+	float innerRadii[MAX_ENTITIES];
+	int moverCount = 0;
+
+	for (int i = 0; i < entityCount; i++) {
+		ECS::uint entity = entities[i];
+		if (!manager->hasComponent<PhysicsComponent>(entity)) continue;
+
+		const PhysicsComponent& physics = manager->getComponent<PhysicsComponent>(entity);
+		if (!physics.continuous || physics.isAsleep) continue;
+
+		const CollisionComponent& collision = manager->getComponent<CollisionComponent>(entity);
+		const TransformComponent& transform = manager->getComponent<TransformComponent>(entity);
+		float innerRadius = getConvexShape(collision.geometry, collision.shapeID, transform).getInnerRadius();
+
+		// slower than this and discrete contacts can't miss anything
+		vec3 motion = transform.position - sweepOrigins[entity].position;
+		if (dot(motion, motion) <= innerRadius * innerRadius) continue;
+
+		movers[moverCount] = entity;
+		innerRadii[moverCount] = innerRadius;
+		moverCount++;
+	}
+
+	if (moverCount == 0) return;
+
+	// everything else has already moved to the end of the tick
+	updateQueryBounds(manager);
+
+	for (int i = 0; i < moverCount; i++) {
+		ECS::uint entity = movers[i];
+		TransformComponent& transform = manager->getComponent<TransformComponent>(entity);
+
+		// From the pose it started in, which was clear of everything, turning from the rotation it started with to
+		// the one it ended with at an even rate along the way
+		TransformComponent origin = { sweepOrigins[entity].position, sweepOrigins[entity].rotation, transform.scale };
+		vec3 motion = transform.position - origin.position;
+		float distance = length(motion);
+		vec3 direction = motion / distance;
+
+		quat turn = transform.rotation * conjugate(origin.rotation);
+		if (turn.w < 0.f) turn = -turn;
+		vec3 turnAxis = vec3(turn.x, turn.y, turn.z);
+		float turnSine = length(turnAxis);
+		vec3 spin = turnSine > 1e-6f ? turnAxis * (2.f * std::atan2(turnSine, turn.w) / (turnSine * distance)) : vec3(0);
+
+		// Stopping just short would leave nothing for the discrete contacts to find, so a shrunk copy is swept and
+		// the body stops overlapping by that much. Next tick's sweep from there doesn't count it as already touching
+		ConvexShape moving = getConvexShape(geometries[entity], shapeIDs[entity], origin).shrunk(innerRadii[i] * CONTINUOUS_IMPACT_DEPTH);
+
+		AABB start = calcAABB({ geometries[entity], shapeIDs[entity] }, origin);
+		AABB swept = AABB::merge(start, { start.min + motion, start.max + motion });
+		// turning, any side can end up leading
+		if (spin != vec3(0)) {
+			float reach = moving.getOuterRadius();
+			swept = AABB::merge(swept, { min(origin.position, transform.position) - reach, max(origin.position, transform.position) + reach });
+		}
+
+		PHYSICS_PROFILE_COUNT(physicsEngine->profiler, enumPhysicsCounter::CONTINUOUS_SWEEPS, 1);
+
+		float impact = distance;
+		vec3 impactNormal = vec3(0);
+		auto sweep = [&](ECS::uint other) {
+			if (other == entity) return;
+
+			float otherImpact;
+			vec3 otherNormal;
+			if (!sweepShape(manager, moving, direction, spin, impact, other, swept, otherImpact, otherNormal)) return;
+
+			impact = otherImpact;
+			impactNormal = otherNormal;
+		};
+
+		queryTree.query(swept, [&](ECS::uint other) {
+			if (swept.overlaps(queryAABBs[other])) sweep(other);
+		});
+		for (int n = 0; n < queryUnboundedCount; n++) {
+			sweep(queryUnboundedEntities[n]);
+		}
+
+		if (impactNormal == vec3(0)) continue;
+
+		PHYSICS_PROFILE_COUNT(physicsEngine->profiler, enumPhysicsCounter::CONTINUOUS_IMPACTS, 1);
+
+		transform.position = moving.position + direction * impact;
+		transform.rotation = moving.advanced(direction, spin, impact).rotation;
+	}
+}
+
+bool CollisionSystem::sweepShape(ECS::ECSManager* manager, const ConvexShape& moving, vec3 direction, vec3 spin, float maxDistance, ECS::uint entity, const AABB& sweptBounds, float& distance, vec3& normal) const {
+	const TransformComponent& transform = manager->getComponent<TransformComponent>(entity);
+
+	switch (geometries[entity]) {
+	case enumGeometry::PLANE: {
+		vec3 planeNormal = transform.rotation * vec3(0, 0, 1);
+
+		// turning can drop its lowest point faster than it's heading down
+		float approach = -dot(direction, planeNormal) + length(spin) * moving.getOuterRadius();
+		if (approach <= 1e-6f) return false;
+
+		// Conservative advancement like GJK::cast, straight there in one step when it isn't turning. Nothing gets
+		// through a plane, touching it from the start is left to the discrete contacts
+		float travelled = 0.f;
+		for (int i = 0; i < CONTINUOUS_PLANE_ITERATIONS; i++) {
+			ConvexShape swept = moving.advanced(direction, spin, travelled);
+			float height = dot(swept.support(-planeNormal) - transform.position, planeNormal);
+
+			if (height <= CONTINUOUS_PLANE_TOLERANCE) {
+				distance = travelled;
+				normal = planeNormal;
+				return distance > 0.f;
+			}
+
+			travelled += height / approach;
+			if (travelled > maxDistance) return false;
+		}
+		return false;
+	}
+	case enumGeometry::TRIANGLE_MESH: {
+		const TriangleMesh& mesh = triangleMeshes[shapeIDs[entity]];
+		mat3 rotation = glm::mat3_cast(transform.rotation);
+
+		bool found = false;
+		mesh.queryAABB(toMeshSpace(sweptBounds, transform), [&](int triangle) {
+			vec3 vertices[3];
+			mesh.getTriangle(triangle, vertices);
+			for (vec3& vertex : vertices) {
+				vertex = transform.position + rotation * (transform.scale * vertex);
+			}
+
+			float triangleDistance;
+			vec3 triangleNormal;
+			ConvexShape triangleShape = ConvexShape::fromTriangle(vertices[0], vertices[1], vertices[2]);
+			if (!GJK::cast(moving, direction, triangleShape, maxDistance, triangleDistance, triangleNormal, spin)) return;
+			if (triangleDistance <= 0.f && dot(direction, triangleNormal) >= 0.f) return;
+
+			maxDistance = triangleDistance;
+			distance = triangleDistance;
+			normal = triangleNormal;
+			found = true;
+		});
+		return found;
+	}
+	default: {
+		ConvexShape shape = getConvexShape(geometries[entity], shapeIDs[entity], transform);
+		if (!GJK::cast(moving, direction, shape, maxDistance, distance, normal, spin)) return false;
+		if (distance > 0.f) return true;
+
+		// Touching from the start only holds it back from static colliders, when it's heading further in. A corner hit
+		// can leave it spinning into a wall harder than the discrete contacts can stop
+		return !manager->hasComponent<PhysicsComponent>(entity) && dot(direction, normal) < 0.f;
+	}
+	}
+}
+
+bool CollisionSystem::raycast(ECS::ECSManager* manager, const Ray& ray, RaycastHit& hit) const {
+	castPacket(manager, &ray, 1, 0.f, &hit);
+	return hit.hasHit();
+}
+
+void CollisionSystem::raycastAll(ECS::ECSManager* manager, const Ray& ray, std::vector<RaycastHit>& hits) const {
+	hits.clear();
+
+	vec3 direction = normalize(ray.direction);
+	vec3 inverseDirection = AABB::getInverseDirection(direction);
+	float maxDistance = ray.maxDistance;
+
+	auto test = [&](int, ECS::uint entity) {
+		RaycastHit hit;
+		if (castEntity(manager, entity, ray.origin, direction, 0.f, maxDistance, hit)) hits.push_back(hit);
+	};
+
+	queryTree.raycastPacket(&ray.origin, &inverseDirection, &maxDistance, 1, 0.f, test);
+	for (int i = 0; i < queryUnboundedCount; i++) {
+		test(0, queryUnboundedEntities[i]);
+	}
+
+	std::sort(hits.begin(), hits.end(), [](const RaycastHit& a, const RaycastHit& b) { return a.distance < b.distance; });
+}
+
+bool CollisionSystem::sphereCast(ECS::ECSManager* manager, const Ray& ray, float radius, RaycastHit& hit) const {
+	castPacket(manager, &ray, 1, radius, &hit);
+	return hit.hasHit();
+}
+
+void CollisionSystem::overlapAABB(ECS::ECSManager* manager, const AABB& bounds, std::vector<ECS::uint>& overlaps) const {
+	overlaps.clear();
+
+	queryTree.query(bounds, [&](ECS::uint entity) {
+		// tree overlap is against fat AABBs
+		if (bounds.overlaps(queryAABBs[entity]) && overlapsEntity(manager, entity, bounds)) overlaps.push_back(entity);
+	});
+
+	for (int i = 0; i < queryUnboundedCount; i++) {
+		if (overlapsEntity(manager, queryUnboundedEntities[i], bounds)) overlaps.push_back(queryUnboundedEntities[i]);
+	}
+}
+
+void CollisionSystem::castPacket(ECS::ECSManager* manager, const Ray* rays, int rayCount, float radius, RaycastHit* hits) const {
+	assert(rayCount > 0 && rayCount <= RAYCAST_PACKET_SIZE);
+
+	vec3 origins[RAYCAST_PACKET_SIZE];
+	vec3 directions[RAYCAST_PACKET_SIZE];
+	vec3 inverseDirections[RAYCAST_PACKET_SIZE];
+	float maxDistances[RAYCAST_PACKET_SIZE];
+
+	for (int i = 0; i < rayCount; i++) {
+		origins[i] = rays[i].origin;
+		directions[i] = normalize(rays[i].direction);
+		inverseDirections[i] = AABB::getInverseDirection(directions[i]);
+		maxDistances[i] = rays[i].maxDistance;
+		hits[i] = RaycastHit();
+	}
+
+	// each ray is cut short at its nearest hit so far, whatever's left in the tree only has to beat that
+	auto test = [&](int ray, ECS::uint entity) {
+		RaycastHit hit;
+		if (!castEntity(manager, entity, origins[ray], directions[ray], radius, maxDistances[ray], hit)) return;
+
+		hits[ray] = hit;
+		maxDistances[ray] = hit.distance;
+	};
+
+	queryTree.raycastPacket(origins, inverseDirections, maxDistances, rayCount, radius, test);
+
+	for (int i = 0; i < queryUnboundedCount; i++) {
+		for (int ray = 0; ray < rayCount; ray++) {
+			test(ray, queryUnboundedEntities[i]);
+		}
+	}
+}
+
+bool CollisionSystem::castEntity(ECS::ECSManager* manager, ECS::uint entity, vec3 origin, vec3 direction, float radius, float maxDistance, RaycastHit& hit) const {
+	const TransformComponent& transform = manager->getComponent<TransformComponent>(entity);
+
+	float distance = 0.f;
+	vec3 normal = -direction; // for casts that start inside
+
+	switch (geometries[entity]) {
+	case enumGeometry::SPHERE: {
+		float combinedRadius = (transform.scale.x + transform.scale.y + transform.scale.z) / 3.f + radius;
+
+		vec3 offset = origin - transform.position;
+		float b = dot(offset, direction);
+		float c = dot(offset, offset) - combinedRadius * combinedRadius;
+		if (c <= 0.f) break;
+
+		// outside and heading away
+		if (b > 0.f) return false;
+
+		float discriminant = b * b - c;
+		if (discriminant < 0.f) return false;
+
+		distance = -b - std::sqrt(discriminant);
+		normal = normalize(offset + direction * distance);
+		break;
+	}
+	case enumGeometry::PLANE: {
+		// same half space as collisions, everything below counts as inside
+		vec3 planeNormal = transform.rotation * vec3(0, 0, 1);
+		normal = planeNormal;
+
+		float height = dot(origin - transform.position, planeNormal) - radius;
+		if (height <= 0.f) break;
+
+		float approach = -dot(direction, planeNormal);
+		if (approach <= 1e-6f) return false;
+
+		distance = height / approach;
+		break;
+	}
+	case enumGeometry::TRIANGLE_MESH:
+		if (!castTriangleMesh(triangleMeshes[shapeIDs[entity]], transform, origin, direction, radius, maxDistance, distance, normal)) return false;
+		break;
+	case enumGeometry::BOX:
+		if (radius == 0.f) {
+			// Slab test in the box's space
+			mat3 rotation = glm::mat3_cast(transform.rotation);
+			vec3 localOrigin = (origin - transform.position) * rotation;
+			vec3 localDirection = direction * rotation;
+			vec3 extents = transform.scale * 0.5f;
+
+			float exit = maxDistance;
+			int enterAxis = -1;
+
+			for (int axis = 0; axis < 3; axis++) {
+				if (std::abs(localDirection[axis]) < 1e-12f) {
+					if (std::abs(localOrigin[axis]) > extents[axis]) return false;
+					continue;
+				}
+
+				float t1 = (-extents[axis] - localOrigin[axis]) / localDirection[axis];
+				float t2 = (extents[axis] - localOrigin[axis]) / localDirection[axis];
+				if (t1 > t2) std::swap(t1, t2);
+
+				if (t1 > distance) {
+					distance = t1;
+					enterAxis = axis;
+				}
+				exit = std::min(exit, t2);
+
+				if (distance > exit) return false;
+			}
+
+			if (enterAxis >= 0) normal = rotation[enterAxis] * (localDirection[enterAxis] > 0.f ? -1.f : 1.f);
+			break;
+		}
+		// swept boxes go through GJK like everything else
+		[[fallthrough]];
+	default: {
+		ConvexShape shape = getConvexShape(geometries[entity], shapeIDs[entity], transform);
+		if (!GJK::cast(ConvexShape::fromSphere(origin, radius), direction, shape, maxDistance, distance, normal)) return false;
+		break;
+	}
+	}
+
+	if (distance > maxDistance) return false;
+
+	hit.entity = entity;
+	hit.distance = distance;
+	hit.point = origin + direction * distance - normal * radius;
+	hit.normal = normal;
+	return true;
+}
+
+bool CollisionSystem::castTriangleMesh(const TriangleMesh& mesh, const TransformComponent& transform, vec3 origin, vec3 direction, float radius, float maxDistance, float& distance, vec3& normal) {
+	mat3 rotation = glm::mat3_cast(transform.rotation);
+
+	// The same segment in local space, t still measures world distance.
+	// A sphere squashes into an ellipsoid there, its longest axis bounds it
+	vec3 localOrigin = ((origin - transform.position) * rotation) / transform.scale;
+	vec3 localDirection = (direction * rotation) / transform.scale;
+	vec3 absScale = abs(transform.scale);
+	float localRadius = radius / std::min(std::min(absScale.x, absScale.y), absScale.z);
+
+	bool found = false;
+	mesh.raycast(localOrigin, localDirection, maxDistance, localRadius, [&](int triangle) {
+		vec3 vertices[3];
+		mesh.getTriangle(triangle, vertices);
+		for (vec3& vertex : vertices) {
+			vertex = transform.position + rotation * (transform.scale * vertex);
+		}
+
+		float triangleDistance;
+		vec3 triangleNormal;
+
+		if (radius > 0.f) {
+			ConvexShape triangleShape = ConvexShape::fromTriangle(vertices[0], vertices[1], vertices[2]);
+			if (!GJK::cast(ConvexShape::fromSphere(origin, radius), direction, triangleShape, maxDistance, triangleDistance, triangleNormal)) return maxDistance;
+		}
+		else {
+			if (!intersectRayTriangle(origin, direction, vertices, triangleDistance) || triangleDistance > maxDistance) return maxDistance;
+
+			// meshes are two sided
+			triangleNormal = normalize(cross(vertices[1] - vertices[0], vertices[2] - vertices[0]));
+			if (dot(triangleNormal, direction) > 0.f) triangleNormal = -triangleNormal;
+		}
+
+		found = true;
+		distance = triangleDistance;
+		normal = triangleNormal;
+		maxDistance = triangleDistance;
+		return maxDistance;
+	});
+
+	return found;
+}
+
+// Moller-Trumbore, either side of the triangle
+bool CollisionSystem::intersectRayTriangle(vec3 origin, vec3 direction, const vec3 triangle[3], float& distance) {
+	vec3 edge1 = triangle[1] - triangle[0];
+	vec3 edge2 = triangle[2] - triangle[0];
+
+	vec3 p = cross(direction, edge2);
+	float determinant = dot(edge1, p);
+
+	// parallel to the triangle, or the triangle has no area
+	if (std::abs(determinant) < 1e-12f) return false;
+	float inverseDeterminant = 1.f / determinant;
+
+	vec3 offset = origin - triangle[0];
+	float u = dot(offset, p) * inverseDeterminant;
+	if (u < 0.f || u > 1.f) return false;
+
+	vec3 q = cross(offset, edge1);
+	float v = dot(direction, q) * inverseDeterminant;
+	if (v < 0.f || u + v > 1.f) return false;
+
+	distance = dot(edge2, q) * inverseDeterminant;
+	return distance >= 0.f;
+}
+
+bool CollisionSystem::overlapsEntity(ECS::ECSManager* manager, ECS::uint entity, const AABB& bounds) const {
+	const TransformComponent& transform = manager->getComponent<TransformComponent>(entity);
+
+	ConvexShape box = { enumGeometry::BOX, bounds.getCentre(), quat(1, 0, 0, 0) };
+	box.extents = (bounds.max - bounds.min) * 0.5f;
+
+	switch (geometries[entity]) {
+	case enumGeometry::PLANE: {
+		// the box's lowest corner is below the plane
+		vec3 planeNormal = transform.rotation * vec3(0, 0, 1);
+		return dot(box.position - transform.position, planeNormal) <= dot(abs(planeNormal), box.extents);
+	}
+	case enumGeometry::TRIANGLE_MESH: {
+		const TriangleMesh& mesh = triangleMeshes[shapeIDs[entity]];
+		mat3 rotation = glm::mat3_cast(transform.rotation);
+
+		bool overlapping = false;
+		mesh.queryAABB(toMeshSpace(bounds, transform), [&](int triangle) {
+			if (overlapping) return;
+
+			vec3 vertices[3];
+			mesh.getTriangle(triangle, vertices);
+			for (vec3& vertex : vertices) {
+				vertex = transform.position + rotation * (transform.scale * vertex);
+			}
+
+			GJKResult closest = GJK::distance(box, ConvexShape::fromTriangle(vertices[0], vertices[1], vertices[2]), vec3(0), 0.f);
+			overlapping = !closest.separated && (closest.overlapping || closest.distance <= 1e-5f);
+		});
+		return overlapping;
+	}
+	default: {
+		ConvexShape shape = getConvexShape(geometries[entity], shapeIDs[entity], transform);
+		GJKResult closest = GJK::distance(box, shape, vec3(0), shape.margin);
+		return !closest.separated && (closest.overlapping || closest.distance <= shape.margin);
+	}
+	}
+}
 
 void CollisionSystem::checkCollisionBoxBox(IPhysicsEngine* physicsEngine, ECS::uint entityA, const TransformComponent& boxA, ECS::uint entityB, const TransformComponent& boxB) {
-	vec3 vertsA[8];
-	vec3 vertsB[8];
-	getGlobalBoxVerts(vertsA, boxA);
-	getGlobalBoxVerts(vertsB, boxB);
+	vec3 extentsA = boxA.scale * 0.5f;
+	vec3 extentsB = boxB.scale * 0.5f;
+
+	// Boxes closer than this along every axis still get speculative contacts
+	float margin = physicsEngine->speculativeMargin;
 
 	// axes[0-15]
 	// 0-2 A face norms
@@ -21,18 +635,26 @@ void CollisionSystem::checkCollisionBoxBox(IPhysicsEngine* physicsEngine, ECS::u
 		axes[i + 3] = boxB.rotation * axis; // B face normals
 	}
 
-	// co-planar edge plane normals
-	for (int i = 0; i < 3; i++) {
-		for (int n = 0; n < 3; n++) {
-			if (abs(dot(axes[i], axes[n + 3])) > 0.9999f) {
-				axes[(i * 3 + n) + 6] = vec3(0);
-				continue;
-			}
+	// Whichever axis decided this pair last tick goes first, pairs that were apart along it usually still are
+	unsigned char& cachedAxis = pairCache.fetch(activePairKey).separatingAxis;
+	if (cachedAxis != PairCache::noAxis) {
+		vec3 axis = cachedAxis < 6 ? axes[cachedAxis] : getEdgeAxis(axes, cachedAxis);
 
-			axes[(i * 3 + n) + 6] = normalize(cross(axes[i], axes[n + 3]));
+		float minA, maxA, minB, maxB;
+		getBoxProjection(axis, boxA.position, &axes[0], extentsA, minA, maxA);
+		getBoxProjection(axis, boxB.position, &axes[3], extentsB, minB, maxB);
+
+		if (axis != vec3(0) && (maxA + margin < minB || maxB + margin < minA)) {
+			PHYSICS_PROFILE_COUNT(physicsEngine->profiler, enumPhysicsCounter::SAT_EARLY_OUTS, 1);
+			return;
 		}
 	}
 
+	// co-planar edge plane normals
+	for (int i = 6; i < 15; i++) {
+		axes[i] = getEdgeAxis(axes, i);
+	}
+
 	int minIndex = -1;
 	float minOverlap = FLT_MAX;
 	vec3 worldNorm = vec3(0);
@@ -49,16 +671,22 @@ void CollisionSystem::checkCollisionBoxBox(IPhysicsEngine* physicsEngine, ECS::u
 		float minB;
 		float maxB;
 
-		getMinMaxProjection(axis, vertsA, minA, maxA);
-		getMinMaxProjection(axis, vertsB, minB, maxB);
+		getBoxProjection(axis, boxA.position, &axes[0], extentsA, minA, maxA);
+		getBoxProjection(axis, boxB.position, &axes[3], extentsB, minB, maxB);
 
-		if (maxA < minB || maxB < minA) {
+		if (maxA + margin < minB || maxB + margin < minA) {
 			// found a separating axis
+			cachedAxis = (unsigned char)i;
 			return;
 		}
 
 		float overlap = glm::min(maxA - minB, maxB - minA);
-		if (overlap > minOverlap) {
+
+		// Prefer A's faces, then B's faces, then edges. Edge axes can line up with face normals,
+		// and near ties shouldn't flip the contact type (and its feature IDs) between ticks.
+		// Apart boxes have negative overlaps, where the widest gap is the one that counts.
+		float tolerance = i < 3 ? 1.f : (i < 6 ? 0.98f : 0.95f);
+		if (overlap >= (minOverlap > 0.f ? minOverlap * tolerance : minOverlap / tolerance)) {
 			continue;
 		}
 
@@ -76,43 +704,41 @@ void CollisionSystem::checkCollisionBoxBox(IPhysicsEngine* physicsEngine, ECS::u
 		}
 	}
 
+	// the shallowest axis is the one most likely to separate them next
+	cachedAxis = (unsigned char)minIndex;
+
 	CollisionECS collision = {
 		.entityA = entityA,
 		.entityB = entityB,
 		.worldNormal = worldNorm
 	};
 
-	vec3 extentsA = boxA.scale * 0.5f;
-	vec3 extentsB = boxB.scale * 0.5f;
-
-	// Vert B on Face A
-	if (minIndex < 3) {
-		vec3 faceA = boxA.position + worldNorm * extentsA[minIndex]; // x,y,z index should line up.
+	// Face contact, clip the incident face against the reference face and keep up to 4 points
+	if (minIndex < 6) {
+		bool referenceIsA = minIndex < 3;
+		int refAxis = referenceIsA ? minIndex : minIndex - 3;
 
-		for (int i = 0; i < 8; i++) {
-			if (dot(vertsB[i] - faceA, worldNorm) < 0.f) {
-				collision.pointB = vertsB[i];
-				collision.depth = dot(faceA, worldNorm) - dot(collision.pointB, worldNorm);
-				collision.pointA = collision.pointB + worldNorm * collision.depth;
-
-				physicsEngine->addCollisionECS(collision);
-				//break;
-			}
+		ManifoldPoint candidates[8];
+		int candidateCount = 0;
+		if (referenceIsA) {
+			candidateCount = clipBoxFaces(boxA, &axes[0], refAxis, worldNorm, boxB, &axes[3], margin, candidates);
+		}
+		else {
+			candidateCount = clipBoxFaces(boxB, &axes[3], refAxis, -worldNorm, boxA, &axes[0], margin, candidates);
 		}
-	}
-	// Vert A on Face B
-	else if (minIndex < 6) {
-		vec3 faceB = boxB.position - worldNorm * extentsB[minIndex - 3]; // x,y,z index should line up.
 
-		for (int i = 0; i < 8; i++) {
-			if (dot(vertsA[i] - faceB, -worldNorm) < 0.f) {
-				collision.pointA = vertsA[i];
-				collision.depth = dot(faceB, -worldNorm) - dot(collision.pointA, -worldNorm);
-				collision.pointB = collision.pointA - worldNorm * collision.depth;
+		ManifoldPoint manifold[MAX_MANIFOLD_POINTS];
+		int pointCount = reduceManifold(candidates, candidateCount, worldNorm, manifold);
+		PHYSICS_PROFILE_COUNT(physicsEngine->profiler, enumPhysicsCounter::CONTACTS_DROPPED, candidateCount - pointCount);
 
-				physicsEngine->addCollisionECS(collision);
-				//break;
-			}
+		for (int i = 0; i < pointCount; i++) {
+			// clipped points come out as (reference, incident)
+			collision.pointA = referenceIsA ? manifold[i].pointA : manifold[i].pointB;
+			collision.pointB = referenceIsA ? manifold[i].pointB : manifold[i].pointA;
+			collision.depth = manifold[i].depth;
+			collision.featureID = manifold[i].featureID | (referenceIsA ? 0 : 1 << 11);
+
+			physicsEngine->addCollisionECS(collision);
 		}
 	}
 	// Edge on Edge collision
@@ -188,6 +814,7 @@ void CollisionSystem::checkCollisionBoxBox(IPhysicsEngine* physicsEngine, ECS::u
 		collision.pointA = edgeBaseA + edgeNormA * std::max(std::min(t1, extentsA[edgeNormIndexA] * 2.f), 0.f);
 		collision.pointB = edgeBaseB + edgeNormB * std::max(std::min(t2, extentsB[edgeNormIndexB] * 2.f), 0.f);
 		collision.depth = minOverlap;
+		collision.featureID = (1 << 12) | (minIndex - 6);
 		// ^^^^^^^^^^^^^^^^^^^^^^^^^^^^
 		// I have a hunch something here occasionally gives inaccurate values during certain edge cases.
 
@@ -211,7 +838,7 @@ void CollisionSystem::checkCollisionBoxSphere(IPhysicsEngine* physicsEngine, ECS
 	vec3 vertexOffset = absOffset - extents;
 
 
-	if (length(max(vertexOffset, vec3(0))) > radius) {
+	if (length(max(vertexOffset, vec3(0))) > radius + physicsEngine->speculativeMargin) {
 		// entire sphere outside box
 		return;
 	}
@@ -265,15 +892,16 @@ void CollisionSystem::checkCollisionSphereSphere(IPhysicsEngine* physicsEngine,
 	float radiusA = (sphereA.scale.x + sphereA.scale.y + sphereA.scale.z) / 3.f;
 	float radiusB = (sphereB.scale.x + sphereB.scale.y + sphereB.scale.z) / 3.f;
 	float radii = radiusA + radiusB;
+	float reach = radii + physicsEngine->speculativeMargin;
 
 	vec3 AtoB = sphereB.position - sphereA.position;
 	float sqrDist = dot(AtoB, AtoB);
 
-	if (sqrDist > radii * radii) {
+	if (sqrDist > reach * reach) {
 		return;
 	}
 
-	float dist = sqrt(sqrDist);
+	float dist = std::sqrt(sqrDist);
 	vec3 norm = AtoB * (1 / dist);
 
 	CollisionECS collision = {
@@ -296,6 +924,9 @@ void CollisionSystem::checkCollisionBoxPlane(IPhysicsEngine* physicsEngine, ECS:
 
 	// for now planes will be infinite regardless of their scale
 
+	ManifoldPoint candidates[8];
+	int candidateCount = 0;
+
 	for (int n = 0; n < 8; n++) {
 		vec3 vertOffset = vec3((n >> 2) & 1, (n >> 1) & 1, n & 1);
 		vertOffset = extents * (vertOffset * 2.f - vec3(1));
@@ -303,14 +934,24 @@ void CollisionSystem::checkCollisionBoxPlane(IPhysicsEngine* physicsEngine, ECS:
 		vec3 vertex = box.position + (box.rotation * vertOffset);
 
 		float separation = dot(vertex - plane.position, planeNormal);
-		if (separation > 0.f) { continue; }
+		if (separation > physicsEngine->speculativeMargin) { continue; }
 
+		candidates[candidateCount++] = { vertex, vertex - planeNormal * separation, -separation, (unsigned int)n };
+	}
+
+	ManifoldPoint manifold[MAX_MANIFOLD_POINTS];
+	int pointCount = reduceManifold(candidates, candidateCount, planeNormal, manifold);
+	PHYSICS_PROFILE_COUNT(physicsEngine->profiler, enumPhysicsCounter::CONTACTS_DROPPED, candidateCount - pointCount);
+
+	for (int i = 0; i < pointCount; i++) {
 		CollisionECS collision = {
 			.entityA = entityA,
 			.entityB = entityB,
 			.worldNormal = -planeNormal,
-			.pointA = vertex,
-			.depth = -separation
+			.pointA = manifold[i].pointA,
+			.pointB = manifold[i].pointB,
+			.depth = manifold[i].depth,
+			.featureID = manifold[i].featureID
 		};
 
 		physicsEngine->addCollisionECS(collision);
@@ -324,7 +965,7 @@ void CollisionSystem::checkCollisionSpherePlane(IPhysicsEngine* physicsEngine, E
 	vec3 planeNormal = plane.rotation * vec3(0, 0, 1);
 
 	float separation = dot(sphere.position - plane.position, planeNormal) - radius;
-	if (separation < 0.f) {
+	if (separation < physicsEngine->speculativeMargin) {
 		CollisionECS collision = {
 			.entityA = entityA,
 			.entityB = entityB,
@@ -337,37 +978,397 @@ void CollisionSystem::checkCollisionSpherePlane(IPhysicsEngine* physicsEngine, E
 	}
 }
 
-void CollisionSystem::checkCollisionPlanePlane(IPhysicsEngine* physicsEngine, ECS::uint entityA, const TransformComponent& planeA, ECS::uint entityB, const TransformComponent& planeB) {
+void CollisionSystem::checkCollisionPlanePlane(IPhysicsEngine*, ECS::uint, const TransformComponent&, ECS::uint, const TransformComponent&) {
 	// Do nothing
 
 }
 
+void CollisionSystem::checkCollisionConvex(IPhysicsEngine* physicsEngine, ECS::uint entityA, const TransformComponent& transformA, ECS::uint entityB, const TransformComponent& transformB) {
+	ConvexShape shapeA = getConvexShape(geometries[entityA], shapeIDs[entityA], transformA);
+	ConvexShape shapeB = getConvexShape(geometries[entityB], shapeIDs[entityB], transformB);
 
+	// Starting from last tick's normal, pairs that haven't moved much are settled in an iteration or two
+	PenetrationResult contact;
+	if (!findConvexContact(physicsEngine, shapeA, shapeB, pairCache.fetch(activePairKey).convexDirection, contact)) return;
 
-void CollisionSystem::getGlobalBoxVerts(vec3 verts[8], const TransformComponent& box) {
-	vec3 extents = box.scale * 0.5f;
+	ManifoldPoint manifold[MAX_MANIFOLD_POINTS];
+	int pointCount = buildConvexManifold(physicsEngine, shapeA, shapeB, contact, manifold);
 
-	for (int i = 0; i < 8; i++) {
-		vec3 permutation = vec3((i >> 2) & 1, (i >> 1) & 1, i & 1);
-		vec3 vertex = extents * (permutation * 2.f - vec3(1));
+	for (int i = 0; i < pointCount; i++) {
+		CollisionECS collision = {
+			.entityA = entityA,
+			.entityB = entityB,
+			.worldNormal = contact.normal,
+			.pointA = manifold[i].pointA,
+			.pointB = manifold[i].pointB,
+			.depth = manifold[i].depth,
+			.featureID = manifold[i].featureID
+		};
 
-		verts[i] = box.position + box.rotation * vertex;
+		physicsEngine->addCollisionECS(collision);
 	}
 }
 
-void CollisionSystem::getMinMaxProjection(vec3 axis, vec3 points[8], float& min, float& max) {
-	float projection = dot(points[0], axis);
-	max = projection;
-	min = projection;
+void CollisionSystem::checkCollisionConvexMesh(IPhysicsEngine* physicsEngine, ECS::uint entityA, const TransformComponent& transformA, ECS::uint entityB, const TransformComponent& meshTransform) {
+	ConvexShape shape = getConvexShape(geometries[entityA], shapeIDs[entityA], transformA);
+	const TriangleMesh& mesh = triangleMeshes[shapeIDs[entityB]];
 
-	for (int i = 1; i < 8; i++) {
-		projection = dot(points[i], axis);
+	mat3 rotation = glm::mat3_cast(meshTransform.rotation);
 
-		if (projection > max) {
-			max = projection;
+	// Shapes sliding across a flat run of triangles would catch on the edges between them if EPA had its way,
+	// so the face normal wins unless pushing out through an edge is shallower by more than this
+	constexpr float internalEdgeTolerance = 0.05f;
+
+	mesh.queryAABB(toMeshSpace(aabbs[entityA], meshTransform), [&](int triangle) {
+		PHYSICS_PROFILE_COUNT(physicsEngine->profiler, enumPhysicsCounter::TRIANGLES_TESTED, 1);
+
+		vec3 vertices[3];
+		mesh.getTriangle(triangle, vertices);
+		for (vec3& vertex : vertices) {
+			vertex = meshTransform.position + rotation * (meshTransform.scale * vertex);
 		}
-		if (projection < min) {
-			min = projection;
+
+		ConvexShape triangleShape = ConvexShape::fromTriangle(vertices[0], vertices[1], vertices[2]);
+
+		vec3 direction = vec3(0);
+		PenetrationResult contact;
+		if (!findConvexContact(physicsEngine, shape, triangleShape, direction, contact)) return;
+
+		vec3 faceNormal = cross(vertices[1] - vertices[0], vertices[2] - vertices[0]);
+		if (dot(faceNormal, faceNormal) < 1e-12f) return;
+		faceNormal = normalize(faceNormal);
+		if (dot(faceNormal, shape.position - vertices[0]) < 0.f) faceNormal = -faceNormal;
+
+		vec3 deepest = shape.support(-faceNormal);
+		float faceDepth = dot(vertices[0] - deepest, faceNormal);
+		if (faceDepth < contact.depth + internalEdgeTolerance) {
+			contact.normal = -faceNormal;
+			contact.depth = faceDepth;
+			contact.pointA = deepest;
+			contact.pointB = deepest + faceNormal * faceDepth;
+		}
+
+		ManifoldPoint manifold[MAX_MANIFOLD_POINTS];
+		int pointCount = buildConvexManifold(physicsEngine, shape, triangleShape, contact, manifold);
+
+		for (int i = 0; i < pointCount; i++) {
+			// manifold feature IDs stay below meshTriangleShift, the triangle goes above them
+			unsigned int featureID = manifold[i].featureID | ((unsigned int)triangle << meshTriangleShift);
+
+			CollisionECS collision = {
+				.entityA = entityA,
+				.entityB = entityB,
+				.worldNormal = contact.normal,
+				.pointA = manifold[i].pointA,
+				.pointB = manifold[i].pointB,
+				.depth = manifold[i].depth,
+				.featureID = featureID
+			};
+
+			physicsEngine->addCollisionECS(collision);
 		}
+	});
+}
+
+AABB CollisionSystem::toMeshSpace(const AABB& bounds, const TransformComponent& meshTransform) {
+	mat3 inverseRotation = glm::transpose(glm::mat3_cast(meshTransform.rotation));
+
+	vec3 centre = (inverseRotation * (bounds.getCentre() - meshTransform.position)) / meshTransform.scale;
+	vec3 halfSize = (bounds.max - bounds.min) * 0.5f;
+	vec3 localHalfSize = vec3(0);
+	for (int i = 0; i < 3; i++) {
+		localHalfSize += abs(inverseRotation[i]) * halfSize[i];
+	}
+	localHalfSize /= abs(meshTransform.scale);
+
+	return { centre - localHalfSize, centre + localHalfSize };
+}
+
+bool CollisionSystem::findConvexContact(IPhysicsEngine* physicsEngine, const ConvexShape& a, const ConvexShape& b, vec3& direction, PenetrationResult& contact) {
+	float margins = a.margin + b.margin;
+
+	GJKResult closest = GJK::distance(a, b, direction, margins + physicsEngine->speculativeMargin);
+	PHYSICS_PROFILE_COUNT(physicsEngine->profiler, enumPhysicsCounter::GJK_ITERATIONS, closest.iterations);
+
+	if (closest.separated) {
+		direction = closest.normal;
+		return false;
 	}
-}
\ No newline at end of file
+
+	if (!closest.overlapping && closest.distance > 1e-5f) {
+		// Cores apart but within the margins (speculative when past them), the closest points give the contact directly
+		contact.normal = closest.normal;
+		contact.depth = margins - closest.distance;
+		contact.pointA = closest.pointA + contact.normal * a.margin;
+		contact.pointB = closest.pointB - contact.normal * b.margin;
+	}
+	else if (!GJK::penetration(a, b, direction, contact)) {
+		return false;
+	}
+
+	direction = contact.normal;
+	return true;
+}
+
+int CollisionSystem::buildConvexManifold(IPhysicsEngine* physicsEngine, const ConvexShape& a, const ConvexShape& b, const PenetrationResult& contact, ManifoldPoint manifold[MAX_MANIFOLD_POINTS]) {
+	// Faces or parallel edges facing each other get a full manifold, anything else touches at one point
+	vec3 featureA[MAX_FEATURE_POINTS];
+	vec3 featureB[MAX_FEATURE_POINTS];
+	int countA = a.getFeature(contact.normal, featureA);
+	int countB = b.getFeature(-contact.normal, featureB);
+
+	ManifoldPoint candidates[MAX_FEATURE_POINTS * 2];
+	int candidateCount = clipFeatures(featureA, countA, featureB, countB, contact.normal, physicsEngine->speculativeMargin, candidates);
+
+	if (candidateCount == 0) {
+		candidates[0] = { contact.pointA, contact.pointB, contact.depth, 0 };
+		candidateCount = 1;
+	}
+
+	int pointCount = reduceManifold(candidates, candidateCount, contact.normal, manifold);
+	PHYSICS_PROFILE_COUNT(physicsEngine->profiler, enumPhysicsCounter::CONTACTS_DROPPED, candidateCount - pointCount);
+
+	return pointCount;
+}
+
+void CollisionSystem::checkCollisionPlaneConvex(IPhysicsEngine* physicsEngine, ECS::uint entityA, const TransformComponent& plane, ECS::uint entityB, const TransformComponent& transformB) {
+	ConvexShape shape = getConvexShape(geometries[entityB], shapeIDs[entityB], transformB);
+
+	// assume planes face up by default
+	vec3 planeNormal = plane.rotation * vec3(0, 0, 1);
+
+	// Whatever part of the shape reaches furthest below the plane
+	vec3 feature[MAX_FEATURE_POINTS];
+	int featureCount = shape.getFeature(-planeNormal, feature);
+
+	ManifoldPoint candidates[MAX_FEATURE_POINTS];
+	int candidateCount = 0;
+
+	for (int i = 0; i < featureCount; i++) {
+		float separation = dot(feature[i] - plane.position, planeNormal);
+		if (separation > physicsEngine->speculativeMargin) { continue; }
+
+		candidates[candidateCount++] = { feature[i] - planeNormal * separation, feature[i], -separation, (unsigned int)i };
+	}
+
+	ManifoldPoint manifold[MAX_MANIFOLD_POINTS];
+	int pointCount = reduceManifold(candidates, candidateCount, planeNormal, manifold);
+	PHYSICS_PROFILE_COUNT(physicsEngine->profiler, enumPhysicsCounter::CONTACTS_DROPPED, candidateCount - pointCount);
+
+	for (int i = 0; i < pointCount; i++) {
+		CollisionECS collision = {
+			.entityA = entityA,
+			.entityB = entityB,
+			.worldNormal = planeNormal,
+			.pointA = manifold[i].pointA,
+			.pointB = manifold[i].pointB,
+			.depth = manifold[i].depth,
+			.featureID = manifold[i].featureID
+		};
+
+		physicsEngine->addCollisionECS(collision);
+	}
+}
+
+
+
+// Clips the incident box's face against the side planes of the reference face.
+// 'refNormal' is the reference face normal, pointing from the reference box towards the incident box.
+// Returns points below the reference face, or less than 'margin' above it, as pointA = projected onto the reference face, pointB = on the incident box.
+int CollisionSystem::clipBoxFaces(const TransformComponent& refBox, const vec3 refAxes[3], int refAxis, vec3 refNormal,
+	const TransformComponent& incBox, const vec3 incAxes[3], float margin, ManifoldPoint out[8]) {
+
+	vec3 refExtents = refBox.scale * 0.5f;
+	vec3 incExtents = incBox.scale * 0.5f;
+
+	vec3 refCentre = refBox.position + refNormal * refExtents[refAxis];
+	unsigned int refFace = refAxis * 2 + (dot(refNormal, refAxes[refAxis]) < 0.f ? 1 : 0);
+
+	// Incident face is the one most anti-parallel to the reference normal
+	int incAxis = 0;
+	float maxAlignment = -1.f;
+	for (int i = 0; i < 3; i++) {
+		float alignment = std::abs(dot(incAxes[i], refNormal));
+		if (alignment > maxAlignment) {
+			maxAlignment = alignment;
+			incAxis = i;
+		}
+	}
+
+	vec3 incNormal = dot(incAxes[incAxis], refNormal) > 0.f ? -incAxes[incAxis] : incAxes[incAxis];
+	unsigned int incFace = incAxis * 2 + (dot(incNormal, incAxes[incAxis]) < 0.f ? 1 : 0);
+
+	vec3 incCentre = incBox.position + incNormal * incExtents[incAxis];
+	vec3 side1 = incAxes[(incAxis + 1) % 3] * incExtents[(incAxis + 1) % 3];
+	vec3 side2 = incAxes[(incAxis + 2) % 3] * incExtents[(incAxis + 2) % 3];
+
+	// Vertices 0-3 are the incident face corners
+	ClipVertex polygon[8] = {
+		{ incCentre + side1 + side2, 0, getClipEdgeFeature(0, 1) },
+		{ incCentre - side1 + side2, 1, getClipEdgeFeature(1, 2) },
+		{ incCentre - side1 - side2, 2, getClipEdgeFeature(2, 3) },
+		{ incCentre + side1 - side2, 3, getClipEdgeFeature(3, 0) }
+	};
+	int polygonCount = 4;
+
+	for (int i = 0; i < 4; i++) {
+		int sideAxis = (refAxis + 1 + i / 2) % 3;
+		vec3 planeNormal = (i % 2 == 0) ? refAxes[sideAxis] : -refAxes[sideAxis];
+		float planeOffset = dot(refCentre, planeNormal) + refExtents[sideAxis];
+
+		ClipVertex clipped[8];
+		polygonCount = clipPolygon(polygon, polygonCount, planeNormal, planeOffset, i, clipped);
+
+		for (int n = 0; n < polygonCount; n++) {
+			polygon[n] = clipped[n];
+		}
+	}
+
+	// clipped IDs stay below bit 11, which the caller uses to mark B as the reference
+	unsigned int baseFeature = (refFace << 16) | (incFace << 13);
+
+	int count = 0;
+	for (int i = 0; i < polygonCount; i++) {
+		float separation = dot(polygon[i].position - refCentre, refNormal);
+		if (separation >= margin) continue;
+
+		out[count++] = { polygon[i].position - refNormal * separation, polygon[i].position, -separation, baseFeature | polygon[i].featureID };
+	}
+
+	return count;
+}
+
+int CollisionSystem::clipFeatures(const vec3* featureA, int countA, const vec3* featureB, int countB, vec3 normal, float margin, ManifoldPoint out[MAX_FEATURE_POINTS * 2]) {
+	bool referenceIsA = countA >= countB;
+	const vec3* reference = referenceIsA ? featureA : featureB;
+	const vec3* incident = referenceIsA ? featureB : featureA;
+	int referenceCount = referenceIsA ? countA : countB;
+	int incidentCount = referenceIsA ? countB : countA;
+
+	// points from the reference feature towards the incident one
+	vec3 refNormal = referenceIsA ? normal : -normal;
+
+	if (referenceCount == 1) return 0;
+
+	// Side planes that bound the reference feature, its end planes when it's an edge
+	vec3 planeNormals[MAX_FEATURE_POINTS];
+	float planeOffsets[MAX_FEATURE_POINTS];
+	int planeCount = 0;
+
+	if (referenceCount == 2) {
+		vec3 edge = normalize(reference[1] - reference[0]);
+
+		// edges that cross only touch at one point
+		if (incidentCount != 2 || length(cross(edge, normalize(incident[1] - incident[0]))) > FEATURE_EDGE_TOLERANCE) return 0;
+
+		planeNormals[0] = edge;
+		planeOffsets[0] = dot(reference[1], edge);
+		planeNormals[1] = -edge;
+		planeOffsets[1] = dot(reference[0], -edge);
+		planeCount = 2;
+	}
+	else {
+		vec3 centre = vec3(0);
+		for (int i = 0; i < referenceCount; i++) centre += reference[i];
+		centre /= (float)referenceCount;
+
+		for (int i = 0; i < referenceCount; i++) {
+			vec3 planeNormal = normalize(cross(reference[(i + 1) % referenceCount] - reference[i], refNormal));
+			if (dot(planeNormal, centre - reference[i]) > 0.f) planeNormal = -planeNormal;
+
+			planeNormals[planeCount] = planeNormal;
+			planeOffsets[planeCount] = dot(reference[i], planeNormal);
+			planeCount++;
+		}
+	}
+
+	// each plane can add at most one vertex
+	ClipVertex polygon[MAX_FEATURE_POINTS * 3];
+	int polygonCount = incidentCount;
+	for (int i = 0; i < incidentCount; i++) {
+		polygon[i] = { incident[i], (unsigned int)i, getClipEdgeFeature(i, (i + 1) % incidentCount) };
+	}
+
+	for (int i = 0; i < planeCount && polygonCount > 0; i++) {
+		ClipVertex clipped[MAX_FEATURE_POINTS * 3];
+		polygonCount = clipPolygon(polygon, polygonCount, planeNormals[i], planeOffsets[i], i, clipped);
+
+		// an edge is clipped as a two sided polygon, so a cut end comes out twice
+		int kept = 0;
+		for (int n = 0; n < polygonCount; n++) {
+			bool duplicate = false;
+			for (int k = 0; k < kept && !duplicate; k++) {
+				vec3 offset = clipped[n].position - polygon[k].position;
+				duplicate = dot(offset, offset) < 1e-10f;
+			}
+			if (!duplicate) polygon[kept++] = clipped[n];
+		}
+		polygonCount = kept;
+	}
+
+	int count = 0;
+	for (int i = 0; i < polygonCount && count < MAX_FEATURE_POINTS * 2; i++) {
+		float separation = dot(polygon[i].position - reference[0], refNormal);
+		if (separation >= margin) continue;
+
+		vec3 onReference = polygon[i].position - refNormal * separation;
+		unsigned int featureID = polygon[i].featureID | (referenceIsA ? 0 : 1 << 11);
+
+		if (referenceIsA) {
+			out[count++] = { onReference, polygon[i].position, -separation, featureID };
+		}
+		else {
+			out[count++] = { polygon[i].position, onReference, -separation, featureID };
+		}
+	}
+
+	return count;
+}
+
+// Sutherland-Hodgman against a single plane, keeps the side where dot(p, planeNormal) <= planeOffset
+int CollisionSystem::clipPolygon(const ClipVertex* polygon, int count, vec3 planeNormal, float planeOffset, int planeIndex, ClipVertex* out) {
+	int outCount = 0;
+
+	for (int i = 0; i < count; i++) {
+		const ClipVertex& a = polygon[i];
+		const ClipVertex& b = polygon[(i + 1) % count];
+
+		float distA = dot(a.position, planeNormal) - planeOffset;
+		float distB = dot(b.position, planeNormal) - planeOffset;
+
+		if (distA <= 0.f) {
+			out[outCount++] = a;
+		}
+
+		if ((distA <= 0.f) != (distB <= 0.f)) {
+			float t = distA / (distA - distB);
+
+			// leaving, the polygon carries on along this plane until it comes back in
+			unsigned int segmentFeature = distA <= 0.f ? getClipPlaneFeature(planeIndex) : a.segmentFeature;
+			out[outCount++] = { a.position + (b.position - a.position) * t, a.segmentFeature | planeIndex, segmentFeature };
+		}
+	}
+
+	return outCount;
+}
+
+vec3 CollisionSystem::getEdgeAxis(const vec3 faceAxes[6], int index) {
+	vec3 axisA = faceAxes[(index - 6) / 3];
+	vec3 axisB = faceAxes[(index - 6) % 3 + 3];
+
+	// parallel edges don't give an axis
+	if (std::abs(dot(axisA, axisB)) > 0.9999f) {
+		return vec3(0);
+	}
+
+	return normalize(cross(axisA, axisB));
+}
+
+void CollisionSystem::getBoxProjection(vec3 axis, vec3 position, const vec3 boxAxes[3], vec3 extents, float& min, float& max) {
+	// the vertex furthest along 'axis' is the centre plus each extent in whichever direction faces it
+	float centre = dot(position, axis);
+	float radius = std::abs(dot(axis, boxAxes[0])) * extents.x + std::abs(dot(axis, boxAxes[1])) * extents.y + std::abs(dot(axis, boxAxes[2])) * extents.z;
+
+	min = centre - radius;
+	max = centre + radius;
+}
@@ -5,59 +5,273 @@
 #include "IPhysicsEngine.h"
 
 #include "Collision.h"
+#include "SceneQuery.h"
+#include "ContactManifold.h"
+#include "ConvexShape.h"
+#include "GJK.h"
+#include "TriangleMesh.h"
+#include "Broadphase.h"
+#include "DynamicAABBTree.h"
+#include "PairCache.h"
 
 #include "glmAddon.h"
 
 
+// How far a continuous body is let into what it hits, as a fraction of its inner radius
+#define CONTINUOUS_IMPACT_DEPTH 0.25f
+// Sweeps against planes advance like GJK::cast, a turning body can take a few steps to close in
+#define CONTINUOUS_PLANE_ITERATIONS 16
+#define CONTINUOUS_PLANE_TOLERANCE 1e-4f
+
+
+namespace enumBroadphase {
+	enum type : unsigned int {
+		BRUTE_FORCE, // every pair goes to narrowphase, kept as a reference
+		SWEEP_AND_PRUNE,
+		DYNAMIC_AABB_TREE
+	};
+}
+
+
 class CollisionSystem : public ECS::System {
 public:
+	enumBroadphase::type broadphase = enumBroadphase::SWEEP_AND_PRUNE;
+
+private:
+	AABB aabbs[MAX_ENTITIES];
+	SweepAndPrune sweepAndPrune;
+
+	// Pair AABBs are grown by the engine's speculative margin so shapes about to touch are still checked
+	float contactMargin = 0.f;
+	std::vector<BroadphasePair> pairs;
+
+	// Tree leaves are created lazily since an entity's shape isn't known when it joins the system
+	DynamicAABBTree aabbTree;
+	int treeProxies[MAX_ENTITIES];
+	int treeUpdates = 0;
+
+	// Planes can't go in the tree
+	ECS::uint unboundedCount = 0;
+	ECS::uint unboundedEntities[MAX_ENTITIES];
+
+	// Scene queries and continuous sweeps get their own tight bounds and tree, sleepers included.
+	// The broadphase's are padded by the margin and left alone while asleep
+	AABB queryAABBs[MAX_ENTITIES];
+	DynamicAABBTree queryTree;
+	int queryProxies[MAX_ENTITIES];
+	ECS::uint queryUnboundedCount = 0;
+	ECS::uint queryUnboundedEntities[MAX_ENTITIES];
+
+	// where continuous bodies started the tick, scale is taken from the current transform
+	TransformComponent sweepOrigins[MAX_ENTITIES];
+
+	// Awake bodies with physics, pairs need at least one of these to be worth checking
+	bool isAwake[MAX_ENTITIES];
+	// Sleeping bodies don't move, their AABBs are left as they were
+	bool isSleeping[MAX_ENTITIES];
+
+	// Pair routines only get transforms, the generic ones need to know the shape
+	enumGeometry::type geometries[MAX_ENTITIES];
+	int shapeIDs[MAX_ENTITIES];
+
+	// Shared by every CONVEX_HULL or TRIANGLE_MESH collider that points at them with shapeID
+	std::vector<ConvexHull> hulls;
+	std::vector<TriangleMesh> triangleMeshes;
+
+	// Cached separating axes and GJK directions, the pair routines fetch the one for 'activePairKey'
+	PairCache pairCache;
+	std::uint32_t activePairKey = 0;
+
+public:
+	CollisionSystem() {
+		for (int i = 0; i < MAX_ENTITIES; i++) {
+			treeProxies[i] = DynamicAABBTree::nullNode;
+			queryProxies[i] = DynamicAABBTree::nullNode;
+			isAwake[i] = false;
+			isSleeping[i] = false;
+		}
+	}
+
 	void detectCollisions(ECS::ECSManager* manager, IPhysicsEngine* physicsEngine) {
-		for (int i = 0; i < entityCount; i++) {
-			ECS::uint entityA = entities[i];
-			const CollisionComponent& collisionCompA = manager->getComponent<CollisionComponent>(entityA);
-			const TransformComponent& transformCompA = manager->getComponent<TransformComponent>(entityA);
-
-			for (int n = i + 1; n < entityCount; n++) {
-				ECS::uint entityB = entities[n];
-				const CollisionComponent& collisionCompB = manager->getComponent<CollisionComponent>(entityB);
-				const TransformComponent& transformCompB = manager->getComponent<TransformComponent>(entityB);
-
-				//unsigned int collisionType = collisionCompA.geometry + collisionCompB.geometry; // fix this so it works with more than three types
-
-				// triangular matrix
-				// 0
-				// 1 2
-				// 3 4 5
-
-				// sum of all numbers between 100 is (1 + 100) + (2 + 99) + (3 + 98)... = 101 * 50 = 5050
-				// n(n + 1) / 2
-
-				if (collisionCompA.geometry > collisionCompB.geometry) {
-					unsigned int n = collisionCompA.geometry;
-					unsigned int collisionType = collisionCompB.geometry + (n * (n + 1)) / 2;
-
-					// switcheroo
-					(*this.*collisionFunctions[collisionType])(physicsEngine, entityB, transformCompB, entityA, transformCompA);
-				}
-				else {
-					unsigned int n = collisionCompB.geometry;
-					unsigned int collisionType = collisionCompA.geometry + (n * (n + 1)) / 2;
-
-					(*this.*collisionFunctions[collisionType])(physicsEngine, entityA, transformCompA, entityB, transformCompB);
-				}
-			}
+		{
+			PHYSICS_PROFILE_PHASE(physicsEngine->profiler, enumPhysicsPhase::BROADPHASE);
+			contactMargin = physicsEngine->speculativeMargin;
+			updateEntityStates(manager);
+			findPairs(manager);
+		}
+
+		PHYSICS_PROFILE_PHASE(physicsEngine->profiler, enumPhysicsPhase::NARROWPHASE);
+		pairCache.beginTick();
+		for (const BroadphasePair& pair : pairs) {
+			// Static or sleeping on both sides leaves nothing to solve
+			if (!isAwake[pair.entityA] && !isAwake[pair.entityB]) continue;
+
+			PHYSICS_PROFILE_COUNT(physicsEngine->profiler, enumPhysicsCounter::PAIRS_TESTED, 1);
+			activePairKey = PairCache::makeKey(pair.entityA, pair.entityB);
+			checkCollision(manager, physicsEngine, pair.entityA, pair.entityB);
+		}
+	}
+
+	// Fills the candidate pair list using the selected broadphase
+	const std::vector<BroadphasePair>& findPairs(ECS::ECSManager* manager);
+
+	const std::vector<BroadphasePair>& getPairs() const { return pairs; }
+	const AABB& getAABB(ECS::uint entityID) const { return aabbs[entityID]; }
+
+	// Number of leaves reinserted into the AABB tree during the last findPairs
+	int getTreeUpdates() const { return treeUpdates; }
+
+	AABB calcAABB(const CollisionComponent& collision, const TransformComponent& transform) const;
+
+	// Contact points where the features of A and B facing each other along 'normal' (A to B) overlap,
+	// the one with more points is the reference. 0 when neither is a face or a parallel edge
+	// Points up to 'margin' apart are kept as speculative contacts
+	static int clipFeatures(const vec3* featureA, int countA, const vec3* featureB, int countB, vec3 normal, float margin, ManifoldPoint out[MAX_FEATURE_POINTS * 2]);
+
+	// Returns the shapeID for CollisionComponents using this hull
+	int addHull(ConvexHull hull) {
+		assert(hull.isValid());
+		hulls.push_back(std::move(hull));
+		return (int)hulls.size() - 1;
+	}
+	const ConvexHull& getHull(int shapeID) const { return hulls[shapeID]; }
+
+	// Mesh contacts put the triangle index above the manifold's feature ID bits, the rest of the 32 bits cap the mesh size
+	static constexpr int meshTriangleShift = 13;
+	static constexpr int maxMeshTriangles = 1 << (32 - meshTriangleShift);
+
+	// Returns the shapeID for CollisionComponents using this mesh
+	int addTriangleMesh(TriangleMesh mesh) {
+		assert(mesh.isValid());
+		assert(mesh.getTriangleCount() <= maxMeshTriangles && "contact feature IDs can't tell the triangles apart, split the mesh");
+		triangleMeshes.push_back(std::move(mesh));
+		return (int)triangleMeshes.size() - 1;
+	}
+	const TriangleMesh& getTriangleMesh(int shapeID) const { return triangleMeshes[shapeID]; }
+
+	// Where continuous bodies start the tick, before anything integrates them. Sleepers too, contacts can wake them
+	void recordSweepOrigins(ECS::ECSManager* manager);
+	// Continuous bodies that moved further than their inner radius since recordSweepOrigins() are swept from there,
+	// anything hit in between holds them back at the time of impact for the discrete contacts to pick up
+	void sweepContinuousBodies(ECS::ECSManager* manager, IPhysicsEngine* physicsEngine);
+
+	// Query bounds and tree from the current transforms whatever the broadphase, scene queries need it first
+	void updateQueryBounds(ECS::ECSManager* manager);
+
+	// Scene queries, PhysicsEngine's are the ones to use
+	bool raycast(ECS::ECSManager* manager, const Ray& ray, RaycastHit& hit) const;
+	void raycastAll(ECS::ECSManager* manager, const Ray& ray, std::vector<RaycastHit>& hits) const;
+	bool sphereCast(ECS::ECSManager* manager, const Ray& ray, float radius, RaycastHit& hit) const;
+	void overlapAABB(ECS::ECSManager* manager, const AABB& bounds, std::vector<ECS::uint>& overlaps) const;
+
+	// Nearest hit of each of up to RAYCAST_PACKET_SIZE rays, the tree is only walked once for all of them
+	void raycastPacket(ECS::ECSManager* manager, const Ray* rays, int rayCount, RaycastHit* hits) const {
+		castPacket(manager, rays, rayCount, 0.f, hits);
+	}
+
+	virtual void onEntityAdded(ECS::uint entityID) override { sweepAndPrune.insert(entityID); }
+	virtual void onEntityRemoved(ECS::uint entityID) override {
+		sweepAndPrune.remove(entityID);
+
+		pairCache.remove(entityID);
+
+		if (treeProxies[entityID] != DynamicAABBTree::nullNode) {
+			aabbTree.destroyProxy(treeProxies[entityID]);
+			treeProxies[entityID] = DynamicAABBTree::nullNode;
+		}
+		if (queryProxies[entityID] != DynamicAABBTree::nullNode) {
+			queryTree.destroyProxy(queryProxies[entityID]);
+			queryProxies[entityID] = DynamicAABBTree::nullNode;
+		}
+	}
+
+private:
+	void updateEntityStates(ECS::ECSManager* manager);
+	void calcEntityAABBs(ECS::ECSManager* manager);
+	// Moves each entity's leaf to its entry in 'bounds', unbounded ones are listed instead. Returns the leaves reinserted
+	int updateAABBTree(DynamicAABBTree& tree, const AABB* bounds, int* proxies, ECS::uint* unbounded, ECS::uint& count);
+
+	// Time of impact of 'moving' against one collider, turning by 'spin' as it goes like GJK::cast. False if it misses,
+	// or if they already touch and it isn't heading further in
+	bool sweepShape(ECS::ECSManager* manager, const ConvexShape& moving, vec3 direction, vec3 spin, float maxDistance, ECS::uint entity, const AABB& sweptBounds, float& distance, vec3& normal) const;
+
+	// Nearest hit of each ray, or of spheres of 'radius' moving along them
+	void castPacket(ECS::ECSManager* manager, const Ray* rays, int rayCount, float radius, RaycastHit* hits) const;
+
+	// Exact test against one collider, a ray when 'radius' is 0. 'direction' is normalised
+	bool castEntity(ECS::ECSManager* manager, ECS::uint entity, vec3 origin, vec3 direction, float radius, float maxDistance, RaycastHit& hit) const;
+	static bool castTriangleMesh(const TriangleMesh& mesh, const TransformComponent& transform, vec3 origin, vec3 direction, float radius, float maxDistance, float& distance, vec3& normal);
+	static bool intersectRayTriangle(vec3 origin, vec3 direction, const vec3 triangle[3], float& distance);
+
+	bool overlapsEntity(ECS::ECSManager* manager, ECS::uint entity, const AABB& bounds) const;
+
+	// World 'bounds' as an AABB in the mesh's local space, big enough to hold them at any rotation
+	static AABB toMeshSpace(const AABB& bounds, const TransformComponent& meshTransform);
+
+	void checkCollision(ECS::ECSManager* manager, IPhysicsEngine* physicsEngine, ECS::uint entityA, ECS::uint entityB) {
+		const CollisionComponent& collisionCompA = manager->getComponent<CollisionComponent>(entityA);
+		const TransformComponent& transformCompA = manager->getComponent<TransformComponent>(entityA);
+		const CollisionComponent& collisionCompB = manager->getComponent<CollisionComponent>(entityB);
+		const TransformComponent& transformCompB = manager->getComponent<TransformComponent>(entityB);
+
+		//unsigned int collisionType = collisionCompA.geometry + collisionCompB.geometry; // fix this so it works with more than three types
+
+		// triangular matrix
+		// 0
+		// 1 2
+		// 3 4 5
+
+		// sum of all numbers between 100 is (1 + 100) + (2 + 99) + (3 + 98)... = 101 * 50 = 5050
+		// n(n + 1) / 2
+
+		// same shape pairs get a fixed order so contact normals and cache keys don't flip between ticks
+		if (collisionCompA.geometry > collisionCompB.geometry || (collisionCompA.geometry == collisionCompB.geometry && entityA > entityB)) {
+			unsigned int n = collisionCompA.geometry;
+			unsigned int collisionType = collisionCompB.geometry + (n * (n + 1)) / 2;
+
+			// switcheroo
+			(*this.*collisionFunctions[collisionType])(physicsEngine, entityB, transformCompB, entityA, transformCompA);
+		}
+		else {
+			unsigned int n = collisionCompB.geometry;
+			unsigned int collisionType = collisionCompA.geometry + (n * (n + 1)) / 2;
+
+			(*this.*collisionFunctions[collisionType])(physicsEngine, entityA, transformCompA, entityB, transformCompB);
 		}
 	}
 
 private:
 	typedef void (CollisionSystem::* func)(IPhysicsEngine* physicsEngine, ECS::uint entityA, const TransformComponent& transformA, ECS::uint entityB, const TransformComponent& transformB);
-	func collisionFunctions[6] = {
+	// Box, sphere and plane pairs have their own routines, anything else goes through GJK
+	func collisionFunctions[28] = {
 		&CollisionSystem::checkCollisionBoxBox,
 		&CollisionSystem::checkCollisionBoxSphere,
 		&CollisionSystem::checkCollisionSphereSphere,
 		&CollisionSystem::checkCollisionBoxPlane,
 		&CollisionSystem::checkCollisionSpherePlane,
-		&CollisionSystem::checkCollisionPlanePlane
+		&CollisionSystem::checkCollisionPlanePlane,
+		&CollisionSystem::checkCollisionConvex, // box capsule
+		&CollisionSystem::checkCollisionConvex, // sphere capsule
+		&CollisionSystem::checkCollisionPlaneConvex,
+		&CollisionSystem::checkCollisionConvex, // capsule capsule
+		&CollisionSystem::checkCollisionConvex, // box cylinder
+		&CollisionSystem::checkCollisionConvex, // sphere cylinder
+		&CollisionSystem::checkCollisionPlaneConvex,
+		&CollisionSystem::checkCollisionConvex, // capsule cylinder
+		&CollisionSystem::checkCollisionConvex, // cylinder cylinder
+		&CollisionSystem::checkCollisionConvex, // box hull
+		&CollisionSystem::checkCollisionConvex, // sphere hull
+		&CollisionSystem::checkCollisionPlaneConvex,
+		&CollisionSystem::checkCollisionConvex, // capsule hull
+		&CollisionSystem::checkCollisionConvex, // cylinder hull
+		&CollisionSystem::checkCollisionConvex, // hull hull
+		&CollisionSystem::checkCollisionConvexMesh, // box mesh
+		&CollisionSystem::checkCollisionConvexMesh, // sphere mesh
+		&CollisionSystem::checkCollisionNone, // plane mesh
+		&CollisionSystem::checkCollisionConvexMesh, // capsule mesh
+		&CollisionSystem::checkCollisionConvexMesh, // cylinder mesh
+		&CollisionSystem::checkCollisionConvexMesh, // hull mesh
+		&CollisionSystem::checkCollisionNone // mesh mesh
 	};
 
 	void checkCollisionBoxBox(IPhysicsEngine* physicsEngine, ECS::uint entityA, const TransformComponent& boxA, ECS::uint entityB, const TransformComponent& boxB);
@@ -67,7 +281,46 @@ private:
 	void checkCollisionSpherePlane(IPhysicsEngine* physicsEngine, ECS::uint entityA, const TransformComponent& sphere, ECS::uint entityB, const TransformComponent& plane);
 	void checkCollisionPlanePlane(IPhysicsEngine* physicsEngine, ECS::uint entityA, const TransformComponent& planeA, ECS::uint entityB, const TransformComponent& planeB);
 
-	static void getGlobalBoxVerts(vec3 verts[8], const TransformComponent& box);
-	static void getMinMaxProjection(vec3 axis, vec3 points[8], float& min, float& max);
+	ConvexShape getConvexShape(enumGeometry::type geometry, int shapeID, const TransformComponent& transform) const {
+		return ConvexShape::fromTransform(geometry, transform, geometry == enumGeometry::CONVEX_HULL ? &hulls[shapeID] : nullptr);
+	}
+
+	// Any two convex shapes, GJK on their cores then EPA if those overlap
+	void checkCollisionConvex(IPhysicsEngine* physicsEngine, ECS::uint entityA, const TransformComponent& transformA, ECS::uint entityB, const TransformComponent& transformB);
+	void checkCollisionPlaneConvex(IPhysicsEngine* physicsEngine, ECS::uint entityA, const TransformComponent& plane, ECS::uint entityB, const TransformComponent& transformB);
+	// Every triangle of B's mesh under A's AABB as its own convex shape
+	void checkCollisionConvexMesh(IPhysicsEngine* physicsEngine, ECS::uint entityA, const TransformComponent& transformA, ECS::uint entityB, const TransformComponent& meshTransform);
+	// Static against static
+	void checkCollisionNone(IPhysicsEngine*, ECS::uint, const TransformComponent&, ECS::uint, const TransformComponent&) {}
+
+	// Normal (A to B), depth and deepest points of two convex shapes, false if they're further apart than the speculative margin.
+	// 'direction' is where GJK starts, it's left as the direction to start from next time
+	static bool findConvexContact(IPhysicsEngine* physicsEngine, const ConvexShape& a, const ConvexShape& b, vec3& direction, PenetrationResult& contact);
+	// Up to MAX_MANIFOLD_POINTS contacts for a pair findConvexContact found touching
+	static int buildConvexManifold(IPhysicsEngine* physicsEngine, const ConvexShape& a, const ConvexShape& b, const PenetrationResult& contact, ManifoldPoint manifold[MAX_MANIFOLD_POINTS]);
+
+	// Incident polygon vertices keep their index as the feature ID. A clipped vertex is named by the segment it was cut
+	// from and the plane that cut it, the segment being an incident edge (both its vertex indices) or an earlier plane
+	static constexpr unsigned int clipEdgeFeature = 1 << 9;
+	static constexpr unsigned int clipPlaneFeature = 1 << 10;
+
+	static unsigned int getClipEdgeFeature(unsigned int start, unsigned int end) { return clipEdgeFeature | (start << 6) | (end << 3); }
+	static unsigned int getClipPlaneFeature(unsigned int planeIndex) { return clipPlaneFeature | (planeIndex << 3); }
+
+	struct ClipVertex {
+		vec3 position;
+		unsigned int featureID;
+		// segment from here to the next vertex, the clipped vertex's ID without the cutting plane
+		unsigned int segmentFeature;
+	};
+
+	static int clipBoxFaces(const TransformComponent& refBox, const vec3 refAxes[3], int refAxis, vec3 refNormal,
+		const TransformComponent& incBox, const vec3 incAxes[3], float margin, ManifoldPoint out[8]);
+	static int clipPolygon(const ClipVertex* polygon, int count, vec3 planeNormal, float planeOffset, int planeIndex, ClipVertex* out);
+
+	// Edge cross product axis 'index' (6-14) of two boxes' face axes, zero for parallel edges
+	static vec3 getEdgeAxis(const vec3 faceAxes[6], int index);
+	// Interval a box covers along 'axis'
+	static void getBoxProjection(vec3 axis, vec3 position, const vec3 boxAxes[3], vec3 extents, float& min, float& max);
 };
 
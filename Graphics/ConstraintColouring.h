@@ -0,0 +1,75 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include <vector>
+
+#include "ECS.h"
+#include "SolverBody.h"
+#include "ContactConstraint.h"
+#include "ContactArena.h"
+
+
+// Colours beyond this spill into the overflow list, which gets solved on one thread
+#define MAX_CONSTRAINT_COLOURS 64
+
+
+// Splits constraints into colours where no two constraints in a colour share a dynamic body,
+// so each colour can be solved in parallel without two threads writing the same body.
+// The static body never conflicts since impulses on it are no-ops.
+class ConstraintColouring {
+private:
+	// bit n set if the body already has a constraint in colour n
+	std::uint64_t bodyColours[MAX_ENTITIES + 1];
+
+	std::vector<int> colours[MAX_CONSTRAINT_COLOURS];
+	int colourCount = 0;
+
+	std::vector<int> overflow;
+
+public:
+	void build(const ContactArena<ContactConstraint>& constraints) {
+		build(constraints.getData(), 0, constraints.getCount());
+	}
+
+	// Colours items [begin, end) of anything with solver body indices 'bodyA' and 'bodyB', colours hold indices into 'items'.
+	// Greedy, each item takes the lowest colour neither of its bodies is in yet
+	template<typename Item>
+	void build(const Item* items, int begin, int end) {
+		for (int i = 0; i < colourCount; i++) {
+			colours[i].clear();
+		}
+		colourCount = 0;
+		overflow.clear();
+
+		for (int i = 0; i < MAX_ENTITIES + 1; i++) {
+			bodyColours[i] = 0;
+		}
+
+		for (int i = begin; i < end; i++) {
+			int bodyA = items[i].bodyA;
+			int bodyB = items[i].bodyB;
+
+			std::uint64_t used = 0;
+			if (bodyA != SolverBodyCache::staticBody) used |= bodyColours[bodyA];
+			if (bodyB != SolverBodyCache::staticBody) used |= bodyColours[bodyB];
+
+			if (~used == 0) {
+				overflow.push_back(i);
+				continue;
+			}
+
+			int colour = std::countr_zero(~used);
+			colours[colour].push_back(i);
+			colourCount = std::max(colourCount, colour + 1);
+
+			std::uint64_t bit = (std::uint64_t)1 << colour;
+			if (bodyA != SolverBodyCache::staticBody) bodyColours[bodyA] |= bit;
+			if (bodyB != SolverBodyCache::staticBody) bodyColours[bodyB] |= bit;
+		}
+	}
+
+	int getColourCount() const { return colourCount; }
+	const std::vector<int>& getColour(int index) const { return colours[index]; }
+	const std::vector<int>& getOverflow() const { return overflow; }
+};
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cassert>
+#include <algorithm>
+
+
+// Growable storage for per-tick contact data.
+// Clearing keeps the capacity, so once it has grown to fit the scene a tick does no allocations.
+template<typename T>
+class ContactArena {
+private:
+	T* data = nullptr;
+	int count = 0;
+	int capacity = 0;
+
+	// Largest count seen since the last resetStats()
+	int highWaterMark = 0;
+
+	// Number of times a push ran past capacity and had to grow
+	int overflowCount = 0;
+
+public:
+	ContactArena() {}
+	ContactArena(int initialCapacity) { reserve(initialCapacity); }
+	~ContactArena() { delete[] data; }
+
+	ContactArena(const ContactArena&) = delete;
+	ContactArena& operator=(const ContactArena&) = delete;
+
+	void push(const T& item) {
+		if (count == capacity) {
+			overflowCount++;
+			reserve(std::max(16, capacity * 2));
+		}
+
+		data[count++] = item;
+		highWaterMark = std::max(highWaterMark, count);
+	}
+
+	void clear() { count = 0; }
+
+	// Sets the count directly, new entries are left as whatever was there before
+	void resize(int newCount) {
+		if (newCount > capacity) {
+			overflowCount++;
+			reserve(std::max(newCount, capacity * 2));
+		}
+
+		count = newCount;
+		highWaterMark = std::max(highWaterMark, count);
+	}
+
+	void reserve(int newCapacity) {
+		if (newCapacity <= capacity) return;
+
+		T* newData = new T[newCapacity];
+		std::copy(data, data + count, newData);
+
+		delete[] data;
+		data = newData;
+		capacity = newCapacity;
+	}
+
+	void resetStats() {
+		highWaterMark = count;
+		overflowCount = 0;
+	}
+
+	T& operator[](int index) {
+		assert(index >= 0 && index < count && "Contact index out of range");
+		return data[index];
+	}
+
+	const T& operator[](int index) const {
+		assert(index >= 0 && index < count && "Contact index out of range");
+		return data[index];
+	}
+
+	T* getData() { return data; }
+	const T* getData() const { return data; }
+
+	int getCount() const { return count; }
+	int getCapacity() const { return capacity; }
+	int getHighWaterMark() const { return highWaterMark; }
+	int getOverflowCount() const { return overflowCount; }
+};
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+#include "Collision.h"
+
+
+// Keeps the accumulated impulses of last tick's contacts so matching contacts can be warm started.
+// Contacts match on (entityA, entityB, featureID).
+class ContactCache {
+public:
+	struct Entry {
+		std::uint64_t key;
+
+		float lambdaSum;
+		float tangentLambdaSum1;
+		float tangentLambdaSum2;
+	};
+
+private:
+	// sorted by key
+	std::vector<Entry> entries;
+
+	int matchedCount = 0;
+
+public:
+	static std::uint64_t makeKey(const CollisionECS& collision) {
+		// the whole feature ID, mesh contacts keep their triangle index in the high bits
+		return ((std::uint64_t)collision.entityA << 40) | ((std::uint64_t)collision.entityB << 32) | collision.featureID;
+	}
+
+	// Copies cached impulses onto any new contacts that match an old one
+	void matchContacts(CollisionECS* collisions, int count) {
+		matchedCount = 0;
+
+		for (int i = 0; i < count; i++) {
+			CollisionECS& collision = collisions[i];
+			std::uint64_t key = makeKey(collision);
+
+			auto it = std::lower_bound(entries.begin(), entries.end(), key, [](const Entry& entry, std::uint64_t key) { return entry.key < key; });
+			if (it == entries.end() || it->key != key) continue;
+
+			collision.lambdaSum = it->lambdaSum;
+			collision.tangentLambdaSum1 = it->tangentLambdaSum1;
+			collision.tangentLambdaSum2 = it->tangentLambdaSum2;
+			matchedCount++;
+		}
+	}
+
+	// Replaces the cache with this tick's solved contacts
+	void storeContacts(const CollisionECS* collisions, int count) {
+		entries.clear();
+
+		for (int i = 0; i < count; i++) {
+			const CollisionECS& collision = collisions[i];
+			entries.push_back({ makeKey(collision), collision.lambdaSum, collision.tangentLambdaSum1, collision.tangentLambdaSum2 });
+		}
+
+		std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.key < b.key; });
+	}
+
+	void clear() { entries.clear(); }
+
+	const std::vector<Entry>& getEntries() const { return entries; }
+
+	int getMatchedCount() const { return matchedCount; }
+	int getCachedCount() const { return (int)entries.size(); }
+};
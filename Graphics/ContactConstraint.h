@@ -0,0 +1,60 @@
+#pragma once
+
+#include "glmAddon.h"
+
+
+// Velocity constraint rows for one contact, built once per tick by PhysicsSolver::preStep.
+// Everything that only depends on positions is baked in so iterations are just multiply-adds.
+struct ContactConstraint {
+	int bodyA = 0;
+	int bodyB = 0;
+
+	// contact this was built from, accumulated impulses get copied back to it for the contact cache
+	int collisionIndex = 0;
+
+	vec3 normal;
+	vec3 tangent1;
+	vec3 tangent2;
+
+	// lever arms from each body's centre
+	vec3 rA;
+	vec3 rB;
+
+	// r x direction for each row
+	vec3 rAxN;
+	vec3 rBxN;
+	vec3 rAxT1;
+	vec3 rBxT1;
+	vec3 rAxT2;
+	vec3 rBxT2;
+
+	// world inverse inertia * (r x direction), the angular velocity change per unit impulse
+	vec3 angularA_N;
+	vec3 angularB_N;
+	vec3 angularA_T1;
+	vec3 angularB_T1;
+	vec3 angularA_T2;
+	vec3 angularB_T2;
+
+	float invMassA = 0.f;
+	float invMassB = 0.f;
+
+	// inverse effective masses
+	float normalMass = 0.f;
+	float tangentMass1 = 0.f;
+	float tangentMass2 = 0.f;
+
+	float friction = 0.f;
+
+	// gap / time step for speculative contacts, how fast the bodies can close without touching this tick. 0 once they do
+	float speculativeVelocity = 0.f;
+
+	// Substepping re-measures the gap from these as the bodies move
+	float separation = 0.f; // along the normal when built, negative while overlapping
+	float relativeVelocity = 0.f; // normal velocity when built, restitution bounces back a share of it
+	float maxLambdaSum = 0.f; // largest normal impulse any substep needed, zero if the contact never pushed
+
+	float lambdaSum = 0.f;
+	float tangentLambdaSum1 = 0.f;
+	float tangentLambdaSum2 = 0.f;
+};
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cfloat>
+#include <cmath>
+#include <utility>
+
+#include "glmAddon.h"
+
+
+#define MAX_MANIFOLD_POINTS 4
+
+
+struct ManifoldPoint {
+	vec3 pointA;
+	vec3 pointB;
+	float depth;
+	unsigned int featureID;
+};
+
+// Picks at most 4 well spread points out of 'count' candidates:
+// the deepest point, the point furthest from it, the point making the largest triangle with those two,
+// and finally the point furthest outside that triangle.
+inline int reduceManifold(const ManifoldPoint* points, int count, vec3 normal, ManifoldPoint out[MAX_MANIFOLD_POINTS]) {
+	if (count <= MAX_MANIFOLD_POINTS) {
+		for (int i = 0; i < count; i++) {
+			out[i] = points[i];
+		}
+		return count;
+	}
+
+	// Deepest
+	int first = 0;
+	for (int i = 1; i < count; i++) {
+		if (points[i].depth > points[first].depth) first = i;
+	}
+
+	// Furthest from deepest
+	int second = -1;
+	float maxSqrDist = -1.f;
+	for (int i = 0; i < count; i++) {
+		vec3 offset = points[i].pointA - points[first].pointA;
+		float sqrDist = dot(offset, offset);
+
+		if (i != first && sqrDist > maxSqrDist) {
+			maxSqrDist = sqrDist;
+			second = i;
+		}
+	}
+
+	// Largest triangle, either winding
+	int third = -1;
+	float maxArea = -1.f;
+	for (int i = 0; i < count; i++) {
+		if (i == first || i == second) continue;
+
+		float area = std::abs(dot(cross(points[second].pointA - points[first].pointA, points[i].pointA - points[first].pointA), normal));
+		if (area > maxArea) {
+			maxArea = area;
+			third = i;
+		}
+	}
+
+	// Make the triangle wind counter-clockwise around the normal
+	vec3 a = points[first].pointA;
+	vec3 b = points[second].pointA;
+	vec3 c = points[third].pointA;
+	if (dot(cross(b - a, c - a), normal) < 0.f) {
+		std::swap(b, c);
+	}
+
+	// Point with the most negative area against any triangle edge lies furthest outside it
+	int fourth = -1;
+	float minArea = FLT_MAX;
+	for (int i = 0; i < count; i++) {
+		if (i == first || i == second || i == third) continue;
+
+		vec3 p = points[i].pointA;
+		float areaAB = dot(cross(b - a, p - a), normal);
+		float areaBC = dot(cross(c - b, p - b), normal);
+		float areaCA = dot(cross(a - c, p - c), normal);
+
+		float area = glm::min(areaAB, glm::min(areaBC, areaCA));
+		if (area < minArea) {
+			minArea = area;
+			fourth = i;
+		}
+	}
+
+	out[0] = points[first];
+	out[1] = points[second];
+	out[2] = points[third];
+
+	// Nothing outside the triangle means the fourth point adds no support
+	if (minArea >= 0.f) return 3;
+
+	out[3] = points[fourth];
+	return 4;
+}
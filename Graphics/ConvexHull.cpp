@@ -0,0 +1,407 @@
+#include "ConvexHull.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "ResourceManager.h"
+
+
+namespace {
+	// bump whenever build changes what it outputs for the same points
+	constexpr std::uint32_t hullCacheVersion = 1;
+
+	// triangles whose normals are closer than this are merged into one face
+	constexpr float coplanarCosine = 0.9999f;
+
+	struct HullTriangle {
+		int v[3];
+		vec3 normal;
+		float offset;
+
+		std::vector<int> outside; // points in front of this triangle that it's responsible for
+		bool isAlive = true;
+	};
+
+	HullTriangle makeTriangle(const vec3* points, int a, int b, int c) {
+		HullTriangle triangle;
+		triangle.v[0] = a;
+		triangle.v[1] = b;
+		triangle.v[2] = c;
+		triangle.normal = normalize(cross(points[b] - points[a], points[c] - points[a]));
+		triangle.offset = dot(triangle.normal, points[a]);
+		return triangle;
+	}
+
+	// Wound so its normal faces away from 'inside'
+	HullTriangle makeOrientedTriangle(const vec3* points, int a, int b, int c, vec3 inside) {
+		HullTriangle triangle = makeTriangle(points, a, b, c);
+		if (dot(triangle.normal, inside) - triangle.offset > 0.f) triangle = makeTriangle(points, a, c, b);
+		return triangle;
+	}
+
+	// Each point goes to the first new triangle it's in front of, points behind all of them are inside the hull now
+	void assignOutside(const vec3* points, const std::vector<int>& candidates, std::vector<HullTriangle>& triangles, int firstTriangle, float tolerance) {
+		for (int point : candidates) {
+			for (int i = firstTriangle; i < (int)triangles.size(); i++) {
+				if (dot(triangles[i].normal, points[point]) - triangles[i].offset > tolerance) {
+					triangles[i].outside.push_back(point);
+					break;
+				}
+			}
+		}
+	}
+
+	// FNV-1a over the points and the budget, a cache built from anything else is stale
+	std::uint64_t hashPoints(const std::vector<vec3>& points, int maxVertices) {
+		std::uint64_t hash = 14695981039346656037ull;
+
+		const unsigned char* bytes = (const unsigned char*)points.data();
+		for (size_t i = 0; i < points.size() * sizeof(vec3); i++) {
+			hash = (hash ^ bytes[i]) * 1099511628211ull;
+		}
+
+		return (hash ^ (std::uint64_t)maxVertices) * 1099511628211ull;
+	}
+}
+
+
+ConvexHull ConvexHull::build(const vec3* points, int pointCount, int maxVertices) {
+	ConvexHull hull;
+	if (pointCount < 4 || maxVertices < 4) return hull;
+
+	// Extreme points along each axis, the starting tetrahedron is picked from these
+	int extremes[6] = {};
+	for (int i = 1; i < pointCount; i++) {
+		for (int axis = 0; axis < 3; axis++) {
+			if (points[i][axis] < points[extremes[axis * 2]][axis]) extremes[axis * 2] = i;
+			if (points[i][axis] > points[extremes[axis * 2 + 1]][axis]) extremes[axis * 2 + 1] = i;
+		}
+	}
+
+	vec3 boundsMin = vec3(points[extremes[0]].x, points[extremes[2]].y, points[extremes[4]].z);
+	vec3 boundsMax = vec3(points[extremes[1]].x, points[extremes[3]].y, points[extremes[5]].z);
+	float tolerance = std::max(length(boundsMax - boundsMin) * 1e-5f, FLT_MIN);
+
+	// Two extremes furthest apart
+	int v0 = extremes[0];
+	int v1 = extremes[1];
+	float bestDistance = -1.f;
+	for (int i = 0; i < 6; i++) {
+		for (int n = i + 1; n < 6; n++) {
+			vec3 offset = points[extremes[n]] - points[extremes[i]];
+			if (dot(offset, offset) > bestDistance) {
+				bestDistance = dot(offset, offset);
+				v0 = extremes[i];
+				v1 = extremes[n];
+			}
+		}
+	}
+
+	// Furthest from their line, then furthest from the plane through all three
+	vec3 lineDirection = normalize(points[v1] - points[v0]);
+	int v2 = -1;
+	bestDistance = tolerance;
+	for (int i = 0; i < pointCount; i++) {
+		float distance = length(cross(points[i] - points[v0], lineDirection));
+		if (distance > bestDistance) {
+			bestDistance = distance;
+			v2 = i;
+		}
+	}
+	if (v2 < 0) return hull;
+
+	vec3 planeNormal = normalize(cross(points[v1] - points[v0], points[v2] - points[v0]));
+	int v3 = -1;
+	bestDistance = tolerance;
+	for (int i = 0; i < pointCount; i++) {
+		float distance = std::abs(dot(points[i] - points[v0], planeNormal));
+		if (distance > bestDistance) {
+			bestDistance = distance;
+			v3 = i;
+		}
+	}
+	if (v3 < 0) return hull;
+
+	vec3 inside = (points[v0] + points[v1] + points[v2] + points[v3]) * 0.25f;
+
+	std::vector<HullTriangle> triangles;
+	triangles.push_back(makeOrientedTriangle(points, v0, v1, v2, inside));
+	triangles.push_back(makeOrientedTriangle(points, v0, v1, v3, inside));
+	triangles.push_back(makeOrientedTriangle(points, v1, v2, v3, inside));
+	triangles.push_back(makeOrientedTriangle(points, v2, v0, v3, inside));
+
+	std::vector<bool> isVertex(pointCount, false);
+	isVertex[v0] = isVertex[v1] = isVertex[v2] = isVertex[v3] = true;
+	int vertexCount = 4;
+
+	std::vector<int> candidates;
+	candidates.reserve(pointCount);
+	for (int i = 0; i < pointCount; i++) {
+		if (!isVertex[i]) candidates.push_back(i);
+	}
+	assignOutside(points, candidates, triangles, 0, tolerance);
+
+	std::vector<int> visible;
+	std::vector<std::pair<int, int>> horizon;
+
+	while (vertexCount < maxVertices) {
+		// The point furthest outside the hull so far changes its shape the most
+		int eye = -1;
+		float eyeDistance = tolerance;
+		for (const HullTriangle& triangle : triangles) {
+			if (!triangle.isAlive) continue;
+
+			for (int point : triangle.outside) {
+				float distance = dot(triangle.normal, points[point]) - triangle.offset;
+				if (distance > eyeDistance) {
+					eyeDistance = distance;
+					eye = point;
+				}
+			}
+		}
+		if (eye < 0) break;
+
+		visible.clear();
+		for (int i = 0; i < (int)triangles.size(); i++) {
+			if (triangles[i].isAlive && dot(triangles[i].normal, points[eye]) - triangles[i].offset > tolerance) visible.push_back(i);
+		}
+
+		// Edges between a visible triangle and a hidden one, the new triangles fan out from the eye to these
+		horizon.clear();
+		for (int t : visible) {
+			for (int e = 0; e < 3; e++) {
+				int a = triangles[t].v[e];
+				int b = triangles[t].v[(e + 1) % 3];
+
+				bool isShared = false;
+				for (int other : visible) {
+					for (int k = 0; k < 3 && !isShared; k++) {
+						isShared = triangles[other].v[k] == b && triangles[other].v[(k + 1) % 3] == a;
+					}
+					if (isShared) break;
+				}
+
+				if (!isShared) horizon.push_back({ a, b });
+			}
+		}
+
+		candidates.clear();
+		for (int t : visible) {
+			triangles[t].isAlive = false;
+			for (int point : triangles[t].outside) {
+				if (point != eye) candidates.push_back(point);
+			}
+			triangles[t].outside.clear();
+		}
+
+		int firstNew = (int)triangles.size();
+		for (const auto& [a, b] : horizon) {
+			triangles.push_back(makeTriangle(points, a, b, eye));
+		}
+		assignOutside(points, candidates, triangles, firstNew, tolerance);
+
+		isVertex[eye] = true;
+		vertexCount++;
+	}
+
+	// Compact the used points into the hull's own vertex list
+	std::vector<int> remap(pointCount, -1);
+	std::vector<int> hullTriangles;
+	for (const HullTriangle& triangle : triangles) {
+		if (!triangle.isAlive) continue;
+
+		for (int i = 0; i < 3; i++) {
+			int& index = remap[triangle.v[i]];
+			if (index < 0) {
+				index = (int)hull.vertices.size();
+				hull.vertices.push_back(points[triangle.v[i]]);
+			}
+			hullTriangles.push_back(index);
+		}
+	}
+
+	hull.finalise(hullTriangles);
+	return hull;
+}
+
+void ConvexHull::finalise(const std::vector<int>& triangles) {
+	int triangleCount = (int)triangles.size() / 3;
+
+	std::vector<vec3> triangleNormals(triangleCount);
+	for (int t = 0; t < triangleCount; t++) {
+		const vec3& a = vertices[triangles[t * 3]];
+		const vec3& b = vertices[triangles[t * 3 + 1]];
+		const vec3& c = vertices[triangles[t * 3 + 2]];
+		triangleNormals[t] = cross(b - a, c - a); // area weighted
+	}
+
+	// Union neighbouring triangles that lie in the same plane
+	std::vector<int> group(triangleCount);
+	for (int t = 0; t < triangleCount; t++) group[t] = t;
+
+	auto findGroup = [&group](int t) {
+		while (group[t] != t) t = group[t] = group[group[t]];
+		return t;
+	};
+
+	for (int t = 0; t < triangleCount; t++) {
+		for (int e = 0; e < 3; e++) {
+			int a = triangles[t * 3 + e];
+			int b = triangles[t * 3 + (e + 1) % 3];
+
+			for (int u = t + 1; u < triangleCount; u++) {
+				for (int k = 0; k < 3; k++) {
+					if (triangles[u * 3 + k] != b || triangles[u * 3 + (k + 1) % 3] != a) continue;
+
+					if (dot(normalize(triangleNormals[t]), normalize(triangleNormals[u])) > coplanarCosine) {
+						group[findGroup(u)] = findGroup(t);
+					}
+				}
+			}
+		}
+	}
+
+	// Each group becomes one face, its vertices sorted by angle around the middle
+	faces.clear();
+	faceIndices.clear();
+
+	std::vector<int> faceVertices;
+	std::vector<float> angles;
+	for (int root = 0; root < triangleCount; root++) {
+		if (findGroup(root) != root) continue;
+
+		vec3 normal = vec3(0);
+		faceVertices.clear();
+		for (int t = 0; t < triangleCount; t++) {
+			if (findGroup(t) != root) continue;
+
+			normal += triangleNormals[t];
+			for (int i = 0; i < 3; i++) {
+				int vertex = triangles[t * 3 + i];
+				if (std::find(faceVertices.begin(), faceVertices.end(), vertex) == faceVertices.end()) faceVertices.push_back(vertex);
+			}
+		}
+		normal = normalize(normal);
+
+		vec3 centre = vec3(0);
+		for (int vertex : faceVertices) centre += vertices[vertex];
+		centre /= (float)faceVertices.size();
+
+		vec3 u = normalize(vertices[faceVertices[0]] - centre);
+		vec3 v = cross(normal, u);
+
+		angles.resize(vertices.size());
+		float offset = -FLT_MAX;
+		for (int vertex : faceVertices) {
+			vec3 offsetFromCentre = vertices[vertex] - centre;
+			angles[vertex] = std::atan2(dot(offsetFromCentre, v), dot(offsetFromCentre, u));
+			offset = std::max(offset, dot(normal, vertices[vertex]));
+		}
+		std::sort(faceVertices.begin(), faceVertices.end(), [&angles](int a, int b) { return angles[a] < angles[b]; });
+
+		faces.push_back({ normal, offset, (int)faceIndices.size(), (int)faceVertices.size() });
+		faceIndices.insert(faceIndices.end(), faceVertices.begin(), faceVertices.end());
+	}
+
+	// Edges come from the merged faces so the diagonals of a flat face don't count
+	std::vector<std::vector<int>> adjacency(vertices.size());
+	for (const Face& face : faces) {
+		for (int i = 0; i < face.indexCount; i++) {
+			int a = faceIndices[face.firstIndex + i];
+			int b = faceIndices[face.firstIndex + (i + 1) % face.indexCount];
+
+			if (std::find(adjacency[a].begin(), adjacency[a].end(), b) == adjacency[a].end()) adjacency[a].push_back(b);
+			if (std::find(adjacency[b].begin(), adjacency[b].end(), a) == adjacency[b].end()) adjacency[b].push_back(a);
+		}
+	}
+
+	neighbourOffsets.clear();
+	neighbours.clear();
+	for (const std::vector<int>& list : adjacency) {
+		neighbourOffsets.push_back((int)neighbours.size());
+		neighbours.insert(neighbours.end(), list.begin(), list.end());
+	}
+	neighbourOffsets.push_back((int)neighbours.size());
+
+	// Sum of the tetrahedra from the origin to each triangle, signed so an origin outside the hull still works
+	volume = 0.f;
+	centroid = vec3(0);
+	secondMoment = mat3(0);
+	for (int t = 0; t < triangleCount; t++) {
+		const vec3& a = vertices[triangles[t * 3]];
+		const vec3& b = vertices[triangles[t * 3 + 1]];
+		const vec3& c = vertices[triangles[t * 3 + 2]];
+
+		float tetrahedronVolume = dot(a, cross(b, c)) / 6.f;
+		vec3 sum = a + b + c;
+
+		volume += tetrahedronVolume;
+		centroid += sum * (tetrahedronVolume * 0.25f);
+		secondMoment += (glm::outerProduct(a, a) + glm::outerProduct(b, b) + glm::outerProduct(c, c) + glm::outerProduct(sum, sum)) * (tetrahedronVolume / 20.f);
+	}
+
+	if (volume > 0.f) {
+		centroid /= volume;
+		secondMoment /= volume;
+	}
+}
+
+mat3 ConvexHull::getInertia(float mass, vec3 scale) const {
+	mat3 scaleMatrix = mat3(scale.x, 0.f, 0.f, 0.f, scale.y, 0.f, 0.f, 0.f, scale.z);
+	mat3 moment = scaleMatrix * secondMoment * scaleMatrix * mass;
+
+	float trace = moment[0][0] + moment[1][1] + moment[2][2];
+	return glm::identity<mat3>() * trace - moment;
+}
+
+ConvexHull ConvexHull::cook(const std::vector<vec3>& points, const char* name, int maxVertices) {
+	std::string fullpath = RESOURCE_PATH;
+	fullpath += name;
+
+	std::uint64_t key = hashPoints(points, maxVertices);
+
+	// Only the hull vertices are cached, rebuilding from those is instant next to the full vertex buffer
+	if (FILE* in = std::fopen(fullpath.c_str(), "rb")) {
+		char magic[4] = {};
+		std::uint32_t version = 0;
+		std::uint64_t cachedKey = 0;
+		std::uint32_t vertexCount = 0;
+
+		bool isCurrent = std::fread(magic, 1, 4, in) == 4 && std::memcmp(magic, "HULL", 4) == 0
+			&& std::fread(&version, sizeof(version), 1, in) == 1 && version == hullCacheVersion
+			&& std::fread(&cachedKey, sizeof(cachedKey), 1, in) == 1 && cachedKey == key
+			&& std::fread(&vertexCount, sizeof(vertexCount), 1, in) == 1 && vertexCount <= (std::uint32_t)maxVertices;
+
+		std::vector<vec3> cached;
+		if (isCurrent) {
+			cached.resize(vertexCount);
+			isCurrent = std::fread(cached.data(), sizeof(vec3), vertexCount, in) == vertexCount;
+		}
+		std::fclose(in);
+
+		if (isCurrent) {
+			ConvexHull hull = build(cached.data(), (int)cached.size(), maxVertices);
+			if (hull.isValid()) return hull;
+		}
+	}
+
+	ConvexHull hull = build(points.data(), (int)points.size(), maxVertices);
+	if (!hull.isValid()) return hull;
+
+	// A read only resources folder just means building every time
+	if (FILE* out = std::fopen(fullpath.c_str(), "wb")) {
+		std::uint32_t vertexCount = (std::uint32_t)hull.vertices.size();
+
+		std::fwrite("HULL", 1, 4, out);
+		std::fwrite(&hullCacheVersion, sizeof(hullCacheVersion), 1, out);
+		std::fwrite(&key, sizeof(key), 1, out);
+		std::fwrite(&vertexCount, sizeof(vertexCount), 1, out);
+		std::fwrite(hull.vertices.data(), sizeof(vec3), vertexCount, out);
+		std::fclose(out);
+	}
+
+	return hull;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "glmAddon.h"
+
+
+// Vertex budget for hulls cooked from meshes, enough for a recognisable silhouette while support stays a short loop
+#define DEFAULT_HULL_VERTICES 32
+
+
+// Convex hull collider data in the mesh's local space, shared by every entity that uses it.
+// Built with quickhull, always adding the point furthest outside the current hull, so stopping at a vertex budget
+// leaves the best approximation for that many vertices. It sits slightly inside the true hull.
+class ConvexHull {
+public:
+	struct Face {
+		vec3 normal;
+		float offset; // dot(normal, point) for any point on the face
+		int firstIndex; // into faceIndices
+		int indexCount;
+	};
+
+	std::vector<vec3> vertices;
+
+	// coplanar triangles are merged, so faces are convex polygons wound counter-clockwise from outside
+	std::vector<Face> faces;
+	std::vector<int> faceIndices;
+
+	// vertices joined to each vertex by a hull edge, neighbours[neighbourOffsets[i]] to neighbours[neighbourOffsets[i + 1]]
+	std::vector<int> neighbourOffsets;
+	std::vector<int> neighbours;
+
+	// at unit density and scale, about the local origin (not the centroid) since that's where bodies rotate
+	float volume = 0.f;
+	vec3 centroid = vec3(0);
+	mat3 secondMoment = mat3(0); // integral of x * x^T over the volume, divided by the volume
+
+public:
+	bool isValid() const { return vertices.size() >= 4; }
+
+	// Index of the vertex furthest along 'direction'
+	int getSupportVertex(vec3 direction) const {
+		int best = 0;
+		float bestDistance = dot(vertices[0], direction);
+
+		for (int i = 1; i < (int)vertices.size(); i++) {
+			float distance = dot(vertices[i], direction);
+			if (distance > bestDistance) {
+				bestDistance = distance;
+				best = i;
+			}
+		}
+
+		return best;
+	}
+
+	// Inertia tensor of a body of 'mass' using this hull at 'scale'
+	mat3 getInertia(float mass, vec3 scale) const;
+
+	// Invalid hull if the points are flat or there aren't enough of them
+	static ConvexHull build(const vec3* points, int pointCount, int maxVertices = DEFAULT_HULL_VERTICES);
+
+	// Loads the hull cached at 'name' (relative to the resources folder) if it was built from the same points and budget,
+	// otherwise builds it and writes the cache for next time
+	static ConvexHull cook(const std::vector<vec3>& points, const char* name, int maxVertices = DEFAULT_HULL_VERTICES);
+
+private:
+	// Faces, adjacency and mass properties from 'vertices' and the hull triangles
+	void finalise(const std::vector<int>& triangles);
+};
@@ -0,0 +1,361 @@
+#pragma once
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#include "ECSComponents.h"
+#include "ConvexHull.h"
+#include "glmAddon.h"
+
+
+// Most points a support feature can have, a cylinder cap is drawn as an octagon
+#define MAX_FEATURE_POINTS 8
+
+// How close a direction has to be to a face normal (or perpendicular to an edge) for the whole face (or edge) to count as touching
+#define FEATURE_FACE_TOLERANCE 0.95f
+#define FEATURE_EDGE_TOLERANCE 0.05f
+
+
+// A convex collider as a core shape grown by 'margin' in every direction.
+// Spheres are a point core and capsules a segment core, so GJK on the cores finds their contacts without EPA.
+//
+// Capsules and cylinders stand along their local z. Like spheres, scale x and y give their radius,
+// and like boxes, scale z is their full height, a capsule's includes its caps. Hulls are scaled like meshes.
+// A TRIANGLE_MESH shape is one of the mesh's triangles in world space.
+struct ConvexShape {
+	enumGeometry::type geometry;
+
+	vec3 position;
+	quat rotation;
+
+	vec3 extents = vec3(0); // box half size, hull scale, z is the core's half height for capsules and cylinders
+	float radius = 0.f; // cylinders
+	float margin = 0.f; // spheres and capsules
+
+	const ConvexHull* hull = nullptr;
+	vec3 triangle[3] = { vec3(0), vec3(0), vec3(0) };
+
+	static ConvexShape fromTransform(enumGeometry::type geometry, const TransformComponent& transform, const ConvexHull* hull = nullptr) {
+		ConvexShape shape = { geometry, transform.position, transform.rotation };
+		shape.hull = hull;
+
+		switch (geometry) {
+		case enumGeometry::BOX:
+			shape.extents = transform.scale * 0.5f;
+			break;
+		case enumGeometry::SPHERE:
+			shape.margin = (transform.scale.x + transform.scale.y + transform.scale.z) / 3.f;
+			break;
+		case enumGeometry::CAPSULE:
+			shape.margin = (transform.scale.x + transform.scale.y) * 0.5f;
+			shape.extents.z = std::max(transform.scale.z * 0.5f - shape.margin, 0.f);
+			break;
+		case enumGeometry::CYLINDER:
+			shape.radius = (transform.scale.x + transform.scale.y) * 0.5f;
+			shape.extents.z = transform.scale.z * 0.5f;
+			break;
+		case enumGeometry::CONVEX_HULL:
+			shape.extents = transform.scale;
+			break;
+		default:
+			break;
+		}
+
+		return shape;
+	}
+
+	static ConvexShape fromSphere(vec3 centre, float radius) {
+		ConvexShape shape = { enumGeometry::SPHERE, centre, quat(1, 0, 0, 0) };
+		shape.margin = radius;
+		return shape;
+	}
+
+	static ConvexShape fromTriangle(vec3 a, vec3 b, vec3 c) {
+		ConvexShape shape = { enumGeometry::TRIANGLE_MESH, (a + b + c) / 3.f, quat(1, 0, 0, 0) };
+		shape.triangle[0] = a;
+		shape.triangle[1] = b;
+		shape.triangle[2] = c;
+		return shape;
+	}
+
+	// Radius of the biggest sphere about 'position' that fits inside, hulls get a conservative guess
+	float getInnerRadius() const {
+		switch (geometry) {
+		case enumGeometry::BOX:
+			return std::min(std::min(extents.x, extents.y), extents.z);
+		case enumGeometry::CYLINDER:
+			return std::min(radius, extents.z);
+		case enumGeometry::CONVEX_HULL: {
+			float closestFace = FLT_MAX;
+			for (const ConvexHull::Face& face : hull->faces) {
+				closestFace = std::min(closestFace, face.offset);
+			}
+			vec3 scale = abs(extents);
+			return std::max(closestFace, 0.f) * std::min(std::min(scale.x, scale.y), scale.z);
+		}
+		default:
+			return margin;
+		}
+	}
+
+	// Radius of the smallest sphere about 'position' that holds the whole shape
+	float getOuterRadius() const {
+		switch (geometry) {
+		case enumGeometry::BOX:
+			return length(extents);
+		case enumGeometry::CAPSULE:
+			return extents.z + margin;
+		case enumGeometry::CYLINDER:
+			return std::sqrt(radius * radius + extents.z * extents.z);
+		case enumGeometry::CONVEX_HULL: {
+			float furthest = 0.f;
+			for (vec3 vertex : hull->vertices) {
+				furthest = std::max(furthest, length(extents * vertex));
+			}
+			return furthest;
+		}
+		case enumGeometry::TRIANGLE_MESH:
+			return std::max(std::max(length(triangle[0] - position), length(triangle[1] - position)), length(triangle[2] - position));
+		default:
+			return margin;
+		}
+	}
+
+	// The shape with 'depth' taken off every side, which shouldn't be more than its inner radius. Hulls are scaled
+	// down until their closest face has moved in that far, the rest move further
+	ConvexShape shrunk(float depth) const {
+		ConvexShape shape = *this;
+
+		switch (geometry) {
+		case enumGeometry::BOX:
+			shape.extents = max(extents - depth, vec3(0));
+			break;
+		case enumGeometry::CYLINDER:
+			shape.radius = std::max(radius - depth, 0.f);
+			shape.extents.z = std::max(extents.z - depth, 0.f);
+			break;
+		case enumGeometry::CONVEX_HULL: {
+			float innerRadius = getInnerRadius();
+			if (innerRadius > 0.f) shape.extents *= std::max(1.f - depth / innerRadius, 0.f);
+			break;
+		}
+		case enumGeometry::TRIANGLE_MESH:
+			break;
+		default:
+			shape.margin = std::max(margin - depth, 0.f);
+			break;
+		}
+
+		return shape;
+	}
+
+	// The shape moved 'travelled' along 'direction', turning by 'spin' radians about its position for each unit it moves
+	ConvexShape advanced(vec3 direction, vec3 spin, float travelled) const {
+		ConvexShape shape = *this;
+		shape.position += direction * travelled;
+		if (spin != vec3(0)) shape.rotation = normalize(deltaRotation(spin, travelled) * rotation);
+		return shape;
+	}
+
+	// Furthest point of the core along 'direction', which doesn't need to be normalised
+	vec3 supportCore(vec3 direction) const {
+		vec3 local = direction * rotation; // inverse rotation
+
+		switch (geometry) {
+		case enumGeometry::BOX:
+			return position + rotation * (extents * signs(local));
+		case enumGeometry::CAPSULE:
+			return position + rotation * vec3(0, 0, local.z < 0.f ? -extents.z : extents.z);
+		case enumGeometry::CYLINDER: {
+			vec3 point = vec3(0, 0, local.z < 0.f ? -extents.z : extents.z);
+
+			float radial = std::sqrt(local.x * local.x + local.y * local.y);
+			if (radial > 1e-6f) {
+				point.x = local.x / radial * radius;
+				point.y = local.y / radial * radius;
+			}
+			return position + rotation * point;
+		}
+		case enumGeometry::CONVEX_HULL:
+			return position + rotation * (extents * hull->vertices[hull->getSupportVertex(local * extents)]);
+		case enumGeometry::TRIANGLE_MESH:
+			return triangle[getTriangleSupport(direction)];
+		default:
+			return position;
+		}
+	}
+
+	// Furthest point of the whole shape along 'direction'
+	vec3 support(vec3 direction) const {
+		vec3 point = supportCore(direction);
+		if (margin > 0.f) point += normalize(direction) * margin;
+		return point;
+	}
+
+	// The part of the surface furthest along 'direction' (normalised): a face polygon in order, an edge or a single point
+	int getFeature(vec3 direction, vec3 out[MAX_FEATURE_POINTS]) const {
+		vec3 local = direction * rotation;
+		vec3 offset = direction * margin;
+
+		switch (geometry) {
+		case enumGeometry::BOX: {
+			int faceAxis = 0;
+			for (int i = 1; i < 3; i++) {
+				if (std::abs(local[i]) > std::abs(local[faceAxis])) faceAxis = i;
+			}
+
+			vec3 corner = extents * signs(local);
+
+			if (std::abs(local[faceAxis]) > FEATURE_FACE_TOLERANCE) {
+				int u = (faceAxis + 1) % 3;
+				int v = (faceAxis + 2) % 3;
+
+				vec3 centre = vec3(0);
+				centre[faceAxis] = corner[faceAxis];
+				vec3 sideU = vec3(0);
+				sideU[u] = extents[u];
+				vec3 sideV = vec3(0);
+				sideV[v] = extents[v];
+
+				out[0] = position + rotation * (centre + sideU + sideV);
+				out[1] = position + rotation * (centre - sideU + sideV);
+				out[2] = position + rotation * (centre - sideU - sideV);
+				out[3] = position + rotation * (centre + sideU - sideV);
+				return 4;
+			}
+
+			for (int i = 0; i < 3; i++) {
+				if (std::abs(local[i]) < FEATURE_EDGE_TOLERANCE) {
+					vec3 end = corner;
+					end[i] = -corner[i];
+
+					out[0] = position + rotation * corner;
+					out[1] = position + rotation * end;
+					return 2;
+				}
+			}
+
+			out[0] = position + rotation * corner;
+			return 1;
+		}
+		case enumGeometry::CAPSULE: {
+			vec3 top = position + rotation * vec3(0, 0, extents.z);
+			vec3 bottom = position - rotation * vec3(0, 0, extents.z);
+
+			if (std::abs(local.z) < FEATURE_EDGE_TOLERANCE) {
+				out[0] = top + offset;
+				out[1] = bottom + offset;
+				return 2;
+			}
+
+			out[0] = (local.z < 0.f ? bottom : top) + offset;
+			return 1;
+		}
+		case enumGeometry::CYLINDER: {
+			float capZ = local.z < 0.f ? -extents.z : extents.z;
+
+			if (std::abs(local.z) > FEATURE_FACE_TOLERANCE) {
+				// wound the same way seen from either cap, clipping only cares that it's convex
+				for (int i = 0; i < MAX_FEATURE_POINTS; i++) {
+					float angle = i * (glm::two_pi<float>() / MAX_FEATURE_POINTS);
+					out[i] = position + rotation * vec3(std::cos(angle) * radius, std::sin(angle) * radius, capZ);
+				}
+				return MAX_FEATURE_POINTS;
+			}
+
+			if (std::abs(local.z) < FEATURE_EDGE_TOLERANCE) {
+				vec3 radial = normalize(vec3(local.x, local.y, 0.f)) * radius;
+
+				out[0] = position + rotation * vec3(radial.x, radial.y, extents.z);
+				out[1] = position + rotation * vec3(radial.x, radial.y, -extents.z);
+				return 2;
+			}
+
+			out[0] = supportCore(direction);
+			return 1;
+		}
+		case enumGeometry::CONVEX_HULL: {
+			// scaling bends face normals by the inverse scale
+			const ConvexHull::Face* bestFace = nullptr;
+			float bestAlignment = FEATURE_FACE_TOLERANCE;
+			for (const ConvexHull::Face& face : hull->faces) {
+				float alignment = dot(normalize(face.normal / extents), local);
+				if (alignment > bestAlignment) {
+					bestAlignment = alignment;
+					bestFace = &face;
+				}
+			}
+
+			if (bestFace) {
+				// every other vertex of a big face is still a convex polygon
+				int count = std::min(bestFace->indexCount, MAX_FEATURE_POINTS);
+				for (int i = 0; i < count; i++) {
+					int index = hull->faceIndices[bestFace->firstIndex + i * bestFace->indexCount / count];
+					out[i] = position + rotation * (extents * hull->vertices[index]);
+				}
+				return count;
+			}
+
+			int vertex = hull->getSupportVertex(local * extents);
+			vec3 corner = extents * hull->vertices[vertex];
+			out[0] = position + rotation * corner;
+
+			for (int i = hull->neighbourOffsets[vertex]; i < hull->neighbourOffsets[vertex + 1]; i++) {
+				vec3 end = extents * hull->vertices[hull->neighbours[i]];
+				if (std::abs(dot(normalize(end - corner), local)) < FEATURE_EDGE_TOLERANCE) {
+					out[1] = position + rotation * end;
+					return 2;
+				}
+			}
+			return 1;
+		}
+		case enumGeometry::TRIANGLE_MESH: {
+			// two sided, either side facing 'direction' is the whole triangle
+			vec3 normal = normalize(cross(triangle[1] - triangle[0], triangle[2] - triangle[0]));
+			if (std::abs(dot(normal, direction)) > FEATURE_FACE_TOLERANCE) {
+				for (int i = 0; i < 3; i++) out[i] = triangle[i];
+				return 3;
+			}
+
+			int vertex = getTriangleSupport(direction);
+			out[0] = triangle[vertex];
+
+			for (int i = 1; i < 3; i++) {
+				vec3 end = triangle[(vertex + i) % 3];
+				if (std::abs(dot(normalize(end - out[0]), direction)) < FEATURE_EDGE_TOLERANCE) {
+					out[1] = end;
+					return 2;
+				}
+			}
+			return 1;
+		}
+		default:
+			out[0] = support(direction);
+			return 1;
+		}
+	}
+
+	// World AABB from the support function, for shapes without a closed form
+	void getBounds(vec3& min, vec3& max) const {
+		for (int i = 0; i < 3; i++) {
+			vec3 axis = vec3(0);
+			axis[i] = 1.f;
+
+			max[i] = support(axis)[i];
+			min[i] = support(-axis)[i];
+		}
+	}
+
+private:
+	int getTriangleSupport(vec3 direction) const {
+		float distances[3] = { dot(triangle[0], direction), dot(triangle[1], direction), dot(triangle[2], direction) };
+		if (distances[0] >= distances[1]) return distances[0] >= distances[2] ? 0 : 2;
+		return distances[1] >= distances[2] ? 1 : 2;
+	}
+
+	// Like glm::sign but 0 counts as positive, so a support point is always a vertex
+	static vec3 signs(vec3 v) {
+		return vec3(v.x < 0.f ? -1.f : 1.f, v.y < 0.f ? -1.f : 1.f, v.z < 0.f ? -1.f : 1.f);
+	}
+};
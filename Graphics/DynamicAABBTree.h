@@ -0,0 +1,334 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+
+#include "Broadphase.h"
+
+
+// Dynamic bounding volume tree over fattened leaf AABBs.
+// Leaves are only reinserted once their shape escapes the fat AABB, so resting and slow bodies cost nothing to maintain.
+// Sibling choice uses the surface area heuristic and AVL style rotations keep the tree balanced.
+class DynamicAABBTree {
+public:
+	static constexpr int nullNode = -1;
+
+private:
+	struct Node {
+		AABB aabb;
+
+		// parent also links the free list
+		int parent = nullNode;
+		int child1 = nullNode;
+		int child2 = nullNode;
+
+		// leaf = 0, free node = -1
+		int height = -1;
+
+		ECS::uint entityID = UINT8_MAX;
+
+		bool isLeaf() const { return child1 == nullNode; }
+	};
+
+	static constexpr int capacity = 2 * MAX_ENTITIES;
+
+	int root = nullNode;
+	int freeList = 0;
+	Node nodes[capacity];
+
+	float fatMargin = 0.1f;
+
+public:
+	DynamicAABBTree() {
+		for (int i = 0; i < capacity - 1; i++) {
+			nodes[i].parent = i + 1;
+		}
+		nodes[capacity - 1].parent = nullNode;
+	}
+
+	void setFatMargin(float margin) { fatMargin = margin; }
+
+	int createProxy(const AABB& aabb, ECS::uint entityID) {
+		int proxyID = allocateNode();
+
+		nodes[proxyID].aabb = { aabb.min - vec3(fatMargin), aabb.max + vec3(fatMargin) };
+		nodes[proxyID].entityID = entityID;
+		nodes[proxyID].height = 0;
+
+		insertLeaf(proxyID);
+		return proxyID;
+	}
+
+	void destroyProxy(int proxyID) {
+		assert(proxyID >= 0 && proxyID < capacity && nodes[proxyID].isLeaf());
+
+		removeLeaf(proxyID);
+		freeNode(proxyID);
+	}
+
+	// Returns true if the leaf had to be reinserted
+	bool moveProxy(int proxyID, const AABB& aabb) {
+		assert(proxyID >= 0 && proxyID < capacity && nodes[proxyID].isLeaf());
+
+		if (nodes[proxyID].aabb.contains(aabb)) return false;
+
+		removeLeaf(proxyID);
+		nodes[proxyID].aabb = { aabb.min - vec3(fatMargin), aabb.max + vec3(fatMargin) };
+		insertLeaf(proxyID);
+
+		return true;
+	}
+
+	const AABB& getFatAABB(int proxyID) const { return nodes[proxyID].aabb; }
+	ECS::uint getEntity(int proxyID) const { return nodes[proxyID].entityID; }
+	int getHeight() const { return root == nullNode ? 0 : nodes[root].height; }
+
+	// Calls 'callback(entityID)' for every leaf whose fat AABB overlaps 'aabb'
+	template<typename Callback>
+	void query(const AABB& aabb, Callback callback) const {
+		int stack[capacity];
+		int stackCount = 0;
+
+		if (root != nullNode) stack[stackCount++] = root;
+
+		while (stackCount > 0) {
+			const Node& node = nodes[stack[--stackCount]];
+
+			if (!node.aabb.overlaps(aabb)) continue;
+
+			if (node.isLeaf()) {
+				callback(node.entityID);
+			}
+			else {
+				stack[stackCount++] = node.child1;
+				stack[stackCount++] = node.child2;
+			}
+		}
+	}
+
+	// Calls 'callback(ray, entityID)' for each of up to 32 rays and every leaf whose fat AABB, grown by 'radius',
+	// its segment passes through. The packet walks the tree once, a node is skipped as soon as no ray in it hits.
+	// 'maxDistances' is read at every node so callbacks can shorten their ray to cut off the rest of the tree
+	template<typename Callback>
+	void raycastPacket(const vec3* origins, const vec3* inverseDirections, const float* maxDistances, int rayCount, float radius, Callback callback) const {
+		assert(rayCount > 0 && rayCount <= 32);
+
+		struct Entry {
+			int node;
+			unsigned int rays; // bit per ray still alive at this node
+		};
+
+		Entry stack[capacity];
+		int stackCount = 0;
+
+		if (root != nullNode) stack[stackCount++] = { root, rayCount == 32 ? ~0u : (1u << rayCount) - 1 };
+
+		while (stackCount > 0) {
+			Entry entry = stack[--stackCount];
+			const Node& node = nodes[entry.node];
+
+			unsigned int rays = 0;
+			for (unsigned int remaining = entry.rays; remaining != 0; remaining &= remaining - 1) {
+				int i = std::countr_zero(remaining);
+				if (node.aabb.intersectsRay(origins[i], inverseDirections[i], maxDistances[i], radius)) rays |= 1u << i;
+			}
+			if (rays == 0) continue;
+
+			if (node.isLeaf()) {
+				for (unsigned int remaining = rays; remaining != 0; remaining &= remaining - 1) {
+					callback(std::countr_zero(remaining), node.entityID);
+				}
+			}
+			else {
+				stack[stackCount++] = { node.child1, rays };
+				stack[stackCount++] = { node.child2, rays };
+			}
+		}
+	}
+
+private:
+	int allocateNode() {
+		assert(freeList != nullNode && "AABB tree capacity reached");
+
+		int nodeID = freeList;
+		freeList = nodes[nodeID].parent;
+
+		nodes[nodeID] = Node();
+		return nodeID;
+	}
+
+	void freeNode(int nodeID) {
+		nodes[nodeID].parent = freeList;
+		nodes[nodeID].height = -1;
+		freeList = nodeID;
+	}
+
+	void insertLeaf(int leaf) {
+		if (root == nullNode) {
+			root = leaf;
+			nodes[root].parent = nullNode;
+			return;
+		}
+
+		// Walk down picking whichever side grows the least surface area
+		AABB leafAABB = nodes[leaf].aabb;
+		int index = root;
+		while (!nodes[index].isLeaf()) {
+			int child1 = nodes[index].child1;
+			int child2 = nodes[index].child2;
+
+			float area = nodes[index].aabb.getSurfaceArea();
+			float combinedArea = AABB::merge(nodes[index].aabb, leafAABB).getSurfaceArea();
+
+			// cost of making a new parent for this node and the leaf
+			float cost = 2.f * combinedArea;
+
+			// minimum cost of pushing the leaf further down
+			float inheritanceCost = 2.f * (combinedArea - area);
+
+			float cost1 = calcDescendCost(child1, leafAABB) + inheritanceCost;
+			float cost2 = calcDescendCost(child2, leafAABB) + inheritanceCost;
+
+			if (cost < cost1 && cost < cost2) break;
+
+			index = cost1 < cost2 ? child1 : child2;
+		}
+
+		int sibling = index;
+
+		// New parent takes the sibling's place
+		int oldParent = nodes[sibling].parent;
+		int newParent = allocateNode();
+		nodes[newParent].parent = oldParent;
+		nodes[newParent].aabb = AABB::merge(leafAABB, nodes[sibling].aabb);
+		nodes[newParent].height = nodes[sibling].height + 1;
+		nodes[newParent].child1 = sibling;
+		nodes[newParent].child2 = leaf;
+		nodes[sibling].parent = newParent;
+		nodes[leaf].parent = newParent;
+
+		if (oldParent == nullNode) {
+			root = newParent;
+		}
+		else if (nodes[oldParent].child1 == sibling) {
+			nodes[oldParent].child1 = newParent;
+		}
+		else {
+			nodes[oldParent].child2 = newParent;
+		}
+
+		refitAncestors(nodes[leaf].parent);
+	}
+
+	void removeLeaf(int leaf) {
+		if (leaf == root) {
+			root = nullNode;
+			return;
+		}
+
+		int parent = nodes[leaf].parent;
+		int grandParent = nodes[parent].parent;
+		int sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+
+		// Sibling replaces the parent
+		if (grandParent == nullNode) {
+			root = sibling;
+			nodes[sibling].parent = nullNode;
+			freeNode(parent);
+			return;
+		}
+
+		if (nodes[grandParent].child1 == parent) {
+			nodes[grandParent].child1 = sibling;
+		}
+		else {
+			nodes[grandParent].child2 = sibling;
+		}
+		nodes[sibling].parent = grandParent;
+		freeNode(parent);
+
+		refitAncestors(grandParent);
+	}
+
+	float calcDescendCost(int child, const AABB& leafAABB) const {
+		float mergedArea = AABB::merge(leafAABB, nodes[child].aabb).getSurfaceArea();
+
+		if (nodes[child].isLeaf()) return mergedArea;
+
+		return mergedArea - nodes[child].aabb.getSurfaceArea();
+	}
+
+	void refitAncestors(int index) {
+		while (index != nullNode) {
+			index = balance(index);
+
+			int child1 = nodes[index].child1;
+			int child2 = nodes[index].child2;
+
+			nodes[index].height = 1 + std::max(nodes[child1].height, nodes[child2].height);
+			nodes[index].aabb = AABB::merge(nodes[child1].aabb, nodes[child2].aabb);
+
+			index = nodes[index].parent;
+		}
+	}
+
+	// Rotates the taller grandchild up if 'a' is imbalanced, returns the new root of the subtree
+	int balance(int a) {
+		Node& A = nodes[a];
+		if (A.isLeaf() || A.height < 2) return a;
+
+		int b = A.child1;
+		int c = A.child2;
+		int heightDiff = nodes[c].height - nodes[b].height;
+
+		if (heightDiff > 1) return rotate(a, c, b);
+		if (heightDiff < -1) return rotate(a, b, c);
+
+		return a;
+	}
+
+	// 'tall' is the taller child of 'a' and gets promoted in its place
+	int rotate(int a, int tall, int shortChild) {
+		Node& A = nodes[a];
+		Node& T = nodes[tall];
+
+		int f = T.child1;
+		int g = T.child2;
+
+		// Swap a and tall
+		T.child1 = a;
+		T.parent = A.parent;
+		A.parent = tall;
+
+		if (T.parent == nullNode) {
+			root = tall;
+		}
+		else if (nodes[T.parent].child1 == a) {
+			nodes[T.parent].child1 = tall;
+		}
+		else {
+			nodes[T.parent].child2 = tall;
+		}
+
+		// Taller grandchild stays under 'tall', the other one moves under 'a'
+		int keep = nodes[f].height > nodes[g].height ? f : g;
+		int move = keep == f ? g : f;
+
+		T.child2 = keep;
+		if (A.child1 == tall) {
+			A.child1 = move;
+		}
+		else {
+			A.child2 = move;
+		}
+		nodes[move].parent = a;
+
+		A.aabb = AABB::merge(nodes[shortChild].aabb, nodes[move].aabb);
+		A.height = 1 + std::max(nodes[shortChild].height, nodes[move].height);
+
+		T.aabb = AABB::merge(A.aabb, nodes[keep].aabb);
+		T.height = 1 + std::max(A.height, nodes[keep].height);
+
+		return tall;
+	}
+};
@@ -179,7 +179,8 @@ namespace ECS {
 
 		template<typename T>
 		void registerComponent() {
-			assert(!IComponentType<T>::isRegistered && "Component already registered");
+			// IDs are shared by every manager, each has to register its components in the same order
+			assert((!IComponentType<T>::isRegistered || IComponentType<T>::componentID == componentTypes) && "Component registered under another ID");
 
 			componentPools[componentTypes] = new ComponentPool<T>();
 			IComponentType<T>::componentID = componentTypes;
@@ -244,12 +245,14 @@ namespace ECS {
 		void addEntity(uint entityID) {
 			if (hasEntity(entityID)) return;
 			entities[entityCount++] = entityID;
+			onEntityAdded(entityID);
 		}
 
 		void removeEntity(uint entityID) {
 			for (uint i = 0; i < entityCount; i++) {
 				if (entities[i] == entityID) {
 					entities[i] = entities[--entityCount];
+					onEntityRemoved(entityID);
 					break;
 				}
 			}
@@ -263,6 +266,10 @@ namespace ECS {
 			}
 			return false;
 		}
+
+		// Hooks for systems that keep their own per-entity data structures in sync
+		virtual void onEntityAdded(uint) {}
+		virtual void onEntityRemoved(uint) {}
 	};
 
 	template<typename T>
@@ -279,7 +286,8 @@ namespace ECS {
 	public:
 		template<typename T>
 		System* registerSystem() {
-			assert(!ISystemType<T>::isRegistered && "System already registered");
+			// IDs are shared by every manager, each has to register its systems in the same order
+			assert((!ISystemType<T>::isRegistered || ISystemType<T>::systemID == systemsCount) && "System registered under another ID");
 
 			uint systemID = systemsCount++;
 			systems[systemID] = new T();
@@ -26,16 +26,28 @@ struct PhysicsComponent {
 	vec3 angVel;
 	vec3 angAcc;
 	mat3 invInertia;
+
+	// Sleeping bodies are skipped by integration, the broadphase and the solver until something touches them
+	bool isAsleep = false;
+	int restTicks = 0;
+
+	// Opt in to continuous collision for small fast bodies, which are swept against the world on ticks they move further than their own size
+	bool continuous = false;
 };
 
 namespace enumGeometry {
 	enum type : unsigned int {
 		BOX,
 		SPHERE,
-		PLANE
+		PLANE,
+		CAPSULE, // along local z, see ConvexShape for how scale maps to their size
+		CYLINDER,
+		CONVEX_HULL,
+		TRIANGLE_MESH // static only
 	};
 }
 
 struct CollisionComponent {
 	enumGeometry::type geometry;
+	int shapeID = 0; // which of CollisionSystem's hulls or triangle meshes a CONVEX_HULL or TRIANGLE_MESH uses
 };
\ No newline at end of file
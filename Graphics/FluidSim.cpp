@@ -1,6 +1,7 @@
 #include "FluidSim.h"
 
 #include "ModularFluids.h"
+#include "FrameProfiler.h"
 
 
 FluidSimSPH::~FluidSimSPH() { ModularFluids::Destroy(sim); }
@@ -12,7 +13,10 @@ void FluidSimSPH::init(glm::vec3 _position, glm::vec3 _bounds, glm::vec3 _gravit
 	sim->init(_position, _bounds, _gravity, _particleRadius, _restDensity, _stiffness, _nearStiffness);
 }
 
-void FluidSimSPH::update(float deltaTime) { sim->update(deltaTime); }
+void FluidSimSPH::update(float deltaTime) {
+	PROFILE_ZONE("FluidSimSPH::update");
+	sim->update(deltaTime);
+}
 void FluidSimSPH::tickSimGPU() { sim->stepSim(); }
 
 // Spawns random particle within bounding box
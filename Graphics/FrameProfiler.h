@@ -0,0 +1,204 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+
+// Compile with FRAME_PROFILING=0 to strip every zone out
+#ifndef FRAME_PROFILING
+#define FRAME_PROFILING 1
+#endif
+
+// Frames kept around for writeTrace, and the most zones they can hold between them
+#define FRAME_PROFILER_FRAMES 120
+#define FRAME_PROFILER_ZONES (1 << 16)
+
+
+// Records named, timed zones from any thread into a ring buffer that always holds the last
+// FRAME_PROFILER_FRAMES frames, so a hitch can be saved after it's happened.
+// writeTrace dumps them as Chrome trace-event JSON, open it in chrome://tracing or ui.perfetto.dev.
+// Zones nest by time on each thread, the viewer works out the nesting itself.
+class FrameProfiler {
+private:
+	using clock = std::chrono::steady_clock;
+
+	struct Zone {
+		const char* name;
+		int threadID;
+		std::int64_t start; // nanoseconds since 'origin'
+		std::int64_t duration;
+	};
+
+	clock::time_point origin = clock::now();
+
+	std::mutex mutex;
+
+	std::unique_ptr<Zone[]> zones = std::make_unique<Zone[]>(FRAME_PROFILER_ZONES);
+	std::uint64_t zoneCount = 0; // ever recorded, the newest is at (zoneCount - 1) % FRAME_PROFILER_ZONES
+
+	// first zone and start time of each frame in the ring
+	std::uint64_t frameFirstZone[FRAME_PROFILER_FRAMES] = {};
+	std::int64_t frameStart[FRAME_PROFILER_FRAMES] = {};
+	std::uint64_t frameCount = 0;
+
+	std::vector<std::string> threadNames;
+
+	inline static thread_local int currentThreadID = -1;
+
+	// Under 'mutex'
+	int getThreadID() {
+		if (currentThreadID < 0) {
+			currentThreadID = (int)threadNames.size();
+			threadNames.push_back("Thread " + std::to_string(currentThreadID));
+		}
+		return currentThreadID;
+	}
+
+public:
+	static FrameProfiler& get() {
+		static FrameProfiler profiler;
+		return profiler;
+	}
+
+	std::int64_t now() const {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - origin).count();
+	}
+
+	// Starts a new frame, the oldest one drops out of the ring
+	void beginFrame() {
+		std::int64_t time = now();
+
+		std::lock_guard<std::mutex> lock(mutex);
+		frameFirstZone[frameCount % FRAME_PROFILER_FRAMES] = zoneCount;
+		frameStart[frameCount % FRAME_PROFILER_FRAMES] = time;
+		frameCount++;
+	}
+
+	// Label for the calling thread in the trace
+	void setThreadName(const char* name) {
+		std::lock_guard<std::mutex> lock(mutex);
+		threadNames[getThreadID()] = name;
+	}
+
+	// 'name' has to outlive the profiler, string literals are fine
+	void recordZone(const char* name, std::int64_t start, std::int64_t end) {
+		std::lock_guard<std::mutex> lock(mutex);
+		zones[zoneCount % FRAME_PROFILER_ZONES] = { name, getThreadID(), start, end - start };
+		zoneCount++;
+	}
+
+	std::uint64_t getFrameCount() {
+		std::lock_guard<std::mutex> lock(mutex);
+		return frameCount;
+	}
+
+	// Writes every zone from the oldest frame still in the ring onwards, false if the file couldn't be opened
+	bool writeTrace(const char* path) {
+		std::vector<Zone> traceZones;
+		std::vector<std::string> traceThreadNames;
+		std::vector<std::int64_t> traceFrames;
+		std::uint64_t firstFrame = 0;
+		{
+			// copied out so recording isn't held up by the file writes
+			std::lock_guard<std::mutex> lock(mutex);
+
+			firstFrame = frameCount > FRAME_PROFILER_FRAMES ? frameCount - FRAME_PROFILER_FRAMES : 0;
+			std::uint64_t firstZone = frameCount > 0 ? frameFirstZone[firstFrame % FRAME_PROFILER_FRAMES] : 0;
+
+			// zones that were overwritten before their frame left the ring are gone
+			if (zoneCount > FRAME_PROFILER_ZONES) firstZone = std::max(firstZone, zoneCount - FRAME_PROFILER_ZONES);
+
+			traceZones.reserve(zoneCount - firstZone);
+			for (std::uint64_t i = firstZone; i < zoneCount; i++) {
+				traceZones.push_back(zones[i % FRAME_PROFILER_ZONES]);
+			}
+
+			for (std::uint64_t i = firstFrame; i < frameCount; i++) {
+				traceFrames.push_back(frameStart[i % FRAME_PROFILER_FRAMES]);
+			}
+
+			traceThreadNames = threadNames;
+		}
+
+		FILE* out = std::fopen(path, "w");
+		if (!out) return false;
+
+		std::fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+		std::fprintf(out, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"Graphics\"}}");
+
+		for (int i = 0; i < (int)traceThreadNames.size(); i++) {
+			std::fprintf(out, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}", i, traceThreadNames[i].c_str());
+		}
+
+		// frame starts as global instant events, drawn as lines across every thread
+		for (int i = 0; i < (int)traceFrames.size(); i++) {
+			std::fprintf(out, ",\n{\"name\":\"Frame %llu\",\"ph\":\"i\",\"s\":\"g\",\"pid\":1,\"tid\":0,\"ts\":%.3f}",
+				(unsigned long long)(firstFrame + i), traceFrames[i] / 1000.0);
+		}
+
+		// timestamps are in microseconds
+		for (const Zone& zone : traceZones) {
+			std::fprintf(out, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+				zone.name, zone.threadID, zone.start / 1000.0, zone.duration / 1000.0);
+		}
+
+		std::fprintf(out, "\n]}\n");
+		return std::fclose(out) == 0;
+	}
+};
+
+
+// Times from construction to destruction as one zone.
+// next() ends the current zone and starts another straight after, for back to back passes in one scope.
+class ProfileZone {
+private:
+	const char* name;
+	std::int64_t start;
+
+public:
+	ProfileZone(const char* _name) : name(_name) {
+		start = FrameProfiler::get().now();
+	}
+
+	~ProfileZone() {
+		FrameProfiler::get().recordZone(name, start, FrameProfiler::get().now());
+	}
+
+	void next(const char* nextName) {
+		std::int64_t end = FrameProfiler::get().now();
+		FrameProfiler::get().recordZone(name, start, end);
+
+		name = nextName;
+		start = end;
+	}
+
+	ProfileZone(const ProfileZone&) = delete;
+	ProfileZone& operator=(const ProfileZone&) = delete;
+};
+
+
+#define PROFILE_JOIN_INNER(a, b) a##b
+#define PROFILE_JOIN(a, b) PROFILE_JOIN_INNER(a, b)
+
+#if FRAME_PROFILING
+// Zone for the rest of the enclosing scope
+#define PROFILE_ZONE(name) ProfileZone PROFILE_JOIN(profileZone, __LINE__)(name)
+// Named zone that can be moved on with PROFILE_NEXT
+#define PROFILE_ZONE_NAMED(variable, name) ProfileZone variable(name)
+#define PROFILE_NEXT(variable, name) variable.next(name)
+#define PROFILE_FRAME() FrameProfiler::get().beginFrame()
+#define PROFILE_THREAD(name) FrameProfiler::get().setThreadName(name)
+#else
+#define PROFILE_ZONE(name) ((void)0)
+#define PROFILE_ZONE_NAMED(variable, name) ((void)0)
+#define PROFILE_NEXT(variable, name) ((void)0)
+#define PROFILE_FRAME() ((void)0)
+#define PROFILE_THREAD(name) ((void)0)
+#endif
@@ -0,0 +1,560 @@
+#include "GJK.h"
+
+#include <cfloat>
+#include <cmath>
+#include <algorithm>
+
+
+#define GJK_MAX_ITERATIONS 32
+// Converged once another support point gets less than this fraction closer
+#define GJK_RELATIVE_TOLERANCE 1e-6f
+
+#define EPA_MAX_ITERATIONS 32
+#define EPA_TOLERANCE 1e-4f
+#define EPA_MAX_VERTICES 64
+#define EPA_MAX_FACES 128
+
+// Grazing casts close in slowly, anything still short of the surface after this many steps counts as a miss
+#define CAST_MAX_ITERATIONS 64
+#define CAST_TOLERANCE 1e-4f
+// How far back the normal is measured from when the cores end up touching, closer than this rounding swamps it
+#define CAST_NORMAL_DISTANCE 1e-2f
+
+
+namespace {
+	struct SupportPoint {
+		vec3 point; // a - b
+		vec3 a;
+		vec3 b;
+	};
+
+	void setPoint(GJKSimplex& simplex, int index, const SupportPoint& support) {
+		simplex.points[index] = support.point;
+		simplex.supportA[index] = support.a;
+		simplex.supportB[index] = support.b;
+	}
+
+	// Copies the listed points of 'from' into 'to' with their weights
+	void keepPoints(const GJKSimplex& from, GJKSimplex& to, const int* indices, const float* weights, int count) {
+		for (int i = 0; i < count; i++) {
+			to.points[i] = from.points[indices[i]];
+			to.supportA[i] = from.supportA[indices[i]];
+			to.supportB[i] = from.supportB[indices[i]];
+			to.weights[i] = weights[i];
+		}
+		to.count = count;
+	}
+
+	void closestOnSegment(const GJKSimplex& simplex, int i0, int i1, GJKSimplex& out) {
+		vec3 a = simplex.points[i0];
+		vec3 ab = simplex.points[i1] - a;
+
+		float t = dot(-a, ab);
+		float lengthSquared = dot(ab, ab);
+
+		if (t <= 0.f || lengthSquared <= FLT_EPSILON) {
+			int indices[1] = { i0 };
+			float weights[1] = { 1.f };
+			keepPoints(simplex, out, indices, weights, 1);
+		}
+		else if (t >= lengthSquared) {
+			int indices[1] = { i1 };
+			float weights[1] = { 1.f };
+			keepPoints(simplex, out, indices, weights, 1);
+		}
+		else {
+			t /= lengthSquared;
+			int indices[2] = { i0, i1 };
+			float weights[2] = { 1.f - t, t };
+			keepPoints(simplex, out, indices, weights, 2);
+		}
+	}
+
+	// Voronoi regions of the triangle, same tests as Ericson's closest point on triangle with the origin as the query point
+	void closestOnTriangle(const GJKSimplex& simplex, int i0, int i1, int i2, GJKSimplex& out) {
+		vec3 a = simplex.points[i0];
+		vec3 b = simplex.points[i1];
+		vec3 c = simplex.points[i2];
+
+		vec3 ab = b - a;
+		vec3 ac = c - a;
+
+		float d1 = dot(ab, -a);
+		float d2 = dot(ac, -a);
+		if (d1 <= 0.f && d2 <= 0.f) {
+			int indices[1] = { i0 };
+			float weights[1] = { 1.f };
+			keepPoints(simplex, out, indices, weights, 1);
+			return;
+		}
+
+		float d3 = dot(ab, -b);
+		float d4 = dot(ac, -b);
+		if (d3 >= 0.f && d4 <= d3) {
+			int indices[1] = { i1 };
+			float weights[1] = { 1.f };
+			keepPoints(simplex, out, indices, weights, 1);
+			return;
+		}
+
+		float vc = d1 * d4 - d3 * d2;
+		if (vc <= 0.f && d1 >= 0.f && d3 <= 0.f) {
+			closestOnSegment(simplex, i0, i1, out);
+			return;
+		}
+
+		float d5 = dot(ab, -c);
+		float d6 = dot(ac, -c);
+		if (d6 >= 0.f && d5 <= d6) {
+			int indices[1] = { i2 };
+			float weights[1] = { 1.f };
+			keepPoints(simplex, out, indices, weights, 1);
+			return;
+		}
+
+		float vb = d5 * d2 - d1 * d6;
+		if (vb <= 0.f && d2 >= 0.f && d6 <= 0.f) {
+			closestOnSegment(simplex, i0, i2, out);
+			return;
+		}
+
+		float va = d3 * d6 - d5 * d4;
+		if (va <= 0.f && (d4 - d3) >= 0.f && (d5 - d6) >= 0.f) {
+			closestOnSegment(simplex, i1, i2, out);
+			return;
+		}
+
+		float total = va + vb + vc;
+		if (total <= FLT_EPSILON) {
+			// collinear, the closest edge will do
+			closestOnSegment(simplex, i0, i1, out);
+			return;
+		}
+
+		float v = vb / total;
+		float w = vc / total;
+		int indices[3] = { i0, i1, i2 };
+		float weights[3] = { 1.f - v - w, v, w };
+		keepPoints(simplex, out, indices, weights, 3);
+	}
+
+	// Closest face the origin is outside of, or false if the tetrahedron contains the origin
+	bool closestOnTetrahedron(const GJKSimplex& simplex, GJKSimplex& out) {
+		static const int faces[4][4] = {
+			{ 0, 1, 2, 3 },
+			{ 0, 3, 1, 2 },
+			{ 0, 2, 3, 1 },
+			{ 1, 3, 2, 0 }
+		};
+
+		bool outside = false;
+		float closestDistance = FLT_MAX;
+
+		for (const int* face : faces) {
+			vec3 a = simplex.points[face[0]];
+			vec3 normal = cross(simplex.points[face[1]] - a, simplex.points[face[2]] - a);
+
+			float originSide = dot(-a, normal);
+			float oppositeSide = dot(simplex.points[face[3]] - a, normal);
+
+			// origin on the same side as the fourth point, flat tetrahedrons check every face
+			if (originSide * oppositeSide > 0.f && oppositeSide * oppositeSide > FLT_EPSILON * dot(normal, normal)) continue;
+
+			GJKSimplex candidate;
+			closestOnTriangle(simplex, face[0], face[1], face[2], candidate);
+
+			vec3 closest = vec3(0);
+			for (int i = 0; i < candidate.count; i++) {
+				closest += candidate.points[i] * candidate.weights[i];
+			}
+
+			float distance = dot(closest, closest);
+			if (distance < closestDistance) {
+				closestDistance = distance;
+				out = candidate;
+			}
+			outside = true;
+		}
+
+		return outside;
+	}
+
+	vec3 getClosestPoint(const GJKSimplex& simplex) {
+		vec3 closest = vec3(0);
+		for (int i = 0; i < simplex.count; i++) {
+			closest += simplex.points[i] * simplex.weights[i];
+		}
+		return closest;
+	}
+
+	// GJK on whatever 'support' returns for A - B, shared by the core distance and EPA's starting simplex
+	template<typename Support>
+	GJKResult runGJK(Support support, vec3 direction, float maxDistance, GJKSimplex& simplex) {
+		GJKResult result;
+
+		simplex.count = 1;
+		setPoint(simplex, 0, support(direction));
+		simplex.weights[0] = 1.f;
+
+		vec3 v = simplex.points[0];
+
+		for (int iteration = 0; iteration < GJK_MAX_ITERATIONS; iteration++) {
+			result.iterations = iteration + 1;
+
+			float vv = dot(v, v);
+			if (vv <= FLT_EPSILON * FLT_EPSILON) {
+				// origin sits on the simplex
+				result.overlapping = true;
+				return result;
+			}
+
+			SupportPoint w = support(-v);
+			float vw = dot(v, w.point);
+
+			// every point of A - B is at least vw / |v| from the origin
+			if (vw > 0.f && vw * vw > maxDistance * maxDistance * vv) {
+				result.separated = true;
+				result.distance = vw / std::sqrt(vv);
+				result.normal = -v / std::sqrt(vv);
+				return result;
+			}
+
+			// w is no closer, so v is as close as it gets
+			if (vv - vw <= GJK_RELATIVE_TOLERANCE * vv) break;
+
+			GJKSimplex next = simplex;
+			setPoint(next, next.count, w);
+			next.count++;
+
+			GJKSimplex reduced;
+			switch (next.count) {
+			case 2:
+				closestOnSegment(next, 0, 1, reduced);
+				break;
+			case 3:
+				closestOnTriangle(next, 0, 1, 2, reduced);
+				break;
+			default:
+				if (!closestOnTetrahedron(next, reduced)) {
+					simplex = next;
+					result.overlapping = true;
+					return result;
+				}
+				break;
+			}
+
+			vec3 closer = getClosestPoint(reduced);
+
+			// rounding stopped it making progress
+			if (dot(closer, closer) >= vv) break;
+
+			simplex = reduced;
+			v = closer;
+		}
+
+		result.distance = std::sqrt(dot(v, v));
+		result.normal = -v / result.distance;
+		for (int i = 0; i < simplex.count; i++) {
+			result.pointA += simplex.supportA[i] * simplex.weights[i];
+			result.pointB += simplex.supportB[i] * simplex.weights[i];
+		}
+		return result;
+	}
+
+	vec3 getStartDirection(const ConvexShape& a, const ConvexShape& b, vec3 direction) {
+		if (dot(direction, direction) > FLT_EPSILON) return direction;
+
+		direction = b.position - a.position;
+		if (dot(direction, direction) > FLT_EPSILON) return direction;
+
+		return vec3(1, 0, 0);
+	}
+
+
+	struct EPAFace {
+		int vertices[3];
+		vec3 normal;
+		float distance;
+	};
+
+	bool makeFace(const SupportPoint* vertices, int i0, int i1, int i2, EPAFace& face) {
+		vec3 a = vertices[i0].point;
+		vec3 normal = cross(vertices[i1].point - a, vertices[i2].point - a);
+
+		float length = std::sqrt(dot(normal, normal));
+		if (length <= FLT_EPSILON) return false;
+
+		face = { { i0, i1, i2 }, normal / length, dot(normal, a) / length };
+		return true;
+	}
+
+	// Grows a GJK simplex that ended on the origin into a tetrahedron around it, false if A - B is flat there
+	template<typename Support>
+	bool buildTetrahedron(const GJKSimplex& simplex, SupportPoint vertices[4], Support support) {
+		int count = simplex.count;
+		for (int i = 0; i < count; i++) {
+			vertices[i] = { simplex.points[i], simplex.supportA[i], simplex.supportB[i] };
+		}
+
+		static const vec3 axes[6] = { vec3(1, 0, 0), vec3(-1, 0, 0), vec3(0, 1, 0), vec3(0, -1, 0), vec3(0, 0, 1), vec3(0, 0, -1) };
+
+		while (count < 4) {
+			vec3 directions[6];
+			int directionCount = 0;
+
+			if (count == 1) {
+				for (vec3 axis : axes) directions[directionCount++] = axis;
+			}
+			else if (count == 2) {
+				vec3 line = vertices[1].point - vertices[0].point;
+				vec3 axis = std::abs(line.x) < std::abs(line.y) ? vec3(1, 0, 0) : vec3(0, 1, 0);
+				vec3 side1 = cross(line, axis);
+				vec3 side2 = cross(line, side1);
+
+				directions[directionCount++] = side1;
+				directions[directionCount++] = -side1;
+				directions[directionCount++] = side2;
+				directions[directionCount++] = -side2;
+			}
+			else {
+				vec3 normal = cross(vertices[1].point - vertices[0].point, vertices[2].point - vertices[0].point);
+				directions[directionCount++] = normal;
+				directions[directionCount++] = -normal;
+			}
+
+			bool added = false;
+			for (int i = 0; i < directionCount && !added; i++) {
+				SupportPoint candidate = support(directions[i]);
+
+				// has to add a dimension, not just another point on the same line or plane
+				float spread = 0.f;
+				if (count == 1) {
+					vec3 offset = candidate.point - vertices[0].point;
+					spread = dot(offset, offset);
+				}
+				else if (count == 2) {
+					vec3 offset = cross(vertices[1].point - vertices[0].point, candidate.point - vertices[0].point);
+					spread = dot(offset, offset);
+				}
+				else {
+					vec3 normal = cross(vertices[1].point - vertices[0].point, vertices[2].point - vertices[0].point);
+					spread = std::abs(dot(normal, candidate.point - vertices[0].point));
+				}
+
+				if (spread > 1e-10f) {
+					vertices[count++] = candidate;
+					added = true;
+				}
+			}
+
+			if (!added) return false;
+		}
+
+		return true;
+	}
+}
+
+
+GJKResult GJK::distance(const ConvexShape& a, const ConvexShape& b, vec3 direction, float maxDistance) {
+	auto support = [&a, &b](vec3 d) {
+		vec3 pointA = a.supportCore(d);
+		vec3 pointB = b.supportCore(-d);
+		return SupportPoint{ pointA - pointB, pointA, pointB };
+	};
+
+	GJKSimplex simplex;
+	return runGJK(support, getStartDirection(a, b, direction), maxDistance, simplex);
+}
+
+bool GJK::penetration(const ConvexShape& a, const ConvexShape& b, vec3 direction, PenetrationResult& result) {
+	auto support = [&a, &b](vec3 d) {
+		vec3 pointA = a.support(d);
+		vec3 pointB = b.support(-d);
+		return SupportPoint{ pointA - pointB, pointA, pointB };
+	};
+
+	// GJK on the whole shapes gives a simplex around (or touching) the origin to start from
+	GJKSimplex simplex;
+	GJKResult overlap = runGJK(support, getStartDirection(a, b, direction), 0.f, simplex);
+	if (!overlap.overlapping) return false;
+
+	SupportPoint vertices[EPA_MAX_VERTICES];
+	if (!buildTetrahedron(simplex, vertices, support)) return false;
+	int vertexCount = 4;
+
+	EPAFace faces[EPA_MAX_FACES];
+	int faceCount = 0;
+
+	static const int tetrahedron[4][3] = { { 0, 1, 2 }, { 0, 3, 1 }, { 0, 2, 3 }, { 1, 3, 2 } };
+	vec3 centre = (vertices[0].point + vertices[1].point + vertices[2].point + vertices[3].point) * 0.25f;
+
+	for (const int* indices : tetrahedron) {
+		EPAFace face;
+		if (!makeFace(vertices, indices[0], indices[1], indices[2], face)) return false;
+
+		// wind every face outwards, new faces copy the winding of the ones they replace
+		if (dot(face.normal, centre - vertices[indices[0]].point) > 0.f) {
+			makeFace(vertices, indices[0], indices[2], indices[1], face);
+		}
+		faces[faceCount++] = face;
+	}
+
+	int closest = 0;
+	for (int iteration = 0; iteration < EPA_MAX_ITERATIONS; iteration++) {
+		closest = 0;
+		for (int i = 1; i < faceCount; i++) {
+			if (faces[i].distance < faces[closest].distance) closest = i;
+		}
+
+		EPAFace face = faces[closest];
+		SupportPoint w = support(face.normal);
+
+		// the polytope can't be pushed out any further along this face
+		if (dot(w.point, face.normal) - face.distance < EPA_TOLERANCE) break;
+		if (vertexCount == EPA_MAX_VERTICES) break;
+
+		int newVertex = vertexCount;
+		vertices[vertexCount++] = w;
+
+		// Faces that can see the new point go, the edges they leave open (the horizon) get joined to it
+		int horizon[EPA_MAX_FACES * 3][2];
+		int horizonCount = 0;
+
+		for (int i = 0; i < faceCount; i++) {
+			if (dot(faces[i].normal, w.point - vertices[faces[i].vertices[0]].point) <= 0.f) continue;
+
+			for (int e = 0; e < 3; e++) {
+				int from = faces[i].vertices[e];
+				int to = faces[i].vertices[(e + 1) % 3];
+
+				// an edge shared by two removed faces isn't on the horizon
+				bool shared = false;
+				for (int h = 0; h < horizonCount; h++) {
+					if (horizon[h][0] == to && horizon[h][1] == from) {
+						horizon[h][0] = horizon[--horizonCount][0];
+						horizon[h][1] = horizon[horizonCount][1];
+						shared = true;
+						break;
+					}
+				}
+
+				if (!shared) {
+					horizon[horizonCount][0] = from;
+					horizon[horizonCount][1] = to;
+					horizonCount++;
+				}
+			}
+
+			faces[i--] = faces[--faceCount];
+		}
+
+		if (faceCount + horizonCount > EPA_MAX_FACES) {
+			// out of room, the face found last is as good as it gets
+			faces[faceCount++] = face;
+			closest = faceCount - 1;
+			break;
+		}
+
+		for (int h = 0; h < horizonCount; h++) {
+			EPAFace newFace;
+			if (makeFace(vertices, horizon[h][0], horizon[h][1], newVertex, newFace)) {
+				faces[faceCount++] = newFace;
+			}
+		}
+
+		if (faceCount == 0) return false;
+	}
+
+	closest = 0;
+	for (int i = 1; i < faceCount; i++) {
+		if (faces[i].distance < faces[closest].distance) closest = i;
+	}
+	const EPAFace& face = faces[closest];
+
+	// Barycentric weights of the origin projected onto the closest face
+	const SupportPoint& p0 = vertices[face.vertices[0]];
+	const SupportPoint& p1 = vertices[face.vertices[1]];
+	const SupportPoint& p2 = vertices[face.vertices[2]];
+
+	vec3 projected = face.normal * face.distance;
+	vec3 edge1 = p1.point - p0.point;
+	vec3 edge2 = p2.point - p0.point;
+	vec3 offset = projected - p0.point;
+
+	float d11 = dot(edge1, edge1);
+	float d12 = dot(edge1, edge2);
+	float d22 = dot(edge2, edge2);
+	float d31 = dot(offset, edge1);
+	float d32 = dot(offset, edge2);
+	float denominator = d11 * d22 - d12 * d12;
+
+	float v = 0.f;
+	float w = 0.f;
+	if (denominator > FLT_EPSILON) {
+		v = (d22 * d31 - d12 * d32) / denominator;
+		w = (d11 * d32 - d12 * d31) / denominator;
+	}
+	float u = 1.f - v - w;
+
+	result.normal = face.normal;
+	result.depth = std::max(face.distance, 0.f);
+	result.pointA = p0.a * u + p1.a * v + p2.a * w;
+	result.pointB = p0.b * u + p1.b * v + p2.b * w;
+	return true;
+}
+
+bool GJK::cast(const ConvexShape& moving, vec3 direction, const ConvexShape& shape, float maxDistance, float& distance, vec3& normal, vec3 spin) {
+	float margins = moving.margin + shape.margin;
+	// turning brings none of its points closer by more than this for each unit it travels
+	float spinApproach = length(spin) * moving.getOuterRadius();
+
+	float travelled = 0.f;
+	vec3 guess = direction;
+	vec3 toShape = direction;
+
+	for (int i = 0; i < CAST_MAX_ITERATIONS; i++) {
+		ConvexShape swept = moving.advanced(direction, spin, travelled);
+		GJKResult closest = GJK::distance(swept, shape, guess, FLT_MAX);
+
+		// only possible before the first step, advancing never crosses into the core
+		if (closest.overlapping || closest.distance < 1e-6f) {
+			distance = travelled;
+			normal = -direction;
+			return true;
+		}
+
+		toShape = closest.normal;
+		float gap = closest.distance - margins;
+
+		if (gap <= CAST_TOLERANCE) {
+			distance = travelled;
+			normal = -toShape;
+
+			// Without margins the cores are all but touching, so the normal comes from a little way back along the cast
+			if (closest.distance < CAST_NORMAL_DISTANCE) {
+				swept = moving.advanced(direction, spin, travelled - CAST_NORMAL_DISTANCE);
+				GJKResult backedOff = GJK::distance(swept, shape, toShape, FLT_MAX);
+				if (!backedOff.overlapping) normal = -backedOff.normal;
+			}
+			return true;
+		}
+
+		// Heading away from the closest point means heading away from the whole shape, unless it turns into it
+		float approach = dot(direction, toShape) + spinApproach;
+		if (approach <= 1e-6f) return false;
+
+		travelled += gap / approach;
+		if (travelled > maxDistance) return false;
+
+		guess = toShape;
+	}
+
+	// The spin bound can be far from how fast it really closes in, so turning casts run out of steps well short of
+	// grazing ones. Everything up to where it got is clear, stopping there is safer than passing through
+	if (spinApproach > 0.f) {
+		distance = travelled;
+		normal = -toShape;
+		return true;
+	}
+	return false;
+}
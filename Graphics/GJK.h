@@ -0,0 +1,50 @@
+#pragma once
+
+#include "ConvexShape.h"
+
+
+// Up to 4 points of the Minkowski difference A - B, each remembered with the support points it came from
+struct GJKSimplex {
+	vec3 points[4];
+	vec3 supportA[4];
+	vec3 supportB[4];
+	float weights[4]; // barycentric weights of the closest point to the origin
+	int count = 0;
+};
+
+struct GJKResult {
+	bool overlapping = false; // the cores overlap, EPA has to find the depth
+	bool separated = false; // stopped early, the cores are further apart than the 'maxDistance' asked for
+
+	float distance = 0.f; // between the cores
+	vec3 pointA = vec3(0); // closest points on the cores
+	vec3 pointB = vec3(0);
+	vec3 normal = vec3(0); // A to B, where the next query for this pair should start
+
+	int iterations = 0;
+};
+
+struct PenetrationResult {
+	vec3 normal; // A to B
+	float depth;
+	vec3 pointA; // deepest points on each surface
+	vec3 pointB;
+};
+
+
+// Support function based convex queries, any pair of ConvexShapes works without its own routine.
+namespace GJK {
+	// Closest points between the cores of 'a' and 'b'. 'direction' is a guess at the A to B normal, last tick's makes
+	// most queries finish in an iteration or two. Gives up as soon as the cores are known to be over 'maxDistance' apart
+	GJKResult distance(const ConvexShape& a, const ConvexShape& b, vec3 direction, float maxDistance);
+
+	// Depth and normal of two overlapping shapes, margins included, using EPA. False if they don't overlap after all
+	bool penetration(const ConvexShape& a, const ConvexShape& b, vec3 direction, PenetrationResult& result);
+
+	// How far 'moving' can travel along normalised 'direction' before it touches 'shape', margins included, and the
+	// normal of 'shape' there. Conservative advancement, each step moves by the GJK distance over the approach speed
+	// so it never passes through. Spheres cast this way, and rays as spheres of no radius. False if it misses within 'maxDistance'.
+	// 'spin' turns 'moving' by that many radians about its position for each unit it travels, the steps shrink to
+	// cover the distance its furthest point could turn through as well
+	bool cast(const ConvexShape& moving, vec3 direction, const ConvexShape& shape, float maxDistance, float& distance, vec3& normal, vec3 spin = vec3(0));
+}
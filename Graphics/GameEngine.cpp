@@ -7,6 +7,7 @@
 #include "PhysicsSystem.h"
 #include "CollisionSystem.h"
 #include "RenderSystem.h"
+#include "FrameProfiler.h"
 
 #include "ModularFluids.h"
 
@@ -66,6 +67,8 @@ GameEngine::GameEngine() {
 	ecs.addComponent<TransformComponent>(bunny, { vec3(10, 10, 0), eulerToQuat(vec3(0, 0, 0)), vec3(5.0f) });
 	ecs.addComponent<MaterialComponent>(bunny, { MaterialProperties{vec3(1, 1, 0.86f), 0.5f} });
 
+	bunnyEntity = bunny; // gets its hull collider once the mesh is loaded
+
 	ECS::uint sphere = ecs.createEntity();
 	ecs.addComponent<MeshComponent>(sphere, { enumGeometry::SPHERE }); // sphere mesh
 	ecs.addComponent<TransformComponent>(sphere, { vec3(-5, 5, 10), eulerToQuat(vec3(0)), vec3(0.5f) });
@@ -130,6 +133,7 @@ GameEngine::GameEngine() {
 
 
 bool GameEngine::init(int windowWidth, int windowHeight) {
+	PROFILE_THREAD("Main");
 	if (!App3D::init(windowWidth, windowHeight)) return false;
 
 	if(cameraEnabled) glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
@@ -139,10 +143,6 @@ bool GameEngine::init(int windowWidth, int windowHeight) {
 	ModularFluids::LoadLib(glfwGetProcAddress);
 
 
-	PhysicsSystem* physicsSystem = ecs.getSystem<PhysicsSystem>();
-	physicsSystem->generateInertiaTensors(&ecs);
-
-
 	meshes[0].generateCube();
 	meshes[0].textureID = 1;
 	meshes[1].generateSphere();
@@ -152,6 +152,16 @@ bool GameEngine::init(int windowWidth, int windowHeight) {
 	meshes[4].loadFromFile("models/UtilityVan_v002.fbx");
 	meshes[4].textureID = 3;
 
+	// Hulls have to be cooked before init() frees the vertex data, after the first run they come from the cache
+	CollisionSystem* collisionSystem = ecs.getSystem<CollisionSystem>();
+	ConvexHull bunnyHull = ConvexHull::cook(meshes[3].getVertexPositions(), "models/Bunny.hull");
+	if (bunnyHull.isValid()) {
+		ecs.addComponent<CollisionComponent>(bunnyEntity, { enumGeometry::CONVEX_HULL, collisionSystem->addHull(std::move(bunnyHull)) });
+	}
+
+	PhysicsSystem* physicsSystem = ecs.getSystem<PhysicsSystem>();
+	physicsSystem->generateInertiaTensors(&ecs);
+
 	for (int i = 0; i < meshCount; i++) {
 		meshes[i].init();
 	}
@@ -217,11 +227,22 @@ bool GameEngine::init(int windowWidth, int windowHeight) {
 	lightFBO.init();
 
 
+	// Render draws simulated bodies from published transforms, the first frame can come before the first tick
+	physicsEngine.publishTransforms();
+
+	// Physics ticks at its own rate from here on when it has its own thread, render reads its published transforms
+	if (physicsEngineActive && physicsOnOwnThread) {
+		physicsEngine.startAsync();
+	}
+
 	return true;
 }
 
 
 bool GameEngine::update() {
+	PROFILE_FRAME();
+	PROFILE_ZONE("GameEngine::update");
+
 	if (!App3D::update()) return false;
 	if (keyPressed(GLFW_KEY_ESCAPE)) return false;
 
@@ -230,45 +251,79 @@ bool GameEngine::update() {
 	ImGui_ImplGlfw_NewFrame();
 	ImGui::NewFrame();
 
-	//if (showDebug) {
-	//	ImGui::Begin("Debug", &showDebug);
-	//	ImGui::Text("FPS: %.01f", (ImGui::GetIO().Framerate));
-	//	ImGui::Text("%.01f ms", (1000.f / ImGui::GetIO().Framerate));
-
-	//	ImGui::Dummy({ 0.f, 20.f }); // Spacing
-
-	//	ImGui::BeginChild("Physics Engine", {0.f, 130.f}, ImGuiChildFlags_Border);
-	//	ImGui::TextColored({ 0.2f, 0.5f, 0.9f, 1.f }, "Physics Engine");
-	//	ImGui::Checkbox("Is Active", &physicsEngineActive);
-	//	ImGui::InputFloat3("Gravity", (float*)&physicsEngine.gravity);
-	//	ImGui::InputFloat("Elasticity", &physicsEngine.elasticity);
-	//	ImGui::InputFloat("Friction", &physicsEngine.friction);
-	//	ImGui::EndChild();
-
-	//	ImGui::Dummy({ 0.f, 20.f }); // Spacing
-	//	
-	//	ImGui::BeginChild("Fluid Engine", { 0.f, 170.f }, ImGuiChildFlags_Border);
-	//	ImGui::TextColored({ 0.2f, 0.5f, 0.9f, 1.f }, "Fluid Engine");
-	//	bool toggledActive = ImGui::Checkbox("Is Fluid Active", &fluidEngineActive);
-	//	ImGui::Text("Particle count: %i", fluidSim.getParticleCount());
-
-	//	ImGui::Text("Spawn particles");
-	//	ImGui::InputInt(" ", &spawnParticleCount);
-	//	ImGui::SameLine();
-	//	bool spawnParticles = ImGui::Button("Spawn");
-	//	bool clearParticles = ImGui::Button("Clear Particles");
-	//	ImGui::EndChild();
-
-	//	ImGui::End();
-
-	//	if (spawnParticles) {
-	//		fluidSim.spawnRandomParticles(spawnParticleCount);
-	//	}
-
-	//	if (clearParticles) {
-	//		fluidSim.clearParticles();
-	//	}
-	//}
+	if (showDebug) {
+		ImGui::Begin("Debug", &showDebug);
+		ImGui::Text("FPS: %.01f", (ImGui::GetIO().Framerate));
+		ImGui::Text("%.01f ms", (1000.f / ImGui::GetIO().Framerate));
+
+		ImGui::Dummy({ 0.f, 20.f }); // Spacing
+
+		ImGui::BeginChild("Physics Engine", { 0.f, 0.f }, ImGuiChildFlags_Borders | ImGuiChildFlags_AutoResizeY);
+		ImGui::TextColored({ 0.2f, 0.5f, 0.9f, 1.f }, "Physics Engine");
+		bool toggledPhysics = ImGui::Checkbox("Is Active", &physicsEngineActive);
+
+		// Settings belong to the physics thread while it runs
+		ImGui::BeginDisabled(physicsEngine.isAsync());
+		ImGui::InputFloat3("Gravity", (float*)&physicsEngine.gravity);
+		ImGui::InputFloat("Elasticity", &physicsEngine.elasticity);
+		ImGui::InputFloat("Friction", &physicsEngine.friction);
+		ImGui::EndDisabled();
+
+		// Last completed tick, the profiler hands it over safely even when physics is async
+		PhysicsProfile profile = physicsEngine.profiler.getLastTick();
+		ImGui::Text("Tick: %.3f ms", profile.getTotalSeconds() * 1000.0);
+		for (unsigned int i = 0; i < enumPhysicsPhase::COUNT; i++) {
+			ImGui::Text("  %-14s %.3f ms", PhysicsProfiler::getPhaseName((enumPhysicsPhase::type)i), profile.phaseSeconds[i] * 1000.0);
+		}
+		for (unsigned int i = 0; i < enumPhysicsCounter::COUNT; i++) {
+			ImGui::Text("  %-18s %llu", PhysicsProfiler::getCounterName((enumPhysicsCounter::type)i), (unsigned long long)profile.counters[i]);
+		}
+
+		const StepScheduler& scheduler = physicsEngine.getScheduler();
+		ImGui::Text("Ticks %llu, merged %llu, skipped %llu", (unsigned long long)scheduler.getTickCount(), (unsigned long long)scheduler.getMergedSteps(), (unsigned long long)scheduler.getSkippedSteps());
+		if (!PhysicsProfiler::enabled) ImGui::TextDisabled("Built with PHYSICS_PROFILING=0");
+		ImGui::EndChild();
+
+		ImGui::Dummy({ 0.f, 20.f }); // Spacing
+
+		bool saveTrace = ImGui::Button("Save Frame Trace");
+		ImGui::SameLine();
+		if (savedTraceResult >= 0) ImGui::Text(savedTraceResult ? "Wrote %s" : "Couldn't write %s", tracePath);
+		else ImGui::TextDisabled("F12, last %d frames", FRAME_PROFILER_FRAMES);
+
+		ImGui::Dummy({ 0.f, 20.f }); // Spacing
+		
+		ImGui::BeginChild("Fluid Engine", { 0.f, 170.f }, ImGuiChildFlags_Borders);
+		ImGui::TextColored({ 0.2f, 0.5f, 0.9f, 1.f }, "Fluid Engine");
+		ImGui::Checkbox("Is Fluid Active", &fluidEngineActive);
+		ImGui::Text("Particle count: %i", fluidSim.getParticleCount());
+
+		ImGui::Text("Spawn particles");
+		ImGui::InputInt(" ", &spawnParticleCount);
+		ImGui::SameLine();
+		bool spawnParticles = ImGui::Button("Spawn");
+		bool clearParticles = ImGui::Button("Clear Particles");
+		ImGui::EndChild();
+
+		ImGui::End();
+
+		if (toggledPhysics && physicsOnOwnThread) {
+			if (physicsEngineActive) physicsEngine.startAsync();
+			else physicsEngine.stopAsync();
+		}
+
+		if (saveTrace) {
+			savedTraceResult = FrameProfiler::get().writeTrace(tracePath);
+		}
+
+		if (spawnParticles) {
+			fluidSim.spawnRandomParticles(spawnParticleCount);
+		}
+
+		if (clearParticles) {
+			fluidSim.clearParticles();
+		}
+	}
 
 	// Left alt key toggles mouse
 	if (canToggleCamera && keyPressed(GLFW_KEY_LEFT_ALT)) {
@@ -283,10 +338,21 @@ bool GameEngine::update() {
 		canToggleCamera = true;
 	}
 
+	// F12 saves a trace of the frames leading up to now, for catching hitches after the fact
+	if (canSaveTrace && keyPressed(GLFW_KEY_F12)) {
+		canSaveTrace = false;
+		savedTraceResult = FrameProfiler::get().writeTrace(tracePath);
+	}
 
-	float deltaTime = (float)getFrameTime();
+	if (keyReleased(GLFW_KEY_F12)) {
+		canSaveTrace = true;
+	}
 
-	// Avoid taking absurd time steps
+
+	float frameTime = (float)getFrameTime();
+	float deltaTime = frameTime;
+
+	// Avoid taking absurd time steps, physics gets the real frame time since its scheduler drops and counts what it can't fit
 	constexpr float deltaTimeLimit = 1.f;
 	if (deltaTime > deltaTimeLimit) deltaTime = 0.f;
 
@@ -300,7 +366,7 @@ bool GameEngine::update() {
 
 
 	// Physics engine has inbuilt fixed update system
-	if (physicsEngineActive) physicsEngine.update(deltaTime);
+	if (physicsEngineActive && !physicsEngine.isAsync()) physicsEngine.update(frameTime);
 	if (fluidEngineActive) fluidSim.update(deltaTime);
 
 	return true;
@@ -308,6 +374,8 @@ bool GameEngine::update() {
 
 
 void GameEngine::render() {
+	PROFILE_ZONE("GameEngine::render");
+
 	view = genViewMatrix(camera.pos, camera.orientation * vec3(1, 0, 0), worldUp);
 	pvmUBO.buffer.view = view;
 	pvmUBO.buffer.viewInverse = glm::inverse(view);
@@ -320,10 +388,14 @@ void GameEngine::render() {
 	mat4 lightProjectionView = lightProjection * lightView;
 
 	RenderSystem* renderSystem = ecs.getSystem<RenderSystem>();
-	renderSystem->addMeshInstances(ecs, meshes);
+	const TransformSnapshot& physicsTransforms = physicsEngine.acquireTransforms();
+	renderSystem->addMeshInstances(ecs, meshes, &physicsTransforms, physicsEngine.getInterpolationAlpha(physicsTransforms));
 
 
 
+	// Passes only time the CPU side, GPU work shows up wherever the driver makes us wait
+	PROFILE_ZONE_NAMED(pass, "Shadow Pass");
+
 	// Shadow Pass
 	shadowFBO.bind();
 	glViewport(0, 0, 1024, 1024);
@@ -345,6 +417,7 @@ void GameEngine::render() {
 
 
 	// G-Pass
+	PROFILE_NEXT(pass, "G-Pass");
 	gpassFBO.bind();
 	glEnable(GL_CULL_FACE);
 	glCullFace(GL_BACK);
@@ -375,6 +448,7 @@ void GameEngine::render() {
 	}
 	
 	// Fluid particle depth pass
+	PROFILE_NEXT(pass, "Fluid Depth Pass");
 	gpassFBO.sendStencilBuffer(fluidDepthFBO);
 	fluidDepthFBO.bind();
 	glDepthFunc(GL_LESS);
@@ -392,6 +466,7 @@ void GameEngine::render() {
 
 
 	// Generate smoothed fluid depth texture
+	PROFILE_NEXT(pass, "Fluid Smoothing Pass");
 	smoothDepthFBO.bind();
 	glDisable(GL_DEPTH_TEST);
 
@@ -411,6 +486,7 @@ void GameEngine::render() {
 
 
 	// Raymarch Particles
+	PROFILE_NEXT(pass, "Fluid Raymarch Pass");
 	fluidDepthFBO.sendStencilBuffer(gpassFBO);
 	gpassFBO.bind();
 	glDepthFunc(GL_LESS);
@@ -431,6 +507,7 @@ void GameEngine::render() {
 
 
 	// Light Pass
+	PROFILE_NEXT(pass, "Light Pass");
 	lightFBO.bind();
 	glEnable(GL_BLEND);
 	glBlendFunc(GL_ONE, GL_ONE);
@@ -458,6 +535,7 @@ void GameEngine::render() {
 	glDrawArrays(GL_TRIANGLES, 0, 3);
 
 	// Point Light Pass (Reusing same diffuse and specular color buffers)
+	PROFILE_NEXT(pass, "Point Light Pass");
 	glEnable(GL_DEPTH_TEST);
 	glDepthFunc(GL_GEQUAL);
 	glDepthMask(GL_FALSE);
@@ -485,6 +563,7 @@ void GameEngine::render() {
 
 
 	// Composite Pass
+	PROFILE_NEXT(pass, "Composite Pass");
 	gpassFBO.sendStencilBuffer(0);
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
@@ -515,16 +594,20 @@ void GameEngine::render() {
 	glDisable(GL_STENCIL_TEST);
 
 	// Render imgui
+	PROFILE_NEXT(pass, "ImGui");
 	ImGui::Render();
 	ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 
 
+	PROFILE_NEXT(pass, "Swap Buffers");
 	glfwSwapBuffers(window);
 	glfwPollEvents();
 }
 
 void GameEngine::shutdown() {
 	// Can add shutdown code here
+	physicsEngine.stopAsync();
+
 	ImGui_ImplOpenGL3_Shutdown();
 	ImGui_ImplGlfw_Shutdown();
 	ImGui::DestroyContext();
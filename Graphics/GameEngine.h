@@ -26,13 +26,21 @@ protected:
 	// Imgui debug variables
 	bool showDebug = true;
 	bool physicsEngineActive = true;
+	// Opt in, physics ticks at its own rate and render only sees the transforms it publishes
+	bool physicsOnOwnThread = false;
 	bool fluidEngineActive = true;
 	int spawnParticleCount = 1000;
 
+	// F12 or the debug panel writes the last few seconds of frames here
+	const char* tracePath = "frame_trace.json";
+	bool canSaveTrace = true;
+	int savedTraceResult = -1; // -1 not tried, 0 failed, 1 written
+
 
 	ECS::ECSManager ecs;
 
 	ECS::uint vanEntity;
+	ECS::uint bunnyEntity;
 
 	vec3 ambientLighting;
 	vec3 lightColor;
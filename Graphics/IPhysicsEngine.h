@@ -1,22 +1,62 @@
 #pragma once
 
 #include "ECS.h"
+#include "PhysicsProfiler.h"
 #include "glm/glm/ext.hpp"
 
 
+namespace enumSolverBackend {
+	enum type : unsigned int {
+		SCALAR, // PhysicsSolver, one contact at a time
+		SIMD_BATCHED, // BatchedSolver with SSE/AVX2 lanes, packing costs as much as the lanes save until there are hundreds of contacts
+		SIMD_BATCHED_SCALAR, // BatchedSolver with plain loops, same results as SIMD_BATCHED
+		PARALLEL_COLOURED, // PhysicsSolver with each constraint colour split across the thread pool
+		PARALLEL_ISLANDS // PhysicsSolver with each island solved as its own job, large islands split by colour
+	};
+}
+
+namespace enumStepMode {
+	enum type : unsigned int {
+		ITERATIONS, // position pass, then 'iterations' velocity iterations over the whole step
+		SUBSTEPS // 'substeps' short steps of one velocity iteration and position integration each, then a relax iteration
+	};
+}
+
+
 struct IPhysicsEngine {
 	ECS::ECSManager* ecs;
 
 	glm::vec3 gravity = glm::vec3(0);
 
 	int iterations = 1;
+	bool warmStarting = false;
+	enumSolverBackend::type solverBackend = enumSolverBackend::SCALAR;
+
+	// Substepping always runs on PhysicsSolver's scalar loops, solverBackend only picks how iterations are run
+	enumStepMode::type stepMode = enumStepMode::ITERATIONS;
+	int substeps = 4;
 
 	float biasSlop = 0.f;
 	float biasFactor = 0.f;
 
+	// Contacts are made this far before shapes touch, so the velocity solve stops bodies at the surface
+	// instead of letting them sink in for the position pass to push back out. 0 waits until they overlap
+	float speculativeMargin = 0.f;
+	// Rounds of the position pass per tick, -1 runs one per solver iteration
+	int positionIterations = -1;
+
 	float elasticity = 0.f;
 	float friction = 0.f;
 
+	// Islands whose bodies all stay under both speeds for 'sleepTicks' ticks go to sleep
+	bool allowSleeping = false;
+	float sleepLinearVelocity = 0.f;
+	float sleepAngularVelocity = 0.f;
+	int sleepTicks = 0;
+
+	// Phase timings and counters for each tick, collision detection records into it too
+	PhysicsProfiler profiler;
+
 	virtual void addCollisionECS(struct CollisionECS collision) = 0;
 	virtual void clearCollisions() = 0;
 };
\ No newline at end of file
@@ -0,0 +1,243 @@
+#pragma once
+
+#include <climits>
+#include <algorithm>
+#include <vector>
+
+#include "ECS.h"
+#include "ECSComponents.h"
+#include "IPhysicsEngine.h"
+#include "Collision.h"
+#include "SolverBody.h"
+
+
+// Contiguous run of contacts that only touch one island's bodies
+struct IslandRange {
+	int begin;
+	int end;
+};
+
+
+// Groups awake bodies into islands joined by contacts (union-find) and puts whole islands to sleep
+// once every body in them has been resting for long enough.
+// Static entities never join islands, so bodies resting on the floor still form separate islands.
+class IslandManager {
+private:
+	// union-find parent per entity, only meaningful for awake bodies with physics
+	ECS::uint parent[MAX_ENTITIES];
+
+	// lowest rest tick count among each island's bodies, indexed by root
+	int islandRestTicks[MAX_ENTITIES];
+
+	// root of the island a sleeping body went to sleep with, its island-mates wake with it
+	ECS::uint sleepIsland[MAX_ENTITIES];
+
+	int islandCount = 0;
+	int sleepingCount = 0;
+
+	// island slot per root while grouping contacts
+	int rootToRange[MAX_ENTITIES];
+	std::vector<CollisionECS> sortedContacts;
+	std::vector<int> contactIslands;
+
+public:
+	IslandManager() {
+		for (int i = 0; i < MAX_ENTITIES; i++) {
+			parent[i] = (ECS::uint)i;
+			sleepIsland[i] = (ECS::uint)i;
+		}
+	}
+
+	// Wakes the island of any sleeping body that picked up a contact this tick.
+	// Contacts only get generated when at least one side is awake, so any sleeper here was touched.
+	void wakeTouched(ECS::ECSManager* ecs, const ECS::System& physicsSystem, const CollisionECS* collisions, int count) {
+		if (sleepingCount == 0) return;
+
+		for (int i = 0; i < count; i++) {
+			wakeIfAsleep(ecs, physicsSystem, collisions[i].entityA);
+			wakeIfAsleep(ecs, physicsSystem, collisions[i].entityB);
+		}
+	}
+
+	// Unions every pair of awake bodies sharing a contact
+	void build(ECS::ECSManager* ecs, const ECS::System& physicsSystem, const CollisionECS* collisions, int count) {
+		for (int i = 0; i < physicsSystem.entityCount; i++) {
+			ECS::uint entity = physicsSystem.entities[i];
+			parent[entity] = entity;
+		}
+
+		for (int i = 0; i < count; i++) {
+			ECS::uint entityA = collisions[i].entityA;
+			ECS::uint entityB = collisions[i].entityB;
+
+			if (!isAwakeBody(ecs, entityA) || !isAwakeBody(ecs, entityB)) continue;
+
+			ECS::uint rootA = find(entityA);
+			ECS::uint rootB = find(entityB);
+			if (rootA != rootB) {
+				parent[rootB] = rootA;
+			}
+		}
+	}
+
+	// Reorders contacts so every island's contacts sit next to each other and writes their ranges.
+	// Contacts need solver bodies assigned, any with the static body on both sides are moved to the end.
+	// Returns how many contacts belong to an island.
+	int groupContacts(CollisionECS* collisions, int count, std::vector<IslandRange>& ranges) {
+		ranges.clear();
+		contactIslands.resize(count);
+
+		// root per contact first, so every root's slot can be reset before ranges get handed out
+		for (int i = 0; i < count; i++) {
+			const CollisionECS& collision = collisions[i];
+
+			int root = -1;
+			if (collision.bodyA != SolverBodyCache::staticBody) root = (int)find(collision.entityA);
+			else if (collision.bodyB != SolverBodyCache::staticBody) root = (int)find(collision.entityB);
+
+			contactIslands[i] = root;
+			if (root >= 0) rootToRange[root] = -1;
+		}
+
+		// contact counts per island, stored in 'end' for now
+		for (int i = 0; i < count; i++) {
+			int root = contactIslands[i];
+			if (root < 0) continue;
+
+			if (rootToRange[root] < 0) {
+				rootToRange[root] = (int)ranges.size();
+				ranges.push_back({ 0, 0 });
+			}
+
+			contactIslands[i] = rootToRange[root];
+			ranges[rootToRange[root]].end++;
+		}
+
+		// counts to offsets
+		int offset = 0;
+		for (IslandRange& range : ranges) {
+			int size = range.end;
+			range.begin = offset;
+			range.end = offset;
+			offset += size;
+		}
+		int islandContacts = offset;
+
+		sortedContacts.resize(count);
+		int unsolvable = islandContacts;
+		for (int i = 0; i < count; i++) {
+			int island = contactIslands[i];
+			if (island < 0) sortedContacts[unsolvable++] = collisions[i];
+			else sortedContacts[ranges[island].end++] = collisions[i];
+		}
+
+		std::copy(sortedContacts.begin(), sortedContacts.end(), collisions);
+		return islandContacts;
+	}
+
+	// Counts rest ticks per body and sleeps islands whose bodies have all been resting for 'sleepTicks'.
+	// Expects build() to have run this tick.
+	void updateSleep(ECS::ECSManager* ecs, const ECS::System& physicsSystem, const IPhysicsEngine& settings) {
+		if (!settings.allowSleeping) {
+			wakeAll(ecs, physicsSystem);
+			return;
+		}
+
+		float linearSqr = settings.sleepLinearVelocity * settings.sleepLinearVelocity;
+		float angularSqr = settings.sleepAngularVelocity * settings.sleepAngularVelocity;
+
+		for (int i = 0; i < physicsSystem.entityCount; i++) {
+			ECS::uint entity = physicsSystem.entities[i];
+			islandRestTicks[entity] = INT_MAX;
+		}
+
+		islandCount = 0;
+		for (int i = 0; i < physicsSystem.entityCount; i++) {
+			ECS::uint entity = physicsSystem.entities[i];
+			PhysicsComponent& physics = ecs->getComponent<PhysicsComponent>(entity);
+			if (physics.isAsleep) continue;
+
+			bool resting = dot(physics.vel, physics.vel) < linearSqr && dot(physics.angVel, physics.angVel) < angularSqr;
+			physics.restTicks = resting ? physics.restTicks + 1 : 0;
+
+			ECS::uint root = find(entity);
+			if (root == entity) islandCount++;
+
+			islandRestTicks[root] = std::min(islandRestTicks[root], physics.restTicks);
+		}
+
+		for (int i = 0; i < physicsSystem.entityCount; i++) {
+			ECS::uint entity = physicsSystem.entities[i];
+			PhysicsComponent& physics = ecs->getComponent<PhysicsComponent>(entity);
+			if (physics.isAsleep) continue;
+
+			ECS::uint root = find(entity);
+			if (islandRestTicks[root] < settings.sleepTicks) continue;
+
+			physics.isAsleep = true;
+			physics.vel = vec3(0);
+			physics.angVel = vec3(0);
+			physics.acc = vec3(0);
+			physics.angAcc = vec3(0);
+			sleepIsland[entity] = root;
+			sleepingCount++;
+		}
+	}
+
+	// Wakes 'entity' along with every body that went to sleep in the same island
+	void wakeIsland(ECS::ECSManager* ecs, const ECS::System& physicsSystem, ECS::uint entity) {
+		ECS::uint island = sleepIsland[entity];
+
+		for (int i = 0; i < physicsSystem.entityCount; i++) {
+			ECS::uint other = physicsSystem.entities[i];
+			PhysicsComponent& physics = ecs->getComponent<PhysicsComponent>(other);
+
+			if (physics.isAsleep && sleepIsland[other] == island) {
+				physics.isAsleep = false;
+				physics.restTicks = 0;
+				sleepIsland[other] = other;
+				sleepingCount--;
+			}
+		}
+	}
+
+	void wakeAll(ECS::ECSManager* ecs, const ECS::System& physicsSystem) {
+		if (sleepingCount == 0) return;
+
+		for (int i = 0; i < physicsSystem.entityCount; i++) {
+			ECS::uint entity = physicsSystem.entities[i];
+			PhysicsComponent& physics = ecs->getComponent<PhysicsComponent>(entity);
+			physics.isAsleep = false;
+			physics.restTicks = 0;
+			sleepIsland[entity] = entity;
+		}
+		sleepingCount = 0;
+	}
+
+	// Islands of awake bodies found by the last updateSleep
+	int getIslandCount() const { return islandCount; }
+	int getSleepingCount() const { return sleepingCount; }
+
+	// Root body of an awake body's island
+	ECS::uint getIsland(ECS::uint entity) { return find(entity); }
+
+private:
+	ECS::uint find(ECS::uint entity) {
+		while (parent[entity] != entity) {
+			parent[entity] = parent[parent[entity]]; // path halving
+			entity = parent[entity];
+		}
+		return entity;
+	}
+
+	static bool isAwakeBody(ECS::ECSManager* ecs, ECS::uint entity) {
+		return ecs->hasComponent<PhysicsComponent>(entity) && !ecs->getComponent<PhysicsComponent>(entity).isAsleep;
+	}
+
+	void wakeIfAsleep(ECS::ECSManager* ecs, const ECS::System& physicsSystem, ECS::uint entity) {
+		if (!ecs->hasComponent<PhysicsComponent>(entity)) return;
+		if (ecs->getComponent<PhysicsComponent>(entity).isAsleep) {
+			wakeIsland(ecs, physicsSystem, entity);
+		}
+	}
+};
@@ -19,6 +19,8 @@ bool Mesh::init() {
 
 	delete[] vertexBuffer;
 	delete[] indexBuffer;
+	vertexBuffer = nullptr;
+	indexBuffer = nullptr;
 
 	glGenBuffers(1, &instanceVBO);
 	glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
@@ -123,6 +125,23 @@ void Mesh::loadFromFile(const char* name) {
 	std::memcpy(&indexBuffer[0], indices.data(), indices.size() * sizeof(unsigned int));
 }
 
+std::vector<vec3> Mesh::getVertexPositions() const {
+	assert(vertexBuffer != nullptr && "Vertex data is freed by init()");
+
+	std::vector<vec3> positions(vertexCount);
+	for (unsigned int i = 0; i < vertexCount; i++) {
+		positions[i] = vertexBuffer[i].position;
+	}
+
+	return positions;
+}
+
+std::vector<unsigned int> Mesh::getIndices() const {
+	assert(indexBuffer != nullptr && "Index data is freed by init()");
+
+	return std::vector<unsigned int>(indexBuffer, indexBuffer + indexCount);
+}
+
 void Mesh::generatePlane() {
 	assert(vertexBuffer == nullptr && indexBuffer == nullptr);
 
@@ -5,6 +5,7 @@
 #include <glm/glm/glm.hpp>
 #include <glm/glm/ext.hpp>
 #include <glm/glm/fwd.hpp>
+#include <vector>
 
 #include "MaterialProperties.h"
 
@@ -72,6 +73,10 @@ public:
 
 	void loadFromFile(const char* name);
 
+	// Vertex data for building colliders, only there between loading and init()
+	std::vector<vec3> getVertexPositions() const;
+	std::vector<unsigned int> getIndices() const;
+
 	// primitive shape meshes
 	void generateCube();
 	void generateSphere();
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+#include "ECS.h"
+#include "glmAddon.h"
+
+
+// Narrowphase state carried between ticks for each pair that asks for it. A pair keeps its state for as long as
+// it's tested every tick, so the cache only grows with the pairs actually being tested.
+// One open addressing table, each slot stamped with the last tick its pair was fetched. Pairs that missed a tick
+// are stale, their slots get reused by new pairs and dropped whenever the table is rebuilt.
+class PairCache {
+public:
+	static constexpr unsigned char noAxis = 0xFF;
+
+	struct Entry {
+		std::uint32_t key;
+
+		// Box-box axis that last separated the pair, or their shallowest one if they touched
+		unsigned char separatingAxis = noAxis;
+		// Last GJK normal, where the next query starts searching from. Zero when there isn't one
+		vec3 convexDirection = vec3(0);
+	};
+
+private:
+	static constexpr std::uint32_t emptyKey = UINT32_MAX;
+	// left behind by remove(), probing carries on past it
+	static constexpr std::uint32_t removedKey = UINT32_MAX - 1;
+
+	struct Slot {
+		Entry entry = { emptyKey };
+		std::uint32_t lastTick = 0;
+	};
+
+	std::vector<Slot> slots = std::vector<Slot>(16);
+	// slots that aren't empty, stale and removed ones included
+	int usedCount = 0;
+	std::uint32_t tick = 0;
+
+public:
+	// Either order gives the same key
+	static std::uint32_t makeKey(ECS::uint entityA, ECS::uint entityB) {
+		return ((std::uint32_t)std::min(entityA, entityB) << 16) | std::max(entityA, entityB);
+	}
+
+	// Pairs that aren't fetched this tick lose their state
+	void beginTick() { tick++; }
+
+	// This tick's state for the pair, carried over if it was fetched last tick.
+	// Each pair should only be fetched once a tick, the reference stays valid until the next fetch
+	Entry& fetch(std::uint32_t key) {
+		// tables are never more than half full
+		if ((size_t)(usedCount + 1) * 2 > slots.size()) rebuild();
+
+		size_t mask = slots.size() - 1;
+		size_t reusable = SIZE_MAX;
+
+		for (size_t slot = hash(key, slots.size());; slot = (slot + 1) & mask) {
+			Slot& current = slots[slot];
+
+			if (current.entry.key == key) {
+				if (isStale(current)) current.entry = { key };
+				current.lastTick = tick;
+				return current.entry;
+			}
+
+			if (current.entry.key == emptyKey) {
+				if (reusable == SIZE_MAX) {
+					reusable = slot;
+					usedCount++;
+				}
+				break;
+			}
+
+			// the pair could still be further along, only the first one is worth remembering
+			if (reusable == SIZE_MAX && (current.entry.key == removedKey || isStale(current))) reusable = slot;
+		}
+
+		slots[reusable] = { { key }, tick };
+		return slots[reusable].entry;
+	}
+
+	// The ID can be handed out again, its pairs shouldn't carry over to whoever gets it
+	void remove(ECS::uint entityID) {
+		for (Slot& slot : slots) {
+			std::uint32_t key = slot.entry.key;
+			if (key >= removedKey) continue;
+			if ((key >> 16) == entityID || (key & 0xFFFF) == entityID) slot.entry.key = removedKey;
+		}
+	}
+
+private:
+	// fetched neither this tick nor last
+	bool isStale(const Slot& slot) const { return slot.lastTick + 1 < tick; }
+
+	// Power of two at least twice 'count'
+	static size_t getCapacity(int count) {
+		size_t capacity = 16;
+		while (capacity < (size_t)count * 2) capacity *= 2;
+		return capacity;
+	}
+
+	// Keeps only the pairs that can still carry over, with room for as many again before the next rebuild
+	void rebuild() {
+		std::vector<Slot> old = std::move(slots);
+
+		int keptCount = 0;
+		for (const Slot& slot : old) {
+			if (slot.entry.key < removedKey && !isStale(slot)) keptCount++;
+		}
+
+		slots.assign(getCapacity(keptCount * 2 + 1), Slot{});
+		size_t mask = slots.size() - 1;
+
+		for (const Slot& slot : old) {
+			if (slot.entry.key >= removedKey || isStale(slot)) continue;
+
+			size_t index = hash(slot.entry.key, slots.size());
+			while (slots[index].entry.key != emptyKey) index = (index + 1) & mask;
+			slots[index] = slot;
+		}
+		usedCount = keptCount;
+	}
+
+	static size_t hash(std::uint32_t key, size_t capacity) {
+		// high bits of the product, both entity IDs end up in them
+		return (size_t)(((std::uint64_t)key * 0x9E3779B97F4A7C15ull) >> 32) & (capacity - 1);
+	}
+};
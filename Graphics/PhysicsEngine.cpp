@@ -1,64 +1,532 @@
 #include "PhysicsEngine.h"
 
-#include "GameEngine.h"
 #include "glmAddon.h"
 
 #include "PhysicsSystem.h"
 #include "CollisionSystem.h"
+#include "FrameProfiler.h"
 
+#include <chrono>
+#include <algorithm>
 
 
 void PhysicsEngine::update(float deltaTime) {
-	accumulatedTime += deltaTime;
+	PROFILE_ZONE("PhysicsEngine::update");
+	using clock = std::chrono::steady_clock;
 
-	for (int step = 0; step < maxTicksPerUpdate && accumulatedTime > fixedTimeStep; step++) {
-		tickPhysics();
-		accumulatedTime -= fixedTimeStep;
+	StepScheduler::Plan plan = scheduler.plan(deltaTime, fixedTimeStep, iterations);
+
+	int stepsLeft = plan.steps;
+	for (int tick = 0; tick < plan.ticks; tick++) {
+		// Steps are spread evenly so merged ticks stay as short as they can
+		int ticksLeft = plan.ticks - tick;
+		int steps = (stepsLeft + ticksLeft - 1) / ticksLeft;
+
+		clock::time_point start = clock::now();
+		tickPhysics(steps * fixedTimeStep, plan.iterations);
+		float seconds = std::chrono::duration<float>(clock::now() - start).count();
+
+		scheduler.recordTick(steps, fixedTimeStep, seconds, plan.iterations, iterations);
+		stepsLeft -= steps;
+	}
+}
+
+float PhysicsEngine::getInterpolationAlpha(const TransformSnapshot& snapshot) const {
+	float leftover = isAsync()
+		? std::chrono::duration<float>(std::chrono::steady_clock::now() - snapshot.publishTime).count()
+		: scheduler.getPendingTime();
+
+	return std::clamp(leftover / snapshot.timeStep, 0.f, 1.f);
+}
+
+void PhysicsEngine::publishTransforms() {
+	assert(!isAsync() && "the physics thread publishes its own snapshots");
+
+	PhysicsSystem* physicsSystem = ecs->getSystem<PhysicsSystem>();
+	TransformSnapshot& snapshot = transformSnapshots.getWriteSnapshot();
+	snapshot.capturePrevious(ecs, *physicsSystem);
+	snapshot.capture(ecs, *physicsSystem, tickCount, fixedTimeStep);
+	transformSnapshots.publish();
+}
+
+void PhysicsEngine::startAsync() {
+	if (isAsync()) return;
+
+	// From here on the reader can't look at the live components, so it needs every body in a snapshot before the first tick
+	publishTransforms();
+
+	asyncRunning = true;
+	asyncThread = std::thread([this]() { runAsync(); });
+}
+
+void PhysicsEngine::stopAsync() {
+	if (!isAsync()) return;
+
+	asyncRunning = false;
+	asyncThread.join();
+}
+
+void PhysicsEngine::runAsync() {
+	PROFILE_THREAD("Physics");
+	using clock = std::chrono::steady_clock;
+	clock::time_point lastTime = clock::now();
+
+	while (asyncRunning.load()) {
+		clock::time_point now = clock::now();
+		float deltaTime = std::chrono::duration<float>(now - lastTime).count();
+		lastTime = now;
+
+		update(deltaTime);
+
+		// Sleeps until the next tick is due
+		float untilNextTick = fixedTimeStep - scheduler.getPendingTime();
+		if (untilNextTick > 0.f) {
+			std::this_thread::sleep_for(std::chrono::duration<float>(untilNextTick));
+		}
+	}
+}
+
+
+template<typename Step>
+void PhysicsEngine::solveColoured(Step step) {
+	// Small colours aren't worth waking threads for
+	const int grainSize = 32;
+
+	for (int c = 0; c < colouring.getColourCount(); c++) {
+		const std::vector<int>& colour = colouring.getColour(c);
+
+		threadPool.parallelFor((int)colour.size(), grainSize, [&](int begin, int end) {
+			for (int i = begin; i < end; i++) {
+				step(colour[i]);
+			}
+		});
+	}
+
+	for (int index : colouring.getOverflow()) {
+		step(index);
+	}
+}
+
+void PhysicsEngine::solveIslands(int contactCount) {
+	// Constraint n is built from collision n, so jobs can fill in their own slots
+	solver.prepareConstraints(contactCount);
+
+	JobCounter counter = 0;
+
+	// Neighbouring small islands are packed into one job so tiny islands don't each pay for a job
+	int batchBegin = 0;
+	int batchEnd = 0;
+	for (const IslandRange& island : islandRanges) {
+		int size = island.end - island.begin;
+		if (size > ISLAND_SPLIT_CONTACTS) continue;
+
+		if (batchEnd != island.begin || batchEnd - batchBegin + size > ISLAND_BATCH_CONTACTS) {
+			if (batchEnd > batchBegin) {
+				threadPool.submit(counter, [this, batchBegin, batchEnd]() { solveIslandRange(batchBegin, batchEnd); });
+			}
+			batchBegin = island.begin;
+		}
+		batchEnd = island.end;
+	}
+
+	if (batchEnd > batchBegin) {
+		threadPool.submit(counter, [this, batchBegin, batchEnd]() { solveIslandRange(batchBegin, batchEnd); });
+	}
+
+	// Large islands are split here while the workers get through the small ones
+	for (const IslandRange& island : islandRanges) {
+		if (island.end - island.begin > ISLAND_SPLIT_CONTACTS) {
+			solveLargeIsland(island.begin, island.end);
+		}
+	}
+
+	threadPool.wait(counter);
+}
+
+void PhysicsEngine::solveIslandRange(int begin, int end) {
+	for (int i = 0; i < tickPositionIterations; i++) {
+		for (int n = begin; n < end; n++) {
+			solver.solvePosition(collisions[n]);
+		}
+	}
+
+	for (int n = begin; n < end; n++) {
+		solver.buildConstraint(collisions[n], n);
+	}
+
+	if (warmStarting) {
+		for (int n = begin; n < end; n++) {
+			solver.warmStart(solver.getConstraint(n));
+		}
+	}
+
+	for (int i = 0; i < tickIterations; i++) {
+		for (int n = begin; n < end; n++) {
+			solver.solveFriction(solver.getConstraint(n));
+		}
+
+		for (int n = begin; n < end; n++) {
+			solver.solveImpulse(solver.getConstraint(n));
+		}
+	}
+
+	for (int n = begin; n < end; n++) {
+		solver.applyRestitution(solver.getConstraint(n));
+	}
+}
+
+void PhysicsEngine::solveLargeIsland(int begin, int end) {
+	// Colours hold collision indices, which double as constraint indices
+	colouring.build(collisions.getData(), begin, end);
+
+	for (int i = 0; i < tickPositionIterations; i++) {
+		solveColoured([this](int index) { solver.solvePosition(collisions[index]); });
+	}
+
+	threadPool.parallelFor(end - begin, ISLAND_BATCH_CONTACTS, [this, begin](int first, int last) {
+		for (int n = begin + first; n < begin + last; n++) {
+			solver.buildConstraint(collisions[n], n);
+		}
+	});
+
+	if (warmStarting) {
+		solveColoured([this](int index) { solver.warmStart(solver.getConstraint(index)); });
+	}
+
+	for (int i = 0; i < tickIterations; i++) {
+		solveColoured([this](int index) { solver.solveFriction(solver.getConstraint(index)); });
+		solveColoured([this](int index) { solver.solveImpulse(solver.getConstraint(index)); });
+	}
+
+	solveColoured([this](int index) { solver.applyRestitution(solver.getConstraint(index)); });
+}
+
+void PhysicsEngine::solveSubsteps(float timeStep, int contactCount) {
+	float substepTime = timeStep / substeps;
+
+	int constraintCount = 0;
+	{
+		PHYSICS_PROFILE_PHASE(profiler, enumPhysicsPhase::CONTACT_SETUP);
+
+		solver.preStep(collisions.getData(), contactCount);
+		constraintCount = solver.getConstraintCount();
+
+		// Cached impulses cover a whole step, each substep starts from its share
+		solver.scaleImpulses(1.f / substeps);
+	}
+
+	{
+		PHYSICS_PROFILE_PHASE(profiler, enumPhysicsPhase::VELOCITY_SOLVE);
+
+		for (int step = 0; step < substeps; step++) {
+			solver.integrateVelocities(gravity, substepTime);
+
+			// Impulses carry over from one substep to the next, so each one starts by reapplying them
+			for (int n = 0; n < constraintCount; n++) {
+				solver.warmStart(solver.getConstraint(n));
+			}
+
+			for (int n = 0; n < constraintCount; n++) {
+				solver.solveFriction(solver.getConstraint(n));
+			}
+
+			for (int n = 0; n < constraintCount; n++) {
+				solver.solveSubstepImpulse(solver.getConstraint(n), substepTime, true);
+			}
+
+			solver.integratePositions(substepTime);
+		}
+
+		// Relax iteration, takes back out the speed pushing contacts apart gave the bodies
+		for (int n = 0; n < constraintCount; n++) {
+			solver.solveFriction(solver.getConstraint(n));
+		}
+
+		for (int n = 0; n < constraintCount; n++) {
+			solver.solveSubstepImpulse(solver.getConstraint(n), substepTime, false);
+		}
 	}
+
+	PHYSICS_PROFILE_PHASE(profiler, enumPhysicsPhase::RESTITUTION);
+	for (int n = 0; n < constraintCount; n++) {
+		solver.applySubstepRestitution(solver.getConstraint(n));
+	}
+
+	solver.scaleImpulses((float)substeps);
 }
 
+bool PhysicsEngine::raycast(vec3 origin, vec3 direction, float maxDistance, RaycastHit& hit) {
+	return prepareQueries()->raycast(ecs, { origin, direction, maxDistance }, hit);
+}
+
+void PhysicsEngine::raycastAll(vec3 origin, vec3 direction, float maxDistance, std::vector<RaycastHit>& hits) {
+	prepareQueries()->raycastAll(ecs, { origin, direction, maxDistance }, hits);
+}
+
+int PhysicsEngine::raycastBatch(const Ray* rays, int rayCount, RaycastHit* hits) {
+	PROFILE_ZONE("PhysicsEngine::raycastBatch");
+	CollisionSystem* collisionSystem = prepareQueries();
+
+	int packetCount = (rayCount + RAYCAST_PACKET_SIZE - 1) / RAYCAST_PACKET_SIZE;
+	std::atomic<int> hitCount = 0;
+
+	threadPool.parallelFor(packetCount, 4, [&](int begin, int end) {
+		int localHits = 0;
+
+		for (int packet = begin; packet < end; packet++) {
+			int first = packet * RAYCAST_PACKET_SIZE;
+			int count = std::min(RAYCAST_PACKET_SIZE, rayCount - first);
+			collisionSystem->raycastPacket(ecs, rays + first, count, hits + first);
+
+			for (int i = first; i < first + count; i++) {
+				if (hits[i].hasHit()) localHits++;
+			}
+		}
+
+		hitCount += localHits;
+	});
+
+	return hitCount;
+}
+
+bool PhysicsEngine::sphereCast(vec3 origin, float radius, vec3 direction, float maxDistance, RaycastHit& hit) {
+	return prepareQueries()->sphereCast(ecs, { origin, direction, maxDistance }, radius, hit);
+}
+
+void PhysicsEngine::overlapAABB(const AABB& bounds, std::vector<ECS::uint>& entities) {
+	prepareQueries()->overlapAABB(ecs, bounds, entities);
+}
+
+CollisionSystem* PhysicsEngine::prepareQueries() {
+	assert(!isAsync() && "scene queries can't run alongside async physics");
+
+	CollisionSystem* collisionSystem = ecs->getSystem<CollisionSystem>();
+
+	// only paid for on ticks that are actually queried
+	if (queryBoundsTick != tickCount) {
+		collisionSystem->updateQueryBounds(ecs);
+		queryBoundsTick = tickCount;
+	}
+
+	return collisionSystem;
+}
+
+void PhysicsEngine::tickPhysics(float timeStep, int solverIterations) {
+	PROFILE_ZONE("PhysicsEngine::tickPhysics");
+	PHYSICS_PROFILE_TICK(profiler);
+
+	tickIterations = solverIterations;
+	tickPositionIterations = positionIterations < 0 ? tickIterations : positionIterations;
+
+	// a substep's single iteration each, and the relax iteration
+	bool substepping = stepMode == enumStepMode::SUBSTEPS && substeps > 0;
+	PHYSICS_PROFILE_COUNT(profiler, enumPhysicsCounter::ITERATIONS, substepping ? substeps + 1 : tickIterations);
 
-void PhysicsEngine::tickPhysics() {
 	PhysicsSystem* physicsSystem = ecs->getSystem<PhysicsSystem>();
 	CollisionSystem* collisionSystem = ecs->getSystem<CollisionSystem>();
 
-	// Kinematic updates and gravity
-	physicsSystem->kinematicInitialUpdate(ecs, fixedTimeStep);
-	physicsSystem->applyGravity(ecs, gravity);
+	{
+		PHYSICS_PROFILE_PHASE(profiler, enumPhysicsPhase::FINISH);
+
+		// Start of the tick is what rendering blends from, and what continuous sweeps follow bodies from
+		transformSnapshots.getWriteSnapshot().capturePrevious(ecs, *physicsSystem);
+		collisionSystem->recordSweepOrigins(ecs);
+	}
+
+	// Substeps integrate the bodies themselves once contacts are known, so collision detection sees them
+	// where the last tick left them and continuous sweeps wait until the substeps have moved them
+	if (!substepping) {
+		{
+			PHYSICS_PROFILE_PHASE(profiler, enumPhysicsPhase::INTEGRATION);
+
+			// Kinematic updates and gravity
+			physicsSystem->kinematicInitialUpdate(ecs, timeStep);
+			physicsSystem->applyGravity(ecs, gravity);
+		}
+
+		PHYSICS_PROFILE_PHASE(profiler, enumPhysicsPhase::BROADPHASE);
+		collisionSystem->sweepContinuousBodies(ecs, this);
+	}
 
-	// Collision detection
+	// Collision detection, times its own broadphase and narrowphase
 	collisionSystem->detectCollisions(ecs, this);
 
-	// Depenetration with pseudo position impulses
-	for (int i = 0; i < iterations; i++) {
-		for (int n = 0; n < collisionCount; n++) {
-			solver.solvePosition(collisionsECS[n]);
+	int collisionCount = collisions.getCount();
+	PHYSICS_PROFILE_COUNT(profiler, enumPhysicsCounter::CONTACTS_GENERATED, collisionCount);
+
+	{
+		PHYSICS_PROFILE_PHASE(profiler, enumPhysicsPhase::CONTACT_SETUP);
+
+		// Contacts that persist from last tick start from their old accumulated impulses
+		if (warmStarting) {
+			contactCache.matchContacts(collisions.getData(), collisionCount);
 		}
+
+		// Sleepers that picked up a contact rejoin the simulation before bodies are gathered
+		islands.wakeTouched(ecs, *physicsSystem, collisions.getData(), collisionCount);
+		islands.build(ecs, *physicsSystem, collisions.getData(), collisionCount);
+
+		// Bodies are read out of the ECS once and contacts refer to them by index from here on
+		solver.buildBodies(*physicsSystem);
+		solver.setTimeStep(timeStep);
+		solver.assignBodies(collisions.getData(), collisionCount);
 	}
 
-	// Solves collisions at velocity level
-	for (int i = 0; i < iterations; i++) {
-		// Applies friction
-		for (int n = 0; n < collisionCount; n++) {
-			solver.solveFriction(collisionsECS[n]);
+	if (substepping) {
+		solveSubsteps(timeStep, collisionCount);
+	}
+	else if (solverBackend == enumSolverBackend::PARALLEL_ISLANDS) {
+		int islandContactCount = 0;
+		{
+			PHYSICS_PROFILE_PHASE(profiler, enumPhysicsPhase::CONTACT_SETUP);
+			islandContactCount = islands.groupContacts(collisions.getData(), collisionCount, islandRanges);
 		}
 
-		// Applies normal impulse
-		for (int n = 0; n < collisionCount; n++) {
-			solver.solveImpulse(collisionsECS[n]);
+		// Islands share no bodies, so each one runs the whole solve on its own.
+		// The passes are interleaved across jobs so it all goes down as velocity solve
+		PHYSICS_PROFILE_PHASE(profiler, enumPhysicsPhase::VELOCITY_SOLVE);
+		solveIslands(islandContactCount);
+	}
+	else {
+		{
+			PHYSICS_PROFILE_PHASE(profiler, enumPhysicsPhase::POSITION_SOLVE);
+
+			// Depenetration with pseudo position impulses, speculative contacts keep most bodies from needing it
+			for (int i = 0; i < tickPositionIterations; i++) {
+				for (int n = 0; n < collisionCount; n++) {
+					solver.solvePosition(collisions[n]);
+				}
+			}
 		}
+
+		int constraintCount = 0;
+		{
+			PHYSICS_PROFILE_PHASE(profiler, enumPhysicsPhase::CONTACT_SETUP);
+
+			// Constraint rows only depend on positions, so they're built once the position pass is done
+			solver.preStep(collisions.getData(), collisionCount);
+			constraintCount = solver.getConstraintCount();
+		}
+
+		if (solverBackend == enumSolverBackend::SCALAR) {
+			{
+				PHYSICS_PROFILE_PHASE(profiler, enumPhysicsPhase::VELOCITY_SOLVE);
+
+				if (warmStarting) {
+					for (int n = 0; n < constraintCount; n++) {
+						solver.warmStart(solver.getConstraint(n));
+					}
+				}
+
+				// Solves collisions at velocity level
+				for (int i = 0; i < tickIterations; i++) {
+					// Applies friction
+					for (int n = 0; n < constraintCount; n++) {
+						solver.solveFriction(solver.getConstraint(n));
+					}
+
+					// Applies normal impulse
+					for (int n = 0; n < constraintCount; n++) {
+						solver.solveImpulse(solver.getConstraint(n));
+					}
+				}
+			}
+
+			// Applies restitution
+			PHYSICS_PROFILE_PHASE(profiler, enumPhysicsPhase::RESTITUTION);
+			for (int i = 0; i < constraintCount; i++) {
+				solver.applyRestitution(solver.getConstraint(i));
+			}
+		}
+		else if (solverBackend == enumSolverBackend::PARALLEL_COLOURED) {
+			// Same steps as above, constraints within a colour don't share bodies so they can run on any thread
+			{
+				PHYSICS_PROFILE_PHASE(profiler, enumPhysicsPhase::CONTACT_SETUP);
+				colouring.build(solver.getConstraints());
+			}
+
+			{
+				PHYSICS_PROFILE_PHASE(profiler, enumPhysicsPhase::VELOCITY_SOLVE);
+
+				if (warmStarting) {
+					solveColoured([this](int index) { solver.warmStart(solver.getConstraint(index)); });
+				}
+
+				for (int i = 0; i < tickIterations; i++) {
+					solveColoured([this](int index) { solver.solveFriction(solver.getConstraint(index)); });
+					solveColoured([this](int index) { solver.solveImpulse(solver.getConstraint(index)); });
+				}
+			}
+
+			PHYSICS_PROFILE_PHASE(profiler, enumPhysicsPhase::RESTITUTION);
+			solveColoured([this](int index) { solver.applyRestitution(solver.getConstraint(index)); });
+		}
+		else {
+			// Same steps as above, a batch of contacts at a time
+			{
+				PHYSICS_PROFILE_PHASE(profiler, enumPhysicsPhase::VELOCITY_SOLVE);
+
+				batchedSolver.setUseIntrinsics(solverBackend == enumSolverBackend::SIMD_BATCHED);
+				batchedSolver.begin(solver.getConstraints(), solver.getBodies());
+
+				if (warmStarting) {
+					batchedSolver.warmStart();
+				}
+
+				for (int i = 0; i < tickIterations; i++) {
+					batchedSolver.solveFriction();
+					batchedSolver.solveImpulse();
+				}
+			}
+
+			{
+				PHYSICS_PROFILE_PHASE(profiler, enumPhysicsPhase::RESTITUTION);
+				batchedSolver.applyRestitution();
+			}
+
+			PHYSICS_PROFILE_PHASE(profiler, enumPhysicsPhase::VELOCITY_SOLVE);
+			batchedSolver.end(solver.getConstraints(), solver.getBodies());
+		}
+	}
+
+	{
+		PHYSICS_PROFILE_PHASE(profiler, enumPhysicsPhase::FINISH);
+
+		solver.storeImpulses(collisions.getData());
+		solver.writeBackBodies();
+
+		// Islands that have come to rest go to sleep
+		islands.updateSleep(ecs, *physicsSystem, *this);
+
+		if (warmStarting) {
+			contactCache.storeContacts(collisions.getData(), collisions.getCount());
+		}
+		else {
+			contactCache.clear();
+		}
+
+		// Clear collision data
+		clearCollisions();
+	}
+
+	if (substepping) {
+		PHYSICS_PROFILE_PHASE(profiler, enumPhysicsPhase::BROADPHASE);
+
+		// The substeps have only just moved the bodies, next tick's contacts pick up whatever this holds back
+		collisionSystem->sweepContinuousBodies(ecs, this);
 	}
+	else {
+		PHYSICS_PROFILE_PHASE(profiler, enumPhysicsPhase::INTEGRATION);
 
-	// Applies restitution
-	for (int i = 0; i < collisionCount; i++) {
-		solver.applyRestitution(collisionsECS[i]);
+		// Velocity-verlet related
+		physicsSystem->kinematicFinalUpdate(ecs, timeStep);
 	}
 
-	// Clear collision data
-	clearCollisions();
+	PHYSICS_PROFILE_PHASE(profiler, enumPhysicsPhase::FINISH);
 
-	// Velocity-verlet related
-	physicsSystem->kinematicFinalUpdate(ecs, fixedTimeStep);
+	tickCount++;
+	transformSnapshots.getWriteSnapshot().capture(ecs, *physicsSystem, tickCount, timeStep);
+	transformSnapshots.publish();
 }
 
 
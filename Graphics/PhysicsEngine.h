@@ -1,50 +1,184 @@
 #pragma once
 
+#include <thread>
+#include <atomic>
+#include <cstdint>
+
 #include "IPhysicsEngine.h"
 #include "PhysicsSolver.h"
+#include "BatchedSolver.h"
+#include "ConstraintColouring.h"
+#include "ThreadPool.h"
+#include "ContactCache.h"
+#include "IslandManager.h"
+#include "ContactArena.h"
+#include "TransformSnapshot.h"
+#include "StepScheduler.h"
 
 #include "Collision.h"
+#include "SceneQuery.h"
+#include "Broadphase.h"
 #include "ECS.h"
 
 
-#define MAX_COLLISIONS 128
+// Starting size of the contact arena, it grows past this as needed
+#define INITIAL_COLLISION_CAPACITY 128
+
+// Small islands are packed into jobs of about this many contacts
+#define ISLAND_BATCH_CONTACTS 64
+// Islands with more contacts than this get coloured and split across threads instead of being one job
+#define ISLAND_SPLIT_CONTACTS 256
+
+
+class CollisionSystem;
 
 
 class PhysicsEngine : public IPhysicsEngine {
 private:
 	PhysicsSolver solver = PhysicsSolver(this);
+	BatchedSolver batchedSolver = BatchedSolver(this);
+
+	ConstraintColouring colouring;
+	ThreadPool threadPool;
+
+	float fixedTimeStep = 0.01f;
+	StepScheduler scheduler;
+
+	// iterations the current tick solves with, the scheduler can lower it from 'iterations'
+	int tickIterations = 1;
+	// rounds of the position pass the current tick runs
+	int tickPositionIterations = 1;
+
+	ContactArena<CollisionECS> collisions = ContactArena<CollisionECS>(INITIAL_COLLISION_CAPACITY);
+
+	ContactCache contactCache;
 
-	const int maxTicksPerUpdate = 5;
-	const float fixedTimeStep = 0.01f;
-	float accumulatedTime = 0.f;
+	IslandManager islands;
+	std::vector<IslandRange> islandRanges;
 
-	int collisionCount = 0;
-	const int maxCollisions = MAX_COLLISIONS;
-	CollisionECS collisionsECS[MAX_COLLISIONS];
+	// Published at the end of every tick for whichever thread renders
+	TransformSnapshotBuffer transformSnapshots;
+	std::uint64_t tickCount = 0;
+
+	std::thread asyncThread;
+	std::atomic<bool> asyncRunning = false;
+
+	// Tick the scene query bounds were last brought up to date for
+	std::uint64_t queryBoundsTick = UINT64_MAX;
 
 public:
 	PhysicsEngine() {
 		gravity = vec3(0, 0, -4.f);
 
 		iterations = 3;
+		warmStarting = true;
 
 		biasSlop = 0.01f;
 		biasFactor = 0.15f;
 
+		speculativeMargin = 0.02f;
+		positionIterations = 1;
+
 		elasticity = 0.4f;
 		friction = 0.55f;
+
+		allowSleeping = true;
+		sleepLinearVelocity = 0.05f;
+		sleepAngularVelocity = 0.05f;
+		sleepTicks = 50;
+	}
+
+	~PhysicsEngine() {
+		stopAsync();
 	}
 
 	void setEntityComponentSystemPtr(ECS::ECSManager* _ecs) {
 		ecs = _ecs;
 	}
 
+	// Runs however many fixed steps the scheduler fits into its budget for 'deltaTime'
 	void update(float deltaTime);
-	void tickPhysics();
+
+	void tickPhysics() { tickPhysics(fixedTimeStep, iterations); }
+	void tickPhysics(float timeStep, int solverIterations);
+
+	// Runs update() on its own thread against the real clock until stopAsync().
+	// While it runs nothing else may touch the ECS entities or components physics uses, or the engine's settings,
+	// other threads should read transforms through acquireTransforms().
+	void startAsync();
+	void stopAsync();
+	bool isAsync() const { return asyncThread.joinable(); }
+
+	// Publishes the transforms as they are now without ticking, both ends of the snapshot the same. Render only draws
+	// simulated entities from snapshots, so this covers bodies added since the last tick. Not while async
+	void publishTransforms();
+
+	// Transforms from the last completed tick. Only one thread may acquire, the reference stays valid until its next call
+	const TransformSnapshot& acquireTransforms() { return transformSnapshots.acquire(); }
+
+	// How far between a snapshot's previous and current transforms to draw, from the time left over after the last tick.
+	// When async that's the time since the snapshot was published, which draws one tick behind but never extrapolates.
+	float getInterpolationAlpha(const TransformSnapshot& snapshot) const;
+
+	// Lower rates trade responsiveness for cost, interpolation hides the steps. Not while async
+	void setFixedTimeStep(float timeStep) { fixedTimeStep = timeStep; }
+	float getFixedTimeStep() const { return fixedTimeStep; }
+
+	// Budget, merging and iteration settings plus overload counters
+	StepScheduler& getScheduler() { return scheduler; }
+	const StepScheduler& getScheduler() const { return scheduler; }
+
+	int getCollisionCount() const { return collisions.getCount(); }
+
+	// Capacity, high-water mark and overflow counters for contact storage
+	const ContactArena<CollisionECS>& getContactArena() const { return collisions; }
+	void resetContactStats() { collisions.resetStats(); }
+	const ContactCache& getContactCache() const { return contactCache; }
+	const BatchedSolver& getBatchedSolver() const { return batchedSolver; }
+	const ConstraintColouring& getColouring() const { return colouring; }
+	const IslandManager& getIslands() const { return islands; }
+	int getThreadCount() const { return threadPool.getThreadCount(); }
+
+	// Scene queries against the colliders as they were after the last tick. Not while async, and one thread at a time,
+	// raycastBatch spreads itself over the thread pool. Directions don't need to be normalised
+
+	// Nearest hit within 'maxDistance'
+	bool raycast(vec3 origin, vec3 direction, float maxDistance, RaycastHit& hit);
+	// Every collider the ray hits, nearest first
+	void raycastAll(vec3 origin, vec3 direction, float maxDistance, std::vector<RaycastHit>& hits);
+	// Nearest hit of each ray, packets of RAYCAST_PACKET_SIZE walk the tree together. Returns how many hit something
+	int raycastBatch(const Ray* rays, int rayCount, RaycastHit* hits);
+	// Nearest collider a sphere of 'radius' moving from 'origin' runs into
+	bool sphereCast(vec3 origin, float radius, vec3 direction, float maxDistance, RaycastHit& hit);
+	// Colliders whose actual shape overlaps 'bounds'
+	void overlapAABB(const AABB& bounds, std::vector<ECS::uint>& entities);
 
 	virtual void addCollisionECS(CollisionECS collision) override {
-		if (collisionCount >= maxCollisions) return;
-		collisionsECS[collisionCount++] = collision;
+		if (collision.depth < 0.f) PHYSICS_PROFILE_COUNT(profiler, enumPhysicsCounter::SPECULATIVE_CONTACTS, 1);
+		collisions.push(collision);
 	}
-	virtual void clearCollisions() override { collisionCount = 0; }
+	virtual void clearCollisions() override { collisions.clear(); }
+
+private:
+	// Runs step(index) on every coloured index a colour at a time, each colour spread over the thread pool
+	template<typename Step>
+	void solveColoured(Step step);
+
+	// Position pass, constraint setup and velocity solve for the first 'contactCount' collisions, which
+	// have to be grouped by island
+	void solveIslands(int contactCount);
+
+	// Whole solve for collisions [begin, end) on this thread
+	void solveIslandRange(int begin, int end);
+
+	// Whole solve for one island's collisions [begin, end) with each step split by colour
+	void solveLargeIsland(int begin, int end);
+
+	// enumStepMode::SUBSTEPS solve for the first 'contactCount' collisions, integrates every awake body as it goes
+	void solveSubsteps(float timeStep, int contactCount);
+
+	void runAsync();
+
+	// Brings the AABB tree up to date with the latest tick if it isn't already
+	CollisionSystem* prepareQueries();
 };
\ No newline at end of file
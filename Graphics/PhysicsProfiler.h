@@ -0,0 +1,208 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <algorithm>
+
+
+// Compile with PHYSICS_PROFILING=0 to strip every timer and counter out of the tick,
+// the profiler then just reports zeros
+#ifndef PHYSICS_PROFILING
+#define PHYSICS_PROFILING 1
+#endif
+
+
+namespace enumPhysicsPhase {
+	enum type : unsigned int {
+		INTEGRATION, // kinematic updates and gravity
+		BROADPHASE, // continuous sweeps, AABBs and candidate pairs
+		NARROWPHASE, // contact generation
+		CONTACT_SETUP, // warm start matching, islands, solver bodies and constraint rows
+		POSITION_SOLVE,
+		VELOCITY_SOLVE, // warm start and iterations, the island backend reports its whole solve here
+		RESTITUTION,
+		FINISH, // write back, sleeping, the contact cache and transform snapshots
+		COUNT,
+		NONE = COUNT
+	};
+}
+
+namespace enumPhysicsCounter {
+	enum type : unsigned int {
+		PAIRS_TESTED, // broadphase pairs sent to narrowphase
+		CONTACTS_GENERATED,
+		SPECULATIVE_CONTACTS, // contacts made before their shapes touched
+		CONTACTS_DROPPED, // manifold points cut by reduction
+		SAT_EARLY_OUTS, // box pairs ruled out by last tick's separating axis alone
+		GJK_ITERATIONS,
+		TRIANGLES_TESTED, // mesh triangles the BVH handed to narrowphase
+		ITERATIONS, // solver iterations run
+		CONTINUOUS_SWEEPS, // continuous bodies fast enough to be swept
+		CONTINUOUS_IMPACTS, // sweeps that hit something and held the body back
+		COUNT
+	};
+}
+
+
+// Time per phase and counts, summed over 'ticks' ticks
+struct PhysicsProfile {
+	double phaseSeconds[enumPhysicsPhase::COUNT] = {};
+	std::uint64_t counters[enumPhysicsCounter::COUNT] = {};
+
+	// highest single tick value of each counter
+	std::uint64_t peakCounters[enumPhysicsCounter::COUNT] = {};
+
+	std::uint64_t ticks = 0;
+
+	double getTotalSeconds() const {
+		double total = 0.0;
+		for (double seconds : phaseSeconds) total += seconds;
+		return total;
+	}
+};
+
+
+// Collects per-phase wall time and counters over a tick.
+// Only the ticking thread records, finished ticks are handed over under a lock so any thread can read them.
+class PhysicsProfiler {
+private:
+	using clock = std::chrono::steady_clock;
+
+	PhysicsProfile current;
+	enumPhysicsPhase::type activePhase = enumPhysicsPhase::NONE;
+	clock::time_point phaseStart;
+
+	mutable std::mutex publishMutex;
+	PhysicsProfile lastTick;
+	PhysicsProfile total;
+
+public:
+	static constexpr bool enabled = PHYSICS_PROFILING;
+
+	// Charges the time so far to the active phase and makes 'phase' active, returns the phase it replaced
+	enumPhysicsPhase::type switchPhase(enumPhysicsPhase::type phase) {
+		clock::time_point now = clock::now();
+		if (activePhase != enumPhysicsPhase::NONE) {
+			current.phaseSeconds[activePhase] += std::chrono::duration<double>(now - phaseStart).count();
+		}
+
+		enumPhysicsPhase::type previous = activePhase;
+		activePhase = phase;
+		phaseStart = now;
+		return previous;
+	}
+
+	void count(enumPhysicsCounter::type counter, std::uint64_t amount) {
+		current.counters[counter] += amount;
+	}
+
+	void beginTick() {
+		current = PhysicsProfile();
+		activePhase = enumPhysicsPhase::NONE;
+	}
+
+	void endTick() {
+		switchPhase(enumPhysicsPhase::NONE);
+		current.ticks = 1;
+		for (unsigned int i = 0; i < enumPhysicsCounter::COUNT; i++) {
+			current.peakCounters[i] = current.counters[i];
+		}
+
+		std::lock_guard<std::mutex> lock(publishMutex);
+		lastTick = current;
+
+		for (unsigned int i = 0; i < enumPhysicsPhase::COUNT; i++) {
+			total.phaseSeconds[i] += current.phaseSeconds[i];
+		}
+		for (unsigned int i = 0; i < enumPhysicsCounter::COUNT; i++) {
+			total.counters[i] += current.counters[i];
+			total.peakCounters[i] = std::max(total.peakCounters[i], current.counters[i]);
+		}
+		total.ticks++;
+	}
+
+	PhysicsProfile getLastTick() const {
+		std::lock_guard<std::mutex> lock(publishMutex);
+		return lastTick;
+	}
+
+	// Everything since the last reset
+	PhysicsProfile getTotal() const {
+		std::lock_guard<std::mutex> lock(publishMutex);
+		return total;
+	}
+
+	void reset() {
+		std::lock_guard<std::mutex> lock(publishMutex);
+		lastTick = PhysicsProfile();
+		total = PhysicsProfile();
+	}
+
+	static const char* getPhaseName(enumPhysicsPhase::type phase) {
+		static const char* names[enumPhysicsPhase::COUNT] = {
+			"integration", "broadphase", "narrowphase", "contactSetup", "positionSolve", "velocitySolve", "restitution", "finish"
+		};
+		return names[phase];
+	}
+
+	static const char* getCounterName(enumPhysicsCounter::type counter) {
+		static const char* names[enumPhysicsCounter::COUNT] = {
+			"pairsTested", "contactsGenerated", "speculativeContacts", "contactsDropped", "satEarlyOuts", "gjkIterations", "trianglesTested", "iterations", "continuousSweeps", "continuousImpacts"
+		};
+		return names[counter];
+	}
+};
+
+
+// Makes 'phase' active until the end of the scope, then hands back to whichever phase was active before.
+// Later scopes in the same block nest inside earlier ones, so time always goes to the innermost phase.
+class PhysicsPhaseScope {
+private:
+	PhysicsProfiler& profiler;
+	enumPhysicsPhase::type previous;
+
+public:
+	PhysicsPhaseScope(PhysicsProfiler& _profiler, enumPhysicsPhase::type phase) : profiler(_profiler) {
+		previous = profiler.switchPhase(phase);
+	}
+
+	~PhysicsPhaseScope() {
+		profiler.switchPhase(previous);
+	}
+
+	PhysicsPhaseScope(const PhysicsPhaseScope&) = delete;
+	PhysicsPhaseScope& operator=(const PhysicsPhaseScope&) = delete;
+};
+
+// Brackets a whole tick, its phases are published when the scope ends
+class PhysicsTickScope {
+private:
+	PhysicsProfiler& profiler;
+
+public:
+	PhysicsTickScope(PhysicsProfiler& _profiler) : profiler(_profiler) {
+		profiler.beginTick();
+	}
+
+	~PhysicsTickScope() {
+		profiler.endTick();
+	}
+
+	PhysicsTickScope(const PhysicsTickScope&) = delete;
+	PhysicsTickScope& operator=(const PhysicsTickScope&) = delete;
+};
+
+
+#define PHYSICS_PROFILE_JOIN_INNER(a, b) a##b
+#define PHYSICS_PROFILE_JOIN(a, b) PHYSICS_PROFILE_JOIN_INNER(a, b)
+
+#if PHYSICS_PROFILING
+#define PHYSICS_PROFILE_TICK(profiler) PhysicsTickScope PHYSICS_PROFILE_JOIN(physicsTickScope, __LINE__)(profiler)
+#define PHYSICS_PROFILE_PHASE(profiler, phase) PhysicsPhaseScope PHYSICS_PROFILE_JOIN(physicsPhaseScope, __LINE__)(profiler, phase)
+#define PHYSICS_PROFILE_COUNT(profiler, counter, amount) (profiler).count(counter, amount)
+#else
+#define PHYSICS_PROFILE_TICK(profiler) ((void)0)
+#define PHYSICS_PROFILE_PHASE(profiler, phase) ((void)0)
+#define PHYSICS_PROFILE_COUNT(profiler, counter, amount) ((void)0)
+#endif
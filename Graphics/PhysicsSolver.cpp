@@ -9,34 +9,22 @@
 #include "ECSComponents.h"
 
 
-void applyImpulse(vec3 impulse, vec3 hitpos, PhysicsComponent& physicsComp, const TransformComponent& transform) {
-    physicsComp.vel += impulse * physicsComp.invMass;
+void applyImpulse(vec3 impulse, vec3 hitpos, SolverBody& body) {
+    body.vel += impulse * body.invMass;
 
-    vec3 rad = hitpos - transform.position;
-
-    vec3 angularImpulse = cross(rad, impulse);
-    vec3 localAngularImpulse = angularImpulse * transform.rotation;
-
-    vec3 localAngVel = physicsComp.invInertia * localAngularImpulse;
-    physicsComp.angVel += transform.rotation * localAngVel;
+    vec3 rad = hitpos - body.position;
+    body.angVel += body.invInertiaWorld * cross(rad, impulse);
 }
 
-void applyAngularImpulse(vec3 angularImpulse, PhysicsComponent& physicsComp, const TransformComponent& transform) {
-    vec3 localAngularImpulse = angularImpulse * transform.rotation;
-
-    vec3 localAngVel = physicsComp.invInertia * localAngularImpulse;
-    physicsComp.angVel += transform.rotation * localAngVel;
+void applyAngularImpulse(vec3 angularImpulse, SolverBody& body) {
+    body.angVel += body.invInertiaWorld * angularImpulse;
 }
 
-void applyPositionImpulse(vec3 impulse, vec3 hitPos, const PhysicsComponent& physicsComp, TransformComponent& transform) {
-    transform.position += impulse * physicsComp.invMass;
-
-    vec3 rad = hitPos - transform.position;
-
-    vec3 rotImpulse = cross(rad, impulse);
-    vec3 localRotImpulse = rotImpulse * transform.rotation;
+void applyPositionImpulse(vec3 impulse, vec3 hitPos, SolverBody& body) {
+    vec3 rad = hitPos - body.position;
+    body.position += impulse * body.invMass;
 
-    vec3 deltaRot = physicsComp.invInertia * localRotImpulse;
+    vec3 deltaRot = body.invInertiaWorld * cross(rad, impulse);
 
     vec3 w = deltaRot * 0.5f;
     float theta = length(w);
@@ -44,204 +32,298 @@ void applyPositionImpulse(vec3 impulse, vec3 hitPos, const PhysicsComponent& phy
         w = w / theta;
     }
 
-    transform.rotation = transform.rotation * quat(cos(theta), sin(theta) * w);
+    body.rotation = quat(std::cos(theta), std::sin(theta) * w) * body.rotation;
+}
+
+
+void PhysicsSolver::buildBodies(const ECS::System& physicsSystem) {
+    bodies.build(physicsEngine->ecs, physicsSystem);
+}
+
+void PhysicsSolver::assignBodies(CollisionECS* collisions, int count) {
+    for (int i = 0; i < count; i++) {
+        collisions[i].bodyA = bodies.getBodyIndex(collisions[i].entityA);
+        collisions[i].bodyB = bodies.getBodyIndex(collisions[i].entityB);
+    }
+}
+
+void PhysicsSolver::writeBackBodies() {
+    bodies.writeBack(physicsEngine->ecs);
 }
 
 // Depenetration through Pseudo Impulse
 void PhysicsSolver::solvePosition(CollisionECS& collision) {
-    ECS::ECSManager* ecs = physicsEngine->ecs;
-
-    bool hasPhysicsA = ecs->hasComponent<PhysicsComponent>(collision.entityA);
-    bool hasPhysicsB = ecs->hasComponent<PhysicsComponent>(collision.entityB);
+    if (isStaticPair(collision)) return;
 
-    if (!hasPhysicsA && !hasPhysicsB) return;
+    SolverBody& bodyA = bodies[collision.bodyA];
+    SolverBody& bodyB = bodies[collision.bodyB];
 
     float biasSlop = physicsEngine->biasSlop;
     float biasFactor = physicsEngine->biasFactor;
 
     vec3 norm = collision.worldNormal;
 
-    float effMass = 0.f;
-    if (hasPhysicsA) {
-        auto& physics = ecs->getComponent<PhysicsComponent>(collision.entityA);
-        auto& transform = ecs->getComponent<TransformComponent>(collision.entityA);
-
-        vec3 rA = collision.pointA - transform.position;
-        effMass += calcEffectiveMass(physics, transform, cross(-rA, norm));
-    }
-    if (hasPhysicsB) {
-        auto& physics = ecs->getComponent<PhysicsComponent>(collision.entityB);
-        auto& transform = ecs->getComponent<TransformComponent>(collision.entityB);
-
-        vec3 rB = collision.pointB - transform.position;
-        effMass += calcEffectiveMass(physics, transform, cross(rB, norm));
-    }
+    vec3 rA = collision.pointA - bodyA.position;
+    vec3 rB = collision.pointB - bodyB.position;
+    float effMass = calcEffectiveMass(bodyA, cross(-rA, norm)) + calcEffectiveMass(bodyB, cross(rB, norm));
 
     // collision depth value isn't being updated upon sequential iterations
     float lambda = std::max(collision.depth - biasSlop, 0.f) * biasFactor / effMass;
     vec3 impulse = norm * lambda;
 
-    if (hasPhysicsA) {
-        auto& physics = ecs->getComponent<PhysicsComponent>(collision.entityA);
-        auto& transform = ecs->getComponent<TransformComponent>(collision.entityA);
+    // The static body is shared by every island, so it's never written to even though impulses on it are no-ops
+    if (collision.bodyA != SolverBodyCache::staticBody) applyPositionImpulse(-impulse, collision.pointA, bodyA);
+    if (collision.bodyB != SolverBodyCache::staticBody) applyPositionImpulse(impulse, collision.pointB, bodyB);
+}
+
+void PhysicsSolver::preStep(const CollisionECS* collisions, int count) {
+    constraints.clear();
+
+    for (int i = 0; i < count; i++) {
+        if (isStaticPair(collisions[i])) continue;
 
-        applyPositionImpulse(-impulse, collision.pointA, physics, transform);
+        constraints.push(makeConstraint(collisions[i], i));
     }
-    if (hasPhysicsB) {
-        auto& physics = ecs->getComponent<PhysicsComponent>(collision.entityB);
-        auto& transform = ecs->getComponent<TransformComponent>(collision.entityB);
+}
+
+void PhysicsSolver::buildConstraint(const CollisionECS& collision, int index) {
+    constraints[index] = makeConstraint(collision, index);
+}
+
+ContactConstraint PhysicsSolver::makeConstraint(const CollisionECS& collision, int collisionIndex) const {
+    const SolverBody& bodyA = bodies[collision.bodyA];
+    const SolverBody& bodyB = bodies[collision.bodyB];
+
+    ContactConstraint constraint;
+    constraint.bodyA = collision.bodyA;
+    constraint.bodyB = collision.bodyB;
+    constraint.collisionIndex = collisionIndex;
+
+    constraint.normal = collision.worldNormal;
+    calcTangents(constraint.normal, constraint.tangent1, constraint.tangent2);
+
+    constraint.rA = collision.pointA - bodyA.position;
+    constraint.rB = collision.pointB - bodyB.position;
+
+    constraint.rAxN = cross(constraint.rA, constraint.normal);
+    constraint.rBxN = cross(constraint.rB, constraint.normal);
+    constraint.rAxT1 = cross(constraint.rA, constraint.tangent1);
+    constraint.rBxT1 = cross(constraint.rB, constraint.tangent1);
+    constraint.rAxT2 = cross(constraint.rA, constraint.tangent2);
+    constraint.rBxT2 = cross(constraint.rB, constraint.tangent2);
+
+    constraint.angularA_N = bodyA.invInertiaWorld * constraint.rAxN;
+    constraint.angularB_N = bodyB.invInertiaWorld * constraint.rBxN;
+    constraint.angularA_T1 = bodyA.invInertiaWorld * constraint.rAxT1;
+    constraint.angularB_T1 = bodyB.invInertiaWorld * constraint.rBxT1;
+    constraint.angularA_T2 = bodyA.invInertiaWorld * constraint.rAxT2;
+    constraint.angularB_T2 = bodyB.invInertiaWorld * constraint.rBxT2;
+
+    constraint.invMassA = bodyA.invMass;
+    constraint.invMassB = bodyB.invMass;
+
+    float invMassSum = bodyA.invMass + bodyB.invMass;
+    constraint.normalMass = 1.f / (invMassSum + dot(constraint.rAxN, constraint.angularA_N) + dot(constraint.rBxN, constraint.angularB_N));
+    constraint.tangentMass1 = 1.f / (invMassSum + dot(constraint.rAxT1, constraint.angularA_T1) + dot(constraint.rBxT1, constraint.angularB_T1));
+    constraint.tangentMass2 = 1.f / (invMassSum + dot(constraint.rAxT2, constraint.angularA_T2) + dot(constraint.rBxT2, constraint.angularB_T2));
+
+    constraint.friction = physicsEngine->friction;
+    constraint.speculativeVelocity = std::max(-collision.depth, 0.f) / timeStep;
+    constraint.separation = -collision.depth;
+    constraint.relativeVelocity = dot(constraint.normal, bodyB.vel - bodyA.vel) + dot(constraint.rBxN, bodyB.angVel) - dot(constraint.rAxN, bodyA.angVel);
+
+    constraint.lambdaSum = collision.lambdaSum;
+    constraint.tangentLambdaSum1 = collision.tangentLambdaSum1;
+    constraint.tangentLambdaSum2 = collision.tangentLambdaSum2;
+
+    return constraint;
+}
+
+void PhysicsSolver::storeImpulses(CollisionECS* collisions) const {
+    for (int i = 0; i < constraints.getCount(); i++) {
+        const ContactConstraint& constraint = constraints[i];
+        CollisionECS& collision = collisions[constraint.collisionIndex];
 
-        applyPositionImpulse(impulse, collision.pointB, physics, transform);
+        collision.lambdaSum = constraint.lambdaSum;
+        collision.tangentLambdaSum1 = constraint.tangentLambdaSum1;
+        collision.tangentLambdaSum2 = constraint.tangentLambdaSum2;
     }
 }
 
 // Normal Impulse
-void PhysicsSolver::solveImpulse(CollisionECS& collision) {
-    ECS::ECSManager* ecs = physicsEngine->ecs;
+void PhysicsSolver::solveImpulse(ContactConstraint& constraint) {
+    SolverBody& bodyA = bodies[constraint.bodyA];
+    SolverBody& bodyB = bodies[constraint.bodyB];
 
-    bool hasPhysicsA = ecs->hasComponent<PhysicsComponent>(collision.entityA);
-    bool hasPhysicsB = ecs->hasComponent<PhysicsComponent>(collision.entityB);
+    float JV = dot(constraint.normal, bodyB.vel - bodyA.vel) + dot(constraint.rBxN, bodyB.angVel) - dot(constraint.rAxN, bodyA.angVel);
 
-    if (!hasPhysicsA && !hasPhysicsB) return;
+    // Speculative contacts only push back on whatever closing speed their gap can't absorb
+    float lambda = -(JV + constraint.speculativeVelocity) * constraint.normalMass;
+    float newSum = std::max(constraint.lambdaSum + lambda, 0.f);
+    lambda = newSum - constraint.lambdaSum;
+    constraint.lambdaSum = newSum;
 
-    vec3 norm = collision.worldNormal;
+    applyNormalImpulse(constraint, bodyA, bodyB, lambda);
+}
 
-    float JV = 0.f;
-    float effMass = 0.f;
-    if (hasPhysicsA) {
-        auto& physics = ecs->getComponent<PhysicsComponent>(collision.entityA);
-        auto& transform = ecs->getComponent<TransformComponent>(collision.entityA);
 
-        vec3 rA = collision.pointA - transform.position;
-        JV += calcRelativeVel(physics, rA, -norm);
-        effMass += calcEffectiveMass(physics, transform, cross(-rA, norm));
-    }
-    if (hasPhysicsB) {
-        auto& physics = ecs->getComponent<PhysicsComponent>(collision.entityB);
-        auto& transform = ecs->getComponent<TransformComponent>(collision.entityB);
+// Friction
+void PhysicsSolver::solveFriction(ContactConstraint& constraint) {
+    SolverBody& bodyA = bodies[constraint.bodyA];
+    SolverBody& bodyB = bodies[constraint.bodyB];
 
-        vec3 rB = collision.pointB - transform.position;
-        JV += calcRelativeVel(physics, rB, norm);
-        effMass += calcEffectiveMass(physics, transform, cross(rB, norm));
-    }
+    float maxFriction = constraint.lambdaSum * constraint.friction;
 
-    float lambda = -JV / effMass;
-    float newSum = std::max(collision.lambdaSum + lambda, 0.f);
-    lambda = newSum - collision.lambdaSum;
-    collision.lambdaSum += lambda;
+    vec3 relVel = bodyB.vel - bodyA.vel;
+    float JV1 = dot(constraint.tangent1, relVel) + dot(constraint.rBxT1, bodyB.angVel) - dot(constraint.rAxT1, bodyA.angVel);
+    float JV2 = dot(constraint.tangent2, relVel) + dot(constraint.rBxT2, bodyB.angVel) - dot(constraint.rAxT2, bodyA.angVel);
 
-    vec3 impulse = norm * lambda;
+    float tangentLambda1 = -JV1 * constraint.tangentMass1;
+    float newSum1 = std::clamp(constraint.tangentLambdaSum1 + tangentLambda1, -maxFriction, maxFriction);
+    tangentLambda1 = newSum1 - constraint.tangentLambdaSum1;
+    constraint.tangentLambdaSum1 = newSum1;
 
-    if (hasPhysicsA) {
-        auto& physics = ecs->getComponent<PhysicsComponent>(collision.entityA);
-        auto& transform = ecs->getComponent<TransformComponent>(collision.entityA);
+    float tangentLambda2 = -JV2 * constraint.tangentMass2;
+    float newSum2 = std::clamp(constraint.tangentLambdaSum2 + tangentLambda2, -maxFriction, maxFriction);
+    tangentLambda2 = newSum2 - constraint.tangentLambdaSum2;
+    constraint.tangentLambdaSum2 = newSum2;
 
-        applyImpulse(-impulse, collision.pointA, physics, transform);
-    }
-    if (hasPhysicsB) {
-        auto& physics = ecs->getComponent<PhysicsComponent>(collision.entityB);
-        auto& transform = ecs->getComponent<TransformComponent>(collision.entityB);
+    applyTangentImpulse(constraint, bodyA, bodyB, tangentLambda1, tangentLambda2);
+}
+
+void PhysicsSolver::applyRestitution(ContactConstraint& constraint) {
+    SolverBody& bodyA = bodies[constraint.bodyA];
+    SolverBody& bodyB = bodies[constraint.bodyB];
 
-        applyImpulse(impulse, collision.pointB, physics, transform);
+    float elasticity = physicsEngine->elasticity;
+    float lambda = constraint.lambdaSum * elasticity;
+
+    // A speculative contact that had to hold the bodies back left them still closing on the gap,
+    // that gets cancelled too so they bounce off at the speed they would have hit with
+    if (constraint.lambdaSum > 0.f) {
+        lambda += constraint.speculativeVelocity * constraint.normalMass * (1.f + elasticity);
     }
+
+    applyNormalImpulse(constraint, bodyA, bodyB, lambda);
 }
 
+void PhysicsSolver::warmStart(ContactConstraint& constraint) {
+    SolverBody& bodyA = bodies[constraint.bodyA];
+    SolverBody& bodyB = bodies[constraint.bodyB];
 
-// Friction
-void PhysicsSolver::solveFriction(CollisionECS& collision) {
-    ECS::ECSManager* ecs = physicsEngine->ecs;
+    applyNormalImpulse(constraint, bodyA, bodyB, constraint.lambdaSum);
+    applyTangentImpulse(constraint, bodyA, bodyB, constraint.tangentLambdaSum1, constraint.tangentLambdaSum2);
+}
 
-    bool hasPhysicsA = ecs->hasComponent<PhysicsComponent>(collision.entityA);
-    bool hasPhysicsB = ecs->hasComponent<PhysicsComponent>(collision.entityB);
+void PhysicsSolver::integrateVelocities(vec3 gravity, float substepTime) {
+    // the static body stays put
+    for (int i = 1; i < bodies.getBodyCount(); i++) {
+        bodies[i].vel += gravity * substepTime;
+    }
+}
 
-    if (!hasPhysicsA && !hasPhysicsB) return;
+void PhysicsSolver::integratePositions(float substepTime) {
+    for (int i = 1; i < bodies.getBodyCount(); i++) {
+        SolverBody& body = bodies[i];
 
-    vec3 norm = collision.worldNormal;
-    vec3 tangent1 = { -norm.y, norm.x, 0.f };
-    if (length(tangent1) == 0.f) {
-        tangent1 = { 0.f, -norm.z, norm.y };
-    }
-    tangent1 = normalize(tangent1);
-    vec3 tangent2 = cross(norm, tangent1);
-
-    float maxFriction = collision.lambdaSum * physicsEngine->friction;
-
-    float JV1 = 0.f;
-    float effMass1 = 0.f;
-    float JV2 = 0.f;
-    float effMass2 = 0.f;
-    if (hasPhysicsA) {
-        auto& physics = ecs->getComponent<PhysicsComponent>(collision.entityA);
-        auto& transform = ecs->getComponent<TransformComponent>(collision.entityA);
-
-        vec3 rA = collision.pointA - transform.position;
-        JV1 += calcRelativeVel(physics, rA, -tangent1);
-        effMass1 += calcEffectiveMass(physics, transform, cross(-rA, tangent1));
-        JV2 += calcRelativeVel(physics, rA, -tangent2);
-        effMass2 += calcEffectiveMass(physics, transform, cross(-rA, tangent2));
-    }
-    if (hasPhysicsB) {
-        auto& physics = ecs->getComponent<PhysicsComponent>(collision.entityB);
-        auto& transform = ecs->getComponent<TransformComponent>(collision.entityB);
-
-        vec3 rB = collision.pointB - transform.position;
-        JV1 += calcRelativeVel(physics, rB, tangent1);
-        effMass1 += calcEffectiveMass(physics, transform, cross(rB, tangent1));
-        JV2 += calcRelativeVel(physics, rB, tangent2);
-        effMass2 += calcEffectiveMass(physics, transform, cross(rB, tangent2));
+        vec3 step = body.vel * substepTime;
+        body.position += step;
+        body.deltaPosition += step;
+
+        quat rotationStep = deltaRotation(body.angVel, substepTime);
+        body.rotation = normalize(rotationStep * body.rotation);
+        body.deltaRotation = normalize(rotationStep * body.deltaRotation);
     }
+}
 
-    float tangentLambda1 = -JV1 / effMass1;
-    float newSum1 = std::clamp(collision.tangentLambdaSum1 + tangentLambda1, -maxFriction, maxFriction);
-    tangentLambda1 = newSum1 - collision.tangentLambdaSum1;
-    collision.tangentLambdaSum1 += tangentLambda1;
+void PhysicsSolver::solveSubstepImpulse(ContactConstraint& constraint, float substepTime, bool useBias) {
+    SolverBody& bodyA = bodies[constraint.bodyA];
+    SolverBody& bodyB = bodies[constraint.bodyB];
 
-    float tangentLambda2 = -JV2 / effMass2;
-    float newSum2 = std::clamp(collision.tangentLambdaSum2 + tangentLambda2, -maxFriction, maxFriction);
-    tangentLambda2 = newSum2 - collision.tangentLambdaSum2;
-    collision.tangentLambdaSum2 += tangentLambda2;
+    // Gap now, from how far each contact point has moved along the normal since the constraint was built
+    vec3 movedA = bodyA.deltaPosition + bodyA.deltaRotation * constraint.rA - constraint.rA;
+    vec3 movedB = bodyB.deltaPosition + bodyB.deltaRotation * constraint.rB - constraint.rB;
+    float separation = constraint.separation + dot(movedB - movedA, constraint.normal);
 
-    vec3 frictionImpulse = tangent1 * tangentLambda1 + tangent2 * tangentLambda2;
+    // Apart, the bodies may close the gap this substep. Overlapping, they're pushed out a fraction of the depth past the slop,
+    // spread over the whole step since every substep pushing out that fraction again makes stacks jitter
+    float bias = 0.f;
+    if (separation > 0.f) {
+        bias = separation / substepTime;
+    }
+    else if (useBias) {
+        bias = std::min(separation + physicsEngine->biasSlop, 0.f) * physicsEngine->biasFactor / timeStep;
+    }
 
-    if (hasPhysicsA) {
-        auto& physics = ecs->getComponent<PhysicsComponent>(collision.entityA);
-        auto& transform = ecs->getComponent<TransformComponent>(collision.entityA);
+    float JV = dot(constraint.normal, bodyB.vel - bodyA.vel) + dot(constraint.rBxN, bodyB.angVel) - dot(constraint.rAxN, bodyA.angVel);
 
-        applyImpulse(-frictionImpulse, collision.pointA, physics, transform);
-    }
-    if (hasPhysicsB) {
-        auto& physics = ecs->getComponent<PhysicsComponent>(collision.entityB);
-        auto& transform = ecs->getComponent<TransformComponent>(collision.entityB);
+    float lambda = -(JV + bias) * constraint.normalMass;
+    float newSum = std::max(constraint.lambdaSum + lambda, 0.f);
+    lambda = newSum - constraint.lambdaSum;
+    constraint.lambdaSum = newSum;
+    constraint.maxLambdaSum = std::max(constraint.maxLambdaSum, newSum);
 
-        applyImpulse(frictionImpulse, collision.pointB, physics, transform);
-    }
+    applyNormalImpulse(constraint, bodyA, bodyB, lambda);
 }
 
-void PhysicsSolver::applyRestitution(CollisionECS& collision) {
-    ECS::ECSManager* ecs = physicsEngine->ecs;
+void PhysicsSolver::applySubstepRestitution(ContactConstraint& constraint) {
+    // only contacts that were closing and pushed at some point, the relax iteration can leave them with nothing
+    if (constraint.relativeVelocity >= 0.f || constraint.maxLambdaSum == 0.f) return;
 
-    bool hasPhysicsA = ecs->hasComponent<PhysicsComponent>(collision.entityA);
-    bool hasPhysicsB = ecs->hasComponent<PhysicsComponent>(collision.entityB);
+    SolverBody& bodyA = bodies[constraint.bodyA];
+    SolverBody& bodyB = bodies[constraint.bodyB];
 
-    if (!hasPhysicsA && !hasPhysicsB) return;
+    float JV = dot(constraint.normal, bodyB.vel - bodyA.vel) + dot(constraint.rBxN, bodyB.angVel) - dot(constraint.rAxN, bodyA.angVel);
 
-    vec3 norm = collision.worldNormal;
-    float lambda = collision.lambdaSum;
+    float lambda = -(JV + constraint.relativeVelocity * physicsEngine->elasticity) * constraint.normalMass;
+    float newSum = std::max(constraint.lambdaSum + lambda, 0.f);
+    lambda = newSum - constraint.lambdaSum;
+    constraint.lambdaSum = newSum;
+
+    applyNormalImpulse(constraint, bodyA, bodyB, lambda);
+}
 
-    vec3 impulse = norm * lambda * physicsEngine->elasticity;
+void PhysicsSolver::scaleImpulses(float scale) {
+    for (int i = 0; i < constraints.getCount(); i++) {
+        ContactConstraint& constraint = constraints[i];
+        constraint.lambdaSum *= scale;
+        constraint.tangentLambdaSum1 *= scale;
+        constraint.tangentLambdaSum2 *= scale;
+    }
+}
+
+void PhysicsSolver::applyNormalImpulse(const ContactConstraint& constraint, SolverBody& bodyA, SolverBody& bodyB, float lambda) {
+    if (constraint.bodyA != SolverBodyCache::staticBody) {
+        bodyA.vel -= constraint.normal * (lambda * constraint.invMassA);
+        bodyA.angVel -= constraint.angularA_N * lambda;
+    }
+    if (constraint.bodyB != SolverBodyCache::staticBody) {
+        bodyB.vel += constraint.normal * (lambda * constraint.invMassB);
+        bodyB.angVel += constraint.angularB_N * lambda;
+    }
+}
 
-    if (hasPhysicsA) {
-        auto& physics = ecs->getComponent<PhysicsComponent>(collision.entityA);
-        auto& transform = ecs->getComponent<TransformComponent>(collision.entityA);
+void PhysicsSolver::applyTangentImpulse(const ContactConstraint& constraint, SolverBody& bodyA, SolverBody& bodyB, float lambda1, float lambda2) {
+    vec3 impulse = constraint.tangent1 * lambda1 + constraint.tangent2 * lambda2;
 
-        applyImpulse(-impulse, collision.pointA, physics, transform);
+    if (constraint.bodyA != SolverBodyCache::staticBody) {
+        bodyA.vel -= impulse * constraint.invMassA;
+        bodyA.angVel -= constraint.angularA_T1 * lambda1 + constraint.angularA_T2 * lambda2;
     }
-    if (hasPhysicsB) {
-        auto& physics = ecs->getComponent<PhysicsComponent>(collision.entityB);
-        auto& transform = ecs->getComponent<TransformComponent>(collision.entityB);
+    if (constraint.bodyB != SolverBodyCache::staticBody) {
+        bodyB.vel += impulse * constraint.invMassB;
+        bodyB.angVel += constraint.angularB_T1 * lambda1 + constraint.angularB_T2 * lambda2;
+    }
+}
 
-        applyImpulse(impulse, collision.pointB, physics, transform);
+// Tangent basis has to come out the same every tick for cached friction impulses to stay valid
+void PhysicsSolver::calcTangents(vec3 norm, vec3& tangent1, vec3& tangent2) {
+    tangent1 = { -norm.y, norm.x, 0.f };
+    if (length(tangent1) == 0.f) {
+        tangent1 = { 0.f, -norm.z, norm.y };
     }
+    tangent1 = normalize(tangent1);
+    tangent2 = cross(norm, tangent1);
 }
 
 
@@ -279,13 +361,6 @@ void PhysicsSolver::applyRestitution(CollisionECS& collision) {
 //    return JVA + JVB;
 //}
 
-float PhysicsSolver::calcRelativeVel(const PhysicsComponent& physicsComp, vec3 rad, vec3 direction) {
-    vec3 Va = physicsComp.vel;
-    vec3 Wa = physicsComp.angVel;
-
-    float JV = dot(direction, Va) + dot(cross(rad, direction), Wa);
-    return JV;
-}
 
 
 // Calculates effective mass of contact constraint
@@ -309,12 +384,8 @@ float PhysicsSolver::calcRelativeVel(const PhysicsComponent& physicsComp, vec3 r
 //    return effMassA + effMassB;
 //}
 
-float PhysicsSolver::calcEffectiveMass(const PhysicsComponent& physics, const TransformComponent& transform, vec3 radNorm) {
-    float iMa = physics.invMass;
-    mat3 iIa = physics.invInertia;
-
-
-    float effMass = iMa + dot(radNorm, transform.rotation * (iIa * radNorm * transform.rotation));
+float PhysicsSolver::calcEffectiveMass(const SolverBody& body, vec3 radNorm) {
+    float effMass = body.invMass + dot(radNorm, body.invInertiaWorld * radNorm);
     return effMass;
 }
 
@@ -2,6 +2,11 @@
 
 #include <glm/glm/glm.hpp>
 
+#include "SolverBody.h"
+#include "Collision.h"
+#include "ContactConstraint.h"
+#include "ContactArena.h"
+
 using glm::vec3;
 
 
@@ -9,25 +14,81 @@ struct PhysicsSolver {
 private:
 	struct IPhysicsEngine* physicsEngine;
 
+	SolverBodyCache bodies;
+	ContactArena<ContactConstraint> constraints;
+
+	float timeStep = 0.01f;
+
 public:
 	PhysicsSolver(IPhysicsEngine* interface) : physicsEngine(interface) {}
 
-	void solvePosition(struct CollisionECS& collision);
-	void solveImpulse(CollisionECS& collision);
-	void solveFriction(CollisionECS& collision);
-	void applyRestitution(CollisionECS& collision);
+	// Per tick setup: pull bodies out of the ECS, point contacts at them, then push results back after solving
+	void buildBodies(const ECS::System& physicsSystem);
+	void assignBodies(CollisionECS* collisions, int count);
+	void writeBackBodies();
+
+	// Step the constraints are built for, speculative contacts turn their gap into a closing speed with it
+	void setTimeStep(float _timeStep) { timeStep = _timeStep; }
+
+	SolverBodyCache& getBodies() { return bodies; }
+	const SolverBodyCache& getBodies() const { return bodies; }
+
+	void solvePosition(CollisionECS& collision);
+
+	// Builds a velocity constraint for every contact, run after the position pass has moved the bodies
+	void preStep(const CollisionECS* collisions, int count);
+
+	// Alternative to preStep where constraint n is built from contact n, so separate ranges can be built in parallel.
+	// None of the contacts may be static pairs.
+	void prepareConstraints(int count) { constraints.resize(count); }
+	void buildConstraint(const CollisionECS& collision, int index);
+	// Copies accumulated impulses back onto the contacts so they can be cached
+	void storeImpulses(CollisionECS* collisions) const;
+
+	int getConstraintCount() const { return constraints.getCount(); }
+	ContactConstraint& getConstraint(int index) { return constraints[index]; }
+	ContactArena<ContactConstraint>& getConstraints() { return constraints; }
+
+	void solveImpulse(ContactConstraint& constraint);
+	void solveFriction(ContactConstraint& constraint);
+	void applyRestitution(ContactConstraint& constraint);
+
+	// Reapplies the impulses a contact inherited from the contact cache
+	void warmStart(ContactConstraint& constraint);
+
+	// Substepping (enumStepMode::SUBSTEPS). Constraints are built once per step and each substep measures
+	// their gap again from how far the bodies have moved, so only velocities and positions change in between
+	void integrateVelocities(vec3 gravity, float substepTime);
+	void integratePositions(float substepTime);
+	// 'useBias' also pushes overlapping contacts apart, the relax iteration leaves it off to take that speed back out
+	void solveSubstepImpulse(ContactConstraint& constraint, float substepTime, bool useBias);
+	// Bounces a share of the normal velocity the contact had when it was built, once substepping is done
+	void applySubstepRestitution(ContactConstraint& constraint);
+	// Substeps each carry their share of the step's impulses, the contact cache keeps whole step ones
+	void scaleImpulses(float scale);
 
 private:
+	ContactConstraint makeConstraint(const CollisionECS& collision, int collisionIndex) const;
+
+	static void applyNormalImpulse(const ContactConstraint& constraint, SolverBody& bodyA, SolverBody& bodyB, float lambda);
+	static void applyTangentImpulse(const ContactConstraint& constraint, SolverBody& bodyA, SolverBody& bodyB, float lambda1, float lambda2);
+
+	static void calcTangents(vec3 norm, vec3& tangent1, vec3& tangent2);
+
+	// Contacts between two bodies without physics have nothing to solve
+	static bool isStaticPair(const CollisionECS& collision) {
+		return collision.bodyA == SolverBodyCache::staticBody && collision.bodyB == SolverBodyCache::staticBody;
+	}
+
 	//static float calcLambda(CollisionECS& collision);
 	//static float calcLambda(CollisionECS& collision, vec3 direction);
 
 	//static float calcRelativeVel(CollisionECS& collision);
 	//static float calcRelativeVel(const struct PhysicsComponent& physicsCompA, vec3 radA, const PhysicsComponent& physicsCompB, vec3 radB, vec3 direction);
-	static float calcRelativeVel(const struct PhysicsComponent& physicsComponent, vec3 rad, vec3 direction);
 
 	//static float calcEffectiveMass(CollisionECS& collision);
 	//static float calcEffectiveMass(const PhysicsComponent& physicsA, const TransformComponent& transformA, const PhysicsComponent& physicsB, const TransformComponent& transformB, vec3 direction);
-	static float calcEffectiveMass(const PhysicsComponent& physics, const struct TransformComponent& transform, vec3 radNorm);
+	static float calcEffectiveMass(const SolverBody& body, vec3 radNorm);
 };
 
 
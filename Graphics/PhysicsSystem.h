@@ -2,6 +2,8 @@
 
 #include "ECS.h"
 #include "ECSComponents.h"
+#include "ConvexShape.h"
+#include "CollisionSystem.h"
 
 
 class PhysicsSystem : public ECS::System {
@@ -24,6 +26,44 @@ public:
 				invInertia[1][1] = 12.f / (mass * (dimensions.x * dimensions.x + dimensions.z * dimensions.z));
 				invInertia[2][2] = 12.f / (mass * (dimensions.x * dimensions.x + dimensions.y * dimensions.y));
 				break;
+			case enumGeometry::CYLINDER: {
+				ConvexShape cylinder = ConvexShape::fromTransform(collisionComp.geometry, transformComp);
+				float r2 = cylinder.radius * cylinder.radius;
+				float height = cylinder.extents.z * 2.f;
+
+				invInertia[0][0] = 12.f / (mass * (3.f * r2 + height * height));
+				invInertia[1][1] = invInertia[0][0];
+				invInertia[2][2] = 2.f / (mass * r2);
+				break;
+			}
+			case enumGeometry::CAPSULE: {
+				// cylinder plus two hemispheres, mass split by volume
+				ConvexShape capsule = ConvexShape::fromTransform(collisionComp.geometry, transformComp);
+				float r = capsule.margin;
+				float height = capsule.extents.z * 2.f;
+
+				float cylinderVolume = r * r * height;
+				float sphereVolume = 4.f / 3.f * r * r * r;
+				float cylinderMass = mass * cylinderVolume / (cylinderVolume + sphereVolume);
+				float sphereMass = mass - cylinderMass;
+
+				float axial = cylinderMass * r * r * 0.5f + sphereMass * r * r * 0.4f;
+				float lateral = cylinderMass * (3.f * r * r + height * height) / 12.f
+					+ sphereMass * (r * r * 0.4f + height * height * 0.25f + height * r * 0.375f);
+
+				invInertia[0][0] = 1.f / lateral;
+				invInertia[1][1] = invInertia[0][0];
+				invInertia[2][2] = 1.f / axial;
+				break;
+			}
+			case enumGeometry::CONVEX_HULL:
+				invInertia = glm::inverse(manager->getSystem<CollisionSystem>()->getHull(collisionComp.shapeID).getInertia(mass, dimensions));
+				break;
+			case enumGeometry::PLANE:
+			case enumGeometry::TRIANGLE_MESH:
+				// only ever static, impulses shouldn't turn them
+				invInertia = mat3(0);
+				break;
 			case enumGeometry::SPHERE:
 				float radius = (dimensions.x + dimensions.y + dimensions.z) / 3.f; // should be the same anyway
 				invInertia *= (2 * mass * radius * radius) / 5.f;
@@ -38,6 +78,7 @@ public:
 		for (int i = 0; i < entityCount; i++) {
 			TransformComponent& transformComp = manager->getComponent<TransformComponent>(entities[i]);
 			PhysicsComponent& physicsComp = manager->getComponent<PhysicsComponent>(entities[i]);
+			if (physicsComp.isAsleep) continue;
 
 			physicsComp.vel += physicsComp.acc * deltaTime * 0.5f;
 			transformComp.position += physicsComp.vel * deltaTime;
@@ -60,14 +101,16 @@ public:
 	void applyGravity(ECS::ECSManager* manager, vec3 gravity) {
 		for (int i = 0; i < entityCount; i++) {
 			PhysicsComponent& physicsComp = manager->getComponent<PhysicsComponent>(entities[i]);
+			if (physicsComp.isAsleep) continue;
+
 			physicsComp.acc += gravity;
 		}
 	}
 
 	void kinematicFinalUpdate(ECS::ECSManager* manager, float deltaTime) {
 		for (int i = 0; i < entityCount; i++) {
-			TransformComponent& transformComp = manager->getComponent<TransformComponent>(entities[i]);
 			PhysicsComponent& physicsComp = manager->getComponent<PhysicsComponent>(entities[i]);
+			if (physicsComp.isAsleep) continue;
 
 			physicsComp.vel += physicsComp.acc * deltaTime * 0.5f;
 			physicsComp.angVel += physicsComp.angAcc * deltaTime * 0.5f;
@@ -5,6 +5,7 @@
 #include "glmAddon.h"
 
 #include "Mesh.h"
+#include "TransformSnapshot.h"
 
 
 mat4 getTransformMatrix(TransformComponent transformComponent) {
@@ -21,10 +22,16 @@ mat4 getTransformMatrix(TransformComponent transformComponent) {
 
 class RenderSystem : public ECS::System {
 public:
-	void addMeshInstances(ECS::ECSManager& manager, Mesh* meshArray) {
+	// Simulated entities are only drawn from 'snapshot', so their components are never read while the physics thread writes
+	// them. Ones it hasn't published yet are skipped. Everything else is read directly, physics never moves it.
+	// 'alpha' blends from the start of the snapshot's tick to the end
+	void addMeshInstances(ECS::ECSManager& manager, Mesh* meshArray, const TransformSnapshot* snapshot = nullptr, float alpha = 1.f) {
 		for (int i = 0; i < entityCount; i++) {
+			bool simulated = snapshot && manager.hasComponent<PhysicsComponent>(entities[i]);
+			if (simulated && !snapshot->hasTransform[entities[i]]) continue;
+
 			MeshComponent meshComp = manager.getComponent<MeshComponent>(entities[i]);
-			TransformComponent transformComp = manager.getComponent<TransformComponent>(entities[i]);
+			TransformComponent transformComp = simulated ? snapshot->interpolate(entities[i], alpha) : manager.getComponent<TransformComponent>(entities[i]);
 			MaterialComponent materialComp = manager.getComponent<MaterialComponent>(entities[i]);
 
 			mat4 transform = getTransformMatrix(transformComp);
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "ECS.h"
+#include "glmAddon.h"
+
+
+// Rays traced together down the AABB tree by raycastBatch, more amortises the walk but prunes less per ray
+#define RAYCAST_PACKET_SIZE 16
+
+
+struct Ray {
+	vec3 origin;
+	vec3 direction; // normalised by the query
+	float maxDistance;
+};
+
+struct RaycastHit {
+	ECS::uint entity = UINT8_MAX; // UINT8_MAX for a miss
+	float distance = 0.f; // along the ray, to the centre of a cast sphere
+	vec3 point = vec3(0); // on the surface that was hit
+	vec3 normal = vec3(0); // surface normal there, facing back along the ray
+
+	bool hasHit() const { return entity != UINT8_MAX; }
+};
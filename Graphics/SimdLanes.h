@@ -0,0 +1,189 @@
+#pragma once
+
+// Thin wrappers over a row of SIMD_LANES floats so the batched solver can be written once
+// and compiled against intrinsics or plain loops.
+// Every op maps to exactly one IEEE operation per lane with no fused multiply-adds,
+// which keeps SimdLanes and ScalarLanes bit-for-bit identical.
+
+#if defined(_MSC_VER)
+#define SIMD_INLINE __forceinline
+#else
+#define SIMD_INLINE inline __attribute__((always_inline))
+#endif
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SIMD_LANES 8
+#define SIMD_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <xmmintrin.h>
+#include <emmintrin.h>
+#define SIMD_LANES 4
+#define SIMD_SSE 1
+#else
+#define SIMD_LANES 4
+#endif
+
+
+struct ScalarLanes {
+	float v[SIMD_LANES];
+
+	SIMD_INLINE static ScalarLanes set1(float value) {
+		ScalarLanes r;
+		for (int i = 0; i < SIMD_LANES; i++) r.v[i] = value;
+		return r;
+	}
+
+	SIMD_INLINE static ScalarLanes load(const float* data) {
+		ScalarLanes r;
+		for (int i = 0; i < SIMD_LANES; i++) r.v[i] = data[i];
+		return r;
+	}
+
+	SIMD_INLINE void store(float* data) const {
+		for (int i = 0; i < SIMD_LANES; i++) data[i] = v[i];
+	}
+
+	// Loads rows[indices[lane]] for every lane and transposes them, out[k] holds element k of each lane's row
+	SIMD_INLINE static void loadRows(const float (*rows)[8], const int* indices, ScalarLanes out[8]) {
+		for (int i = 0; i < SIMD_LANES; i++) {
+			for (int k = 0; k < 8; k++) out[k].v[i] = rows[indices[i]][k];
+		}
+	}
+
+	// Inverse of loadRows. Lanes are written in order, so a repeated index keeps the last lane's row
+	SIMD_INLINE static void storeRows(float (*rows)[8], const int* indices, const ScalarLanes in[8]) {
+		for (int i = 0; i < SIMD_LANES; i++) {
+			for (int k = 0; k < 8; k++) rows[indices[i]][k] = in[k].v[i];
+		}
+	}
+
+	SIMD_INLINE friend ScalarLanes operator+(ScalarLanes a, ScalarLanes b) { for (int i = 0; i < SIMD_LANES; i++) a.v[i] = a.v[i] + b.v[i]; return a; }
+	SIMD_INLINE friend ScalarLanes operator-(ScalarLanes a, ScalarLanes b) { for (int i = 0; i < SIMD_LANES; i++) a.v[i] = a.v[i] - b.v[i]; return a; }
+	SIMD_INLINE friend ScalarLanes operator*(ScalarLanes a, ScalarLanes b) { for (int i = 0; i < SIMD_LANES; i++) a.v[i] = a.v[i] * b.v[i]; return a; }
+	SIMD_INLINE friend ScalarLanes operator-(ScalarLanes a) { for (int i = 0; i < SIMD_LANES; i++) a.v[i] = -a.v[i]; return a; }
+
+	// Same operand order as maxps/minps: the second operand wins ties and NaNs
+	SIMD_INLINE friend ScalarLanes max(ScalarLanes a, ScalarLanes b) { for (int i = 0; i < SIMD_LANES; i++) a.v[i] = a.v[i] > b.v[i] ? a.v[i] : b.v[i]; return a; }
+	SIMD_INLINE friend ScalarLanes min(ScalarLanes a, ScalarLanes b) { for (int i = 0; i < SIMD_LANES; i++) a.v[i] = a.v[i] < b.v[i] ? a.v[i] : b.v[i]; return a; }
+
+	// 'value' in lanes where 'test' is above zero, zero in the rest
+	SIMD_INLINE friend ScalarLanes maskPositive(ScalarLanes test, ScalarLanes value) { for (int i = 0; i < SIMD_LANES; i++) value.v[i] = test.v[i] > 0.f ? value.v[i] : 0.f; return value; }
+};
+
+
+#if defined(SIMD_AVX2)
+struct SimdLanes {
+	__m256 v;
+
+	SIMD_INLINE static SimdLanes set1(float value) { return { _mm256_set1_ps(value) }; }
+	SIMD_INLINE static SimdLanes load(const float* data) { return { _mm256_load_ps(data) }; }
+	SIMD_INLINE void store(float* data) const { _mm256_store_ps(data, v); }
+
+	SIMD_INLINE static void loadRows(const float (*rows)[8], const int* indices, SimdLanes out[8]) {
+		__m256 r[8];
+		for (int i = 0; i < 8; i++) r[i] = _mm256_load_ps(rows[indices[i]]);
+		transpose(r);
+		for (int k = 0; k < 8; k++) out[k].v = r[k];
+	}
+
+	SIMD_INLINE static void storeRows(float (*rows)[8], const int* indices, const SimdLanes in[8]) {
+		__m256 r[8];
+		for (int k = 0; k < 8; k++) r[k] = in[k].v;
+		transpose(r);
+		for (int i = 0; i < 8; i++) _mm256_store_ps(rows[indices[i]], r[i]);
+	}
+
+	// 8x8 transpose, its own inverse
+	SIMD_INLINE static void transpose(__m256 r[8]) {
+		__m256 t0 = _mm256_unpacklo_ps(r[0], r[1]);
+		__m256 t1 = _mm256_unpackhi_ps(r[0], r[1]);
+		__m256 t2 = _mm256_unpacklo_ps(r[2], r[3]);
+		__m256 t3 = _mm256_unpackhi_ps(r[2], r[3]);
+		__m256 t4 = _mm256_unpacklo_ps(r[4], r[5]);
+		__m256 t5 = _mm256_unpackhi_ps(r[4], r[5]);
+		__m256 t6 = _mm256_unpacklo_ps(r[6], r[7]);
+		__m256 t7 = _mm256_unpackhi_ps(r[6], r[7]);
+
+		__m256 s0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+		__m256 s1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+		__m256 s2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+		__m256 s3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+		__m256 s4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+		__m256 s5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+		__m256 s6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+		__m256 s7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+
+		r[0] = _mm256_permute2f128_ps(s0, s4, 0x20);
+		r[1] = _mm256_permute2f128_ps(s1, s5, 0x20);
+		r[2] = _mm256_permute2f128_ps(s2, s6, 0x20);
+		r[3] = _mm256_permute2f128_ps(s3, s7, 0x20);
+		r[4] = _mm256_permute2f128_ps(s0, s4, 0x31);
+		r[5] = _mm256_permute2f128_ps(s1, s5, 0x31);
+		r[6] = _mm256_permute2f128_ps(s2, s6, 0x31);
+		r[7] = _mm256_permute2f128_ps(s3, s7, 0x31);
+	}
+
+	SIMD_INLINE friend SimdLanes operator+(SimdLanes a, SimdLanes b) { return { _mm256_add_ps(a.v, b.v) }; }
+	SIMD_INLINE friend SimdLanes operator-(SimdLanes a, SimdLanes b) { return { _mm256_sub_ps(a.v, b.v) }; }
+	SIMD_INLINE friend SimdLanes operator*(SimdLanes a, SimdLanes b) { return { _mm256_mul_ps(a.v, b.v) }; }
+	SIMD_INLINE friend SimdLanes operator-(SimdLanes a) { return { _mm256_xor_ps(a.v, _mm256_set1_ps(-0.f)) }; }
+	SIMD_INLINE friend SimdLanes max(SimdLanes a, SimdLanes b) { return { _mm256_max_ps(a.v, b.v) }; }
+	SIMD_INLINE friend SimdLanes min(SimdLanes a, SimdLanes b) { return { _mm256_min_ps(a.v, b.v) }; }
+	SIMD_INLINE friend SimdLanes maskPositive(SimdLanes test, SimdLanes value) { return { _mm256_and_ps(_mm256_cmp_ps(test.v, _mm256_setzero_ps(), _CMP_GT_OQ), value.v) }; }
+};
+#elif defined(SIMD_SSE)
+struct SimdLanes {
+	__m128 v;
+
+	SIMD_INLINE static SimdLanes set1(float value) { return { _mm_set1_ps(value) }; }
+	SIMD_INLINE static SimdLanes load(const float* data) { return { _mm_load_ps(data) }; }
+	SIMD_INLINE void store(float* data) const { _mm_store_ps(data, v); }
+
+	// Each row is two 4 wide halves, transposed separately
+	SIMD_INLINE static void loadRows(const float (*rows)[8], const int* indices, SimdLanes out[8]) {
+		__m128 lo[4];
+		__m128 hi[4];
+		for (int i = 0; i < 4; i++) {
+			lo[i] = _mm_load_ps(rows[indices[i]]);
+			hi[i] = _mm_load_ps(rows[indices[i]] + 4);
+		}
+
+		_MM_TRANSPOSE4_PS(lo[0], lo[1], lo[2], lo[3]);
+		_MM_TRANSPOSE4_PS(hi[0], hi[1], hi[2], hi[3]);
+
+		for (int k = 0; k < 4; k++) {
+			out[k].v = lo[k];
+			out[k + 4].v = hi[k];
+		}
+	}
+
+	SIMD_INLINE static void storeRows(float (*rows)[8], const int* indices, const SimdLanes in[8]) {
+		__m128 lo[4];
+		__m128 hi[4];
+		for (int k = 0; k < 4; k++) {
+			lo[k] = in[k].v;
+			hi[k] = in[k + 4].v;
+		}
+
+		_MM_TRANSPOSE4_PS(lo[0], lo[1], lo[2], lo[3]);
+		_MM_TRANSPOSE4_PS(hi[0], hi[1], hi[2], hi[3]);
+
+		for (int i = 0; i < 4; i++) {
+			_mm_store_ps(rows[indices[i]], lo[i]);
+			_mm_store_ps(rows[indices[i]] + 4, hi[i]);
+		}
+	}
+
+	SIMD_INLINE friend SimdLanes operator+(SimdLanes a, SimdLanes b) { return { _mm_add_ps(a.v, b.v) }; }
+	SIMD_INLINE friend SimdLanes operator-(SimdLanes a, SimdLanes b) { return { _mm_sub_ps(a.v, b.v) }; }
+	SIMD_INLINE friend SimdLanes operator*(SimdLanes a, SimdLanes b) { return { _mm_mul_ps(a.v, b.v) }; }
+	SIMD_INLINE friend SimdLanes operator-(SimdLanes a) { return { _mm_xor_ps(a.v, _mm_set1_ps(-0.f)) }; }
+	SIMD_INLINE friend SimdLanes max(SimdLanes a, SimdLanes b) { return { _mm_max_ps(a.v, b.v) }; }
+	SIMD_INLINE friend SimdLanes min(SimdLanes a, SimdLanes b) { return { _mm_min_ps(a.v, b.v) }; }
+	SIMD_INLINE friend SimdLanes maskPositive(SimdLanes test, SimdLanes value) { return { _mm_and_ps(_mm_cmpgt_ps(test.v, _mm_setzero_ps()), value.v) }; }
+};
+#else
+// No vector unit to target, the intrinsics path falls back to loops
+using SimdLanes = ScalarLanes;
+#endif
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "ECS.h"
+#include "ECSComponents.h"
+#include "glmAddon.h"
+
+
+// Everything the contact solver needs from a body, pulled out of the ECS once per tick
+struct SolverBody {
+	vec3 vel = vec3(0);
+	vec3 angVel = vec3(0);
+
+	vec3 position = vec3(0);
+	quat rotation = quat(1, 0, 0, 0);
+
+	float invMass = 0.f;
+	mat3 invInertiaWorld = mat3(0);
+
+	// How far substeps have moved the body since it was built
+	vec3 deltaPosition = vec3(0);
+	quat deltaRotation = quat(1, 0, 0, 0);
+
+	ECS::uint entityID = UINT8_MAX;
+};
+
+
+// Dense array of solver bodies for every entity with physics.
+// Index 0 is a shared immovable body that anything without a PhysicsComponent maps to,
+// its zero mass and inertia turn impulses on it into no-ops so the solver never has to branch.
+class SolverBodyCache {
+public:
+	static constexpr int staticBody = 0;
+
+private:
+	int bodyCount = 1;
+	SolverBody bodies[MAX_ENTITIES + 1];
+
+	int entityToBody[MAX_ENTITIES];
+
+public:
+	SolverBodyCache() {
+		for (int i = 0; i < MAX_ENTITIES; i++) {
+			entityToBody[i] = staticBody;
+		}
+	}
+
+	// 'system' should be the physics system, whose entities all have physics and transform components.
+	// Sleeping bodies are left mapped to the static body.
+	void build(ECS::ECSManager* ecs, const ECS::System& system) {
+		for (int i = 1; i < bodyCount; i++) {
+			entityToBody[bodies[i].entityID] = staticBody;
+		}
+
+		bodies[staticBody] = SolverBody();
+		bodyCount = 1;
+
+		for (int i = 0; i < system.entityCount; i++) {
+			ECS::uint entity = system.entities[i];
+			const PhysicsComponent& physics = ecs->getComponent<PhysicsComponent>(entity);
+			if (physics.isAsleep) continue;
+
+			const TransformComponent& transform = ecs->getComponent<TransformComponent>(entity);
+
+			mat3 rotation = glm::mat3_cast(transform.rotation);
+
+			SolverBody& body = bodies[bodyCount];
+			body.vel = physics.vel;
+			body.angVel = physics.angVel;
+			body.position = transform.position;
+			body.rotation = transform.rotation;
+			body.invMass = physics.invMass;
+			body.invInertiaWorld = rotation * physics.invInertia * glm::transpose(rotation);
+			body.deltaPosition = vec3(0);
+			body.deltaRotation = quat(1, 0, 0, 0);
+			body.entityID = entity;
+
+			entityToBody[entity] = bodyCount++;
+		}
+	}
+
+	// Copies solved velocities and corrected positions back into the components
+	void writeBack(ECS::ECSManager* ecs) const {
+		for (int i = 1; i < bodyCount; i++) {
+			const SolverBody& body = bodies[i];
+			PhysicsComponent& physics = ecs->getComponent<PhysicsComponent>(body.entityID);
+			TransformComponent& transform = ecs->getComponent<TransformComponent>(body.entityID);
+
+			physics.vel = body.vel;
+			physics.angVel = body.angVel;
+			transform.position = body.position;
+			transform.rotation = normalize(body.rotation);
+		}
+	}
+
+	int getBodyIndex(ECS::uint entityID) const { return entityToBody[entityID]; }
+	int getBodyCount() const { return bodyCount; }
+
+	SolverBody& operator[](int index) { return bodies[index]; }
+	const SolverBody& operator[](int index) const { return bodies[index]; }
+};
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <algorithm>
+
+
+// Decides how many fixed steps an update runs, within a wall-clock budget.
+// When there's more debt than the budget can pay for, neighbouring steps are merged into one longer tick,
+// and whatever merging can't cover is dropped rather than carried forward, so a slow frame can't snowball.
+// Under pressure it can also hand out fewer solver iterations per tick.
+// Counters are atomics so another thread can read them while physics runs async.
+class StepScheduler {
+public:
+	// Wall-clock seconds one update may spend ticking
+	float tickBudget = 0.02f;
+	int maxTicksPerUpdate = 5;
+
+	// Steps one tick may cover, 1 turns merging off
+	int maxStepsPerTick = 2;
+
+	// Scale iterations down when the ticks due would overrun the budget, never below minIterations
+	bool adaptiveIterations = true;
+	int minIterations = 1;
+
+	struct Plan {
+		int ticks;
+		int steps; // total across every tick, at most 'maxStepsPerTick' each
+		int iterations;
+	};
+
+private:
+	float accumulatedTime = 0.f;
+
+	// smoothed cost of a tick at full iterations
+	std::atomic<float> averageTickCost = 0.f;
+
+	std::atomic<std::uint64_t> tickCount = 0;
+	std::atomic<std::uint64_t> mergedSteps = 0;
+	std::atomic<std::uint64_t> skippedSteps = 0;
+	std::atomic<float> droppedTime = 0.f;
+	std::atomic<int> lastIterations = 0;
+
+public:
+	// Adds 'deltaTime' to the debt and works out the ticks to run for it. Drops the steps it can't fit
+	Plan plan(float deltaTime, float timeStep, int iterations) {
+		accumulatedTime += deltaTime;
+
+		int stepsDue = (int)(accumulatedTime / timeStep);
+		if (stepsDue <= 0) return { 0, 0, iterations };
+
+		// Fewer iterations when the ticks due wouldn't fit the budget at full cost, assumes cost scales with iterations
+		float tickCost = averageTickCost.load(std::memory_order_relaxed);
+		int ticksWanted = std::min(stepsDue, maxTicksPerUpdate);
+		int fullIterations = iterations;
+		if (adaptiveIterations && tickCost > 0.f && ticksWanted * tickCost > tickBudget) {
+			iterations = std::max(std::min(minIterations, iterations), (int)(iterations * tickBudget / (ticksWanted * tickCost)));
+			tickCost *= (float)iterations / fullIterations;
+		}
+		lastIterations.store(iterations, std::memory_order_relaxed);
+
+		// ticks the budget can pay for going by recent cost
+		int affordable = maxTicksPerUpdate;
+		if (tickCost > 0.f) {
+			affordable = std::clamp((int)(tickBudget / tickCost), 1, maxTicksPerUpdate);
+		}
+
+		int ticks = std::min(stepsDue, affordable);
+		int stepsPerTick = std::min(std::max(1, maxStepsPerTick), (stepsDue + ticks - 1) / ticks);
+		ticks = std::min(ticks, (stepsDue + stepsPerTick - 1) / stepsPerTick);
+
+		int steps = std::min(stepsDue, ticks * stepsPerTick);
+		int skipped = stepsDue - steps;
+		if (skipped > 0) {
+			accumulatedTime -= skipped * timeStep;
+			skippedSteps.fetch_add(skipped, std::memory_order_relaxed);
+			droppedTime.store(droppedTime.load(std::memory_order_relaxed) + skipped * timeStep, std::memory_order_relaxed);
+		}
+
+		return { ticks, steps, iterations };
+	}
+
+	// Pays off 'steps' of debt with one tick that took 'seconds' at 'iterations' out of 'fullIterations'
+	void recordTick(int steps, float timeStep, float seconds, int iterations, int fullIterations) {
+		accumulatedTime -= steps * timeStep;
+
+		tickCount.fetch_add(1, std::memory_order_relaxed);
+		if (steps > 1) mergedSteps.fetch_add(steps - 1, std::memory_order_relaxed);
+
+		// cost scaled back up to full iterations, so a cheaper tick doesn't read as the pressure easing off
+		float fullCost = seconds * fullIterations / std::max(1, iterations);
+		float tickCost = averageTickCost.load(std::memory_order_relaxed);
+		averageTickCost.store(tickCost > 0.f ? tickCost + (fullCost - tickCost) * 0.1f : fullCost, std::memory_order_relaxed);
+	}
+
+	// Simulation time owed that's smaller than a step, only meaningful on the thread that ticks
+	float getPendingTime() const { return accumulatedTime; }
+
+	// Simulation time thrown away since the last reset, this is how far physics has fallen behind wall-clock
+	float getDroppedTime() const { return droppedTime.load(std::memory_order_relaxed); }
+	float getAverageTickCost() const { return averageTickCost.load(std::memory_order_relaxed); }
+	int getLastIterations() const { return lastIterations.load(std::memory_order_relaxed); }
+
+	std::uint64_t getTickCount() const { return tickCount.load(std::memory_order_relaxed); }
+	// Steps that ran folded into a longer tick
+	std::uint64_t getMergedSteps() const { return mergedSteps.load(std::memory_order_relaxed); }
+	std::uint64_t getSkippedSteps() const { return skippedSteps.load(std::memory_order_relaxed); }
+
+	void resetStats() {
+		tickCount = 0;
+		mergedSteps = 0;
+		skippedSteps = 0;
+		droppedTime = 0.f;
+	}
+};
@@ -0,0 +1,196 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <algorithm>
+
+
+// Counts outstanding jobs of one group so a caller can wait on just those
+using JobCounter = std::atomic<int>;
+
+
+// Work-stealing job pool.
+// Every worker has its own deque, it pops its newest job from the back and steals the oldest from
+// other deques' fronts when it runs dry. Threads waiting on a JobCounter run jobs instead of blocking,
+// so jobs can submit and wait on more jobs without deadlocking.
+class ThreadPool {
+private:
+	using Job = std::function<void()>;
+
+	struct QueuedJob {
+		Job job;
+		JobCounter* counter;
+	};
+
+	struct WorkQueue {
+		std::mutex mutex;
+		std::deque<QueuedJob> jobs;
+	};
+
+	std::vector<std::thread> workers;
+
+	// queue 0 takes jobs from threads outside the pool, worker n owns queue n + 1
+	std::unique_ptr<WorkQueue[]> queues;
+	int queueCount = 0;
+
+	std::atomic<int> queuedJobs = 0;
+
+	std::mutex sleepMutex;
+	std::condition_variable wakeCondition;
+	bool stopping = false;
+
+	// which pool and queue the current thread works for
+	inline static thread_local ThreadPool* currentPool = nullptr;
+	inline static thread_local int currentQueue = 0;
+
+public:
+	// Defaults to one worker per core besides the calling thread
+	ThreadPool(int workerCount = -1) {
+		if (workerCount < 0) {
+			workerCount = std::max(1, (int)std::thread::hardware_concurrency()) - 1;
+		}
+
+		queueCount = workerCount + 1;
+		queues = std::make_unique<WorkQueue[]>(queueCount);
+
+		for (int i = 0; i < workerCount; i++) {
+			workers.emplace_back([this, i]() { workerLoop(i + 1); });
+		}
+	}
+
+	~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+			stopping = true;
+		}
+		wakeCondition.notify_all();
+
+		for (std::thread& worker : workers) {
+			worker.join();
+		}
+	}
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	// Threads that take part in running jobs, including the caller
+	int getThreadCount() const { return (int)workers.size() + 1; }
+
+	// Queues 'job' on the calling thread's deque, 'counter' drops by one once it has run
+	void submit(JobCounter& counter, Job job) {
+		counter.fetch_add(1);
+
+		if (workers.empty()) {
+			job();
+			counter.fetch_sub(1);
+			return;
+		}
+
+		// counted before it's visible so the count never goes negative
+		queuedJobs.fetch_add(1);
+
+		WorkQueue& queue = queues[currentPool == this ? currentQueue : 0];
+		{
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			queue.jobs.push_back({ std::move(job), &counter });
+		}
+
+		{
+			// empty lock so a worker between its check and its wait can't miss the notify
+			std::lock_guard<std::mutex> lock(sleepMutex);
+		}
+		wakeCondition.notify_one();
+	}
+
+	// Runs queued jobs on this thread until every job counted by 'counter' has finished
+	void wait(JobCounter& counter) {
+		while (counter.load() > 0) {
+			if (!runOneJob(currentPool == this ? currentQueue : 0)) {
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	// Calls func(begin, end) over [0, count) in chunks of 'grainSize' and waits for all of them.
+	// Ranges that fit in one chunk run inline.
+	void parallelFor(int count, int grainSize, const std::function<void(int begin, int end)>& func) {
+		if (count <= 0) return;
+
+		grainSize = std::max(1, grainSize);
+		if (workers.empty() || count <= grainSize) {
+			func(0, count);
+			return;
+		}
+
+		JobCounter counter = 0;
+
+		// last chunk runs here rather than being queued
+		int lastBegin = ((count - 1) / grainSize) * grainSize;
+		for (int begin = 0; begin < lastBegin; begin += grainSize) {
+			int end = std::min(begin + grainSize, count);
+			submit(counter, [&func, begin, end]() { func(begin, end); });
+		}
+
+		func(lastBegin, count);
+		wait(counter);
+	}
+
+private:
+	bool popJob(int queueIndex, QueuedJob& out) {
+		WorkQueue& queue = queues[queueIndex];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (queue.jobs.empty()) return false;
+
+		out = std::move(queue.jobs.back());
+		queue.jobs.pop_back();
+		return true;
+	}
+
+	bool stealJob(int queueIndex, QueuedJob& out) {
+		WorkQueue& queue = queues[queueIndex];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (queue.jobs.empty()) return false;
+
+		out = std::move(queue.jobs.front());
+		queue.jobs.pop_front();
+		return true;
+	}
+
+	// Own queue first, then every other queue starting from the next one along
+	bool runOneJob(int ownQueue) {
+		if (queuedJobs.load() == 0) return false;
+
+		QueuedJob queued;
+		bool found = popJob(ownQueue, queued);
+
+		for (int i = 1; !found && i < queueCount; i++) {
+			found = stealJob((ownQueue + i) % queueCount, queued);
+		}
+
+		if (!found) return false;
+
+		queuedJobs.fetch_sub(1);
+		queued.job();
+		queued.counter->fetch_sub(1);
+		return true;
+	}
+
+	void workerLoop(int queueIndex) {
+		currentPool = this;
+		currentQueue = queueIndex;
+
+		while (true) {
+			if (runOneJob(queueIndex)) continue;
+
+			std::unique_lock<std::mutex> lock(sleepMutex);
+			wakeCondition.wait(lock, [this]() { return stopping || queuedJobs.load() > 0; });
+			if (stopping) return;
+		}
+	}
+};
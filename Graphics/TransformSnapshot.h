@@ -0,0 +1,89 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "ECS.h"
+#include "ECSComponents.h"
+
+
+// Transforms of every simulated entity from the start and end of one physics tick, indexed by entity
+struct TransformSnapshot {
+	TransformComponent transforms[MAX_ENTITIES];
+	TransformComponent previousTransforms[MAX_ENTITIES];
+	bool hasTransform[MAX_ENTITIES] = {};
+
+	// physics ticks run when this was published, 0 until the first one
+	std::uint64_t tick = 0;
+	std::chrono::steady_clock::time_point publishTime;
+	float timeStep = 1.f; // simulated time between previous and current
+
+	// Copies the transform of every entity in 'system' from before the tick runs
+	void capturePrevious(ECS::ECSManager* ecs, const ECS::System& system) {
+		for (int i = 0; i < system.entityCount; i++) {
+			ECS::uint entity = system.entities[i];
+			previousTransforms[entity] = ecs->getComponent<TransformComponent>(entity);
+		}
+	}
+
+	// Copies the transform of every entity in 'system' once the tick is done, 'system' needs transform components
+	void capture(ECS::ECSManager* ecs, const ECS::System& system, std::uint64_t tickCount, float tickTimeStep) {
+		for (int i = 0; i < MAX_ENTITIES; i++) {
+			hasTransform[i] = false;
+		}
+
+		for (int i = 0; i < system.entityCount; i++) {
+			ECS::uint entity = system.entities[i];
+			transforms[entity] = ecs->getComponent<TransformComponent>(entity);
+			hasTransform[entity] = true;
+		}
+
+		tick = tickCount;
+		timeStep = tickTimeStep;
+		publishTime = std::chrono::steady_clock::now();
+	}
+
+	// Blend from the start of the tick (alpha 0) to the end of it (alpha 1), scale isn't simulated so it isn't blended
+	TransformComponent interpolate(ECS::uint entity, float alpha) const {
+		const TransformComponent& previous = previousTransforms[entity];
+		const TransformComponent& current = transforms[entity];
+
+		return { glm::mix(previous.position, current.position, alpha), glm::slerp(previous.rotation, current.rotation, alpha), current.scale };
+	}
+};
+
+
+// Hands snapshots from one writer thread to one reader thread without either side blocking.
+// Three slots so the writer always has one to fill while the reader holds another and the
+// third carries the newest finished snapshot between them.
+class TransformSnapshotBuffer {
+private:
+	static constexpr int indexMask = 3;
+	static constexpr int freshFlag = 4;
+
+	TransformSnapshot snapshots[3];
+
+	int writeIndex = 0;
+	int readIndex = 1;
+
+	// slot of the newest finished snapshot, with freshFlag set until the reader picks it up
+	std::atomic<int> readyIndex = 2;
+
+public:
+	// Writer side, the slot to fill next
+	TransformSnapshot& getWriteSnapshot() { return snapshots[writeIndex]; }
+
+	// Writer side, hands over the filled slot and takes back whichever one was waiting
+	void publish() {
+		writeIndex = readyIndex.exchange(writeIndex | freshFlag, std::memory_order_acq_rel) & indexMask;
+	}
+
+	// Reader side, the newest published snapshot. Stays valid until the next call from the same thread
+	const TransformSnapshot& acquire() {
+		if (readyIndex.load(std::memory_order_relaxed) & freshFlag) {
+			readIndex = readyIndex.exchange(readIndex, std::memory_order_acq_rel) & indexMask;
+		}
+		return snapshots[readIndex];
+	}
+};
@@ -0,0 +1,158 @@
+#include "TriangleMesh.h"
+
+#include <algorithm>
+#include <cfloat>
+
+
+TriangleMesh TriangleMesh::build(std::vector<vec3> vertices, std::vector<unsigned int> indices) {
+	TriangleMesh mesh;
+	mesh.vertices = std::move(vertices);
+	mesh.indices = std::move(indices);
+
+	int triangleCount = mesh.getTriangleCount();
+	if (triangleCount == 0) return mesh;
+
+	std::vector<vec3> centroids(triangleCount);
+	for (int i = 0; i < triangleCount; i++) {
+		vec3 triangle[3];
+		mesh.getTriangle(i, triangle);
+		centroids[i] = (triangle[0] + triangle[1] + triangle[2]) / 3.f;
+	}
+
+	// a binary tree never needs more than 2n - 1 nodes
+	mesh.nodes.reserve(triangleCount * 2 - 1);
+	mesh.nodes.push_back({ vec3(0), 0, vec3(0), triangleCount });
+	mesh.updateNodeBounds(0);
+	mesh.subdivide(0, centroids, 0);
+
+	mesh.nodes.shrink_to_fit();
+	return mesh;
+}
+
+void TriangleMesh::updateNodeBounds(int nodeIndex) {
+	Node& node = nodes[nodeIndex];
+	node.min = vec3(FLT_MAX);
+	node.max = vec3(-FLT_MAX);
+
+	for (int i = node.leftFirst; i < node.leftFirst + node.triangleCount; i++) {
+		vec3 triangle[3];
+		getTriangle(i, triangle);
+
+		for (const vec3& vertex : triangle) {
+			node.min = glm::min(node.min, vertex);
+			node.max = glm::max(node.max, vertex);
+		}
+	}
+}
+
+void TriangleMesh::subdivide(int nodeIndex, std::vector<vec3>& centroids, int depth) {
+	int first = nodes[nodeIndex].leftFirst;
+	int count = nodes[nodeIndex].triangleCount;
+
+	// the query stack grows by one per level
+	if (count <= BVH_LEAF_TRIANGLES || depth >= BVH_MAX_DEPTH - 2) return;
+
+	AABB centroidBounds = { vec3(FLT_MAX), vec3(-FLT_MAX) };
+	for (int i = first; i < first + count; i++) {
+		centroidBounds.min = glm::min(centroidBounds.min, centroids[i]);
+		centroidBounds.max = glm::max(centroidBounds.max, centroids[i]);
+	}
+
+	struct Bin {
+		AABB bounds = { vec3(FLT_MAX), vec3(-FLT_MAX) };
+		int count = 0;
+	};
+
+	// Cheapest split between bins on any axis, cost is surface area times triangles on each side
+	int bestAxis = -1;
+	int bestSplit = 0;
+	float bestCost = FLT_MAX;
+
+	for (int axis = 0; axis < 3; axis++) {
+		float extent = centroidBounds.max[axis] - centroidBounds.min[axis];
+		if (extent <= 0.f) continue;
+
+		float binScale = BVH_SAH_BINS / extent;
+
+		Bin bins[BVH_SAH_BINS];
+		for (int i = first; i < first + count; i++) {
+			int bin = std::min((int)((centroids[i][axis] - centroidBounds.min[axis]) * binScale), BVH_SAH_BINS - 1);
+
+			vec3 triangle[3];
+			getTriangle(i, triangle);
+
+			bins[bin].count++;
+			for (const vec3& vertex : triangle) {
+				bins[bin].bounds.min = glm::min(bins[bin].bounds.min, vertex);
+				bins[bin].bounds.max = glm::max(bins[bin].bounds.max, vertex);
+			}
+		}
+
+		// sweep from both ends so every split's two sides are known
+		float leftArea[BVH_SAH_BINS - 1];
+		int leftCount[BVH_SAH_BINS - 1];
+		AABB sweep = { vec3(FLT_MAX), vec3(-FLT_MAX) };
+		int sweepCount = 0;
+		for (int i = 0; i < BVH_SAH_BINS - 1; i++) {
+			sweepCount += bins[i].count;
+			sweep = AABB::merge(sweep, bins[i].bounds);
+			leftCount[i] = sweepCount;
+			leftArea[i] = sweepCount > 0 ? sweep.getSurfaceArea() : 0.f;
+		}
+
+		sweep = { vec3(FLT_MAX), vec3(-FLT_MAX) };
+		sweepCount = 0;
+		for (int i = BVH_SAH_BINS - 1; i > 0; i--) {
+			sweepCount += bins[i].count;
+			sweep = AABB::merge(sweep, bins[i].bounds);
+
+			if (leftCount[i - 1] == 0 || sweepCount == 0) continue;
+
+			float cost = leftArea[i - 1] * leftCount[i - 1] + sweep.getSurfaceArea() * sweepCount;
+			if (cost < bestCost) {
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = i;
+			}
+		}
+	}
+
+	// Splitting has to beat testing every triangle here
+	AABB nodeBounds = { nodes[nodeIndex].min, nodes[nodeIndex].max };
+	if (bestAxis < 0 || bestCost >= nodeBounds.getSurfaceArea() * count) return;
+
+	// Partition in place, triangles left of the split go first
+	float binScale = BVH_SAH_BINS / (centroidBounds.max[bestAxis] - centroidBounds.min[bestAxis]);
+	int left = first;
+	int right = first + count - 1;
+	while (left <= right) {
+		int bin = std::min((int)((centroids[left][bestAxis] - centroidBounds.min[bestAxis]) * binScale), BVH_SAH_BINS - 1);
+
+		if (bin < bestSplit) {
+			left++;
+			continue;
+		}
+
+		std::swap(centroids[left], centroids[right]);
+		for (int k = 0; k < 3; k++) {
+			std::swap(indices[left * 3 + k], indices[right * 3 + k]);
+		}
+		right--;
+	}
+
+	int leftCount = left - first;
+	if (leftCount == 0 || leftCount == count) return;
+
+	int leftChild = (int)nodes.size();
+	nodes.push_back({ vec3(0), first, vec3(0), leftCount });
+	nodes.push_back({ vec3(0), left, vec3(0), count - leftCount });
+
+	nodes[nodeIndex].leftFirst = leftChild;
+	nodes[nodeIndex].triangleCount = 0;
+
+	updateNodeBounds(leftChild);
+	updateNodeBounds(leftChild + 1);
+
+	subdivide(leftChild, centroids, depth + 1);
+	subdivide(leftChild + 1, centroids, depth + 1);
+}
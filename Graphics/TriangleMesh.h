@@ -0,0 +1,122 @@
+#pragma once
+
+#include <vector>
+
+#include "Broadphase.h"
+#include "glmAddon.h"
+
+
+// Triangles in a leaf before splitting stops being worth it
+#define BVH_LEAF_TRIANGLES 4
+#define BVH_SAH_BINS 12
+#define BVH_MAX_DEPTH 64
+
+
+// Static triangle soup collider in the mesh's local space, for level geometry.
+// A bounding volume hierarchy built with the binned surface area heuristic keeps queries close to log(triangles).
+// Nodes live in one flat array with siblings next to each other, and triangles are reordered so each leaf's are contiguous.
+class TriangleMesh {
+public:
+	struct Node {
+		vec3 min;
+		int leftFirst; // first triangle of a leaf, left child of an inner node (the right child is leftFirst + 1)
+		vec3 max;
+		int triangleCount; // 0 for inner nodes
+
+		bool isLeaf() const { return triangleCount > 0; }
+	};
+
+	std::vector<vec3> vertices;
+	std::vector<unsigned int> indices; // 3 per triangle
+	std::vector<Node> nodes;
+
+public:
+	bool isValid() const { return !nodes.empty(); }
+
+	int getTriangleCount() const { return (int)indices.size() / 3; }
+
+	void getTriangle(int triangle, vec3 out[3]) const {
+		out[0] = vertices[indices[triangle * 3]];
+		out[1] = vertices[indices[triangle * 3 + 1]];
+		out[2] = vertices[indices[triangle * 3 + 2]];
+	}
+
+	AABB getBounds() const { return { nodes[0].min, nodes[0].max }; }
+
+	// Calls 'callback(triangle)' for every triangle whose bounds overlap 'bounds', in local space
+	template<typename Callback>
+	void queryAABB(const AABB& bounds, Callback&& callback) const {
+		if (nodes.empty()) return;
+
+		int stack[BVH_MAX_DEPTH];
+		int stackSize = 0;
+		stack[stackSize++] = 0;
+
+		while (stackSize > 0) {
+			const Node& node = nodes[stack[--stackSize]];
+
+			if (node.min.x > bounds.max.x || node.max.x < bounds.min.x
+				|| node.min.y > bounds.max.y || node.max.y < bounds.min.y
+				|| node.min.z > bounds.max.z || node.max.z < bounds.min.z) continue;
+
+			if (node.isLeaf()) {
+				for (int i = node.leftFirst; i < node.leftFirst + node.triangleCount; i++) {
+					vec3 triangle[3];
+					getTriangle(i, triangle);
+
+					vec3 triangleMin = glm::min(glm::min(triangle[0], triangle[1]), triangle[2]);
+					vec3 triangleMax = glm::max(glm::max(triangle[0], triangle[1]), triangle[2]);
+					if (bounds.overlaps({ triangleMin, triangleMax })) callback(i);
+				}
+				continue;
+			}
+
+			stack[stackSize++] = node.leftFirst;
+			stack[stackSize++] = node.leftFirst + 1;
+		}
+	}
+
+	// Calls 'callback(triangle)' for every triangle whose bounds, grown by 'radius', the segment origin + t * direction
+	// passes through for t in [0, maxDistance], in local space. The callback returns the new maxDistance,
+	// so nearest hit searches stop visiting anything behind what they've already found
+	template<typename Callback>
+	void raycast(vec3 origin, vec3 direction, float maxDistance, float radius, Callback&& callback) const {
+		if (nodes.empty()) return;
+
+		vec3 inverseDirection = AABB::getInverseDirection(direction);
+
+		int stack[BVH_MAX_DEPTH];
+		int stackSize = 0;
+		stack[stackSize++] = 0;
+
+		while (stackSize > 0) {
+			const Node& node = nodes[stack[--stackSize]];
+
+			if (!AABB{ node.min, node.max }.intersectsRay(origin, inverseDirection, maxDistance, radius)) continue;
+
+			if (node.isLeaf()) {
+				for (int i = node.leftFirst; i < node.leftFirst + node.triangleCount; i++) {
+					vec3 triangle[3];
+					getTriangle(i, triangle);
+
+					vec3 triangleMin = glm::min(glm::min(triangle[0], triangle[1]), triangle[2]);
+					vec3 triangleMax = glm::max(glm::max(triangle[0], triangle[1]), triangle[2]);
+					if (AABB{ triangleMin, triangleMax }.intersectsRay(origin, inverseDirection, maxDistance, radius)) {
+						maxDistance = callback(i);
+					}
+				}
+				continue;
+			}
+
+			stack[stackSize++] = node.leftFirst;
+			stack[stackSize++] = node.leftFirst + 1;
+		}
+	}
+
+	// Invalid mesh if there are no triangles
+	static TriangleMesh build(std::vector<vec3> vertices, std::vector<unsigned int> indices);
+
+private:
+	void updateNodeBounds(int nodeIndex);
+	void subdivide(int nodeIndex, std::vector<vec3>& centroids, int depth);
+};
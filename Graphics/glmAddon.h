@@ -3,6 +3,7 @@
 #include <glm/glm/ext.hpp>
 
 #include <iostream>
+#include <cmath>
 
 
 using glm::vec2;
@@ -13,11 +14,11 @@ using glm::mat4;
 using glm::quat;
 
 
-static void print(vec2 v) { std::cout << "x: " << v.x << ", y: " << v.y << std::endl; }
-static void print(vec3 v) { std::cout << "x: " << v.x << ", y: " << v.y << ", z: " << v.z << std::endl; }
-static void print(quat q) { std::cout << "w: " << q.w << ", x: " << q.x << ", y: " << q.y << ", z: " << q.z << std::endl; }
+inline void print(vec2 v) { std::cout << "x: " << v.x << ", y: " << v.y << std::endl; }
+inline void print(vec3 v) { std::cout << "x: " << v.x << ", y: " << v.y << ", z: " << v.z << std::endl; }
+inline void print(quat q) { std::cout << "w: " << q.w << ", x: " << q.x << ", y: " << q.y << ", z: " << q.z << std::endl; }
 
-static mat4 genViewMatrix(vec3 location, vec3 forward, vec3 worldUp) {
+inline mat4 genViewMatrix(vec3 location, vec3 forward, vec3 worldUp) {
 	vec3 zaxis = normalize(-forward);
 	vec3 xaxis = normalize(cross(normalize(worldUp), zaxis));
 	vec3 yaxis = cross(zaxis, xaxis);
@@ -36,25 +37,25 @@ static mat4 genViewMatrix(vec3 location, vec3 forward, vec3 worldUp) {
 	return rotation * translation;
 }
 
-static quat deltaRotation(vec3 angularVelocity, float deltaTime) {
+inline quat deltaRotation(vec3 angularVelocity, float deltaTime) {
 	vec3 w = angularVelocity * (deltaTime * 0.5f);
 	float theta = length(w);
 	if (theta > 0.f) {
 		w = w / theta;
 	}
-	return quat(cos(theta), sin(theta) * w);
+	return quat(std::cos(theta), std::sin(theta) * w);
 }
 
-static quat eulerToQuat(vec3 eulerDegrees) {
+inline quat eulerToQuat(vec3 eulerDegrees) {
 	vec3 euler = glm::radians(eulerDegrees);
-	quat qx = quat(cos(euler.x / 2), sin(euler.x / 2) * vec3(1, 0, 0));
-	quat qy = quat(cos(euler.y / 2), sin(euler.y / 2) * vec3(0, 1, 0));
-	quat qz = quat(cos(euler.z / 2), sin(euler.z / 2) * vec3(0, 0, 1));
+	quat qx = quat(std::cos(euler.x / 2), std::sin(euler.x / 2) * vec3(1, 0, 0));
+	quat qy = quat(std::cos(euler.y / 2), std::sin(euler.y / 2) * vec3(0, 1, 0));
+	quat qz = quat(std::cos(euler.z / 2), std::sin(euler.z / 2) * vec3(0, 0, 1));
 
 	return normalize(qx * qy * qz);
 }
 
-static mat4 getTransformMatrix(vec3 position, quat rotation, vec3 scale) {
+inline mat4 getTransformMatrix(vec3 position, quat rotation, vec3 scale) {
 	mat4 scaleMat = glm::identity<mat4>();
 	scaleMat *= vec4(scale, 1);
 
@@ -0,0 +1,160 @@
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <utility>
+
+#include "Tests.h"
+
+
+using PairSet = std::vector<std::pair<ECS::uint, ECS::uint>>;
+
+// Lower ID first and sorted, so pair lists from different broadphases compare directly.
+// Only pairs whose AABBs overlap are kept when 'overlapsOnly' is set, brute force reports every pair
+static PairSet getPairSet(const CollisionSystem& collisions, const std::vector<BroadphasePair>& pairs, bool overlapsOnly) {
+	PairSet set;
+	for (const BroadphasePair& pair : pairs) {
+		if (overlapsOnly && !collisions.getAABB(pair.entityA).overlaps(collisions.getAABB(pair.entityB))) continue;
+		set.push_back({ std::min(pair.entityA, pair.entityB), std::max(pair.entityA, pair.entityB) });
+	}
+	std::sort(set.begin(), set.end());
+	return set;
+}
+
+// Sweep and prune and the AABB tree have to find exactly the overlapping pairs brute force does, checked every
+// few ticks in every benchmark scene while bodies are moving
+TEST(broadphaseMatchesBruteForce) {
+	for (const BenchmarkScenes::Scene& scene : BenchmarkScenes::scenes) {
+		Tests::SceneFixture fixture = Tests::loadScene(scene);
+		fixture.engine->allowSleeping = false;
+		CollisionSystem* collisions = fixture.ecs->getSystem<CollisionSystem>();
+
+		for (int tick = 0; tick < 120; tick++) {
+			fixture.engine->tickPhysics();
+			if (tick % 30 != 0) continue;
+
+			collisions->broadphase = enumBroadphase::BRUTE_FORCE;
+			PairSet bruteForce = getPairSet(*collisions, collisions->findPairs(fixture.ecs.get()), true);
+
+			collisions->broadphase = enumBroadphase::SWEEP_AND_PRUNE;
+			PairSet sweepAndPrune = getPairSet(*collisions, collisions->findPairs(fixture.ecs.get()), false);
+
+			collisions->broadphase = enumBroadphase::DYNAMIC_AABB_TREE;
+			PairSet tree = getPairSet(*collisions, collisions->findPairs(fixture.ecs.get()), false);
+
+			collisions->broadphase = enumBroadphase::SWEEP_AND_PRUNE;
+
+			CHECK(!bruteForce.empty());
+			CHECK(sweepAndPrune == bruteForce);
+			CHECK(tree == bruteForce);
+		}
+	}
+}
+
+static bool sameBounds(const AABB& a, const AABB& b) {
+	return a.min == b.min && a.max == b.max;
+}
+
+// Scene queries are read only, they can't leave the broadphase's AABBs or tree any different, sleepers included
+TEST(sceneQueriesLeaveBroadphaseBounds) {
+	Tests::SceneFixture fixture = Tests::loadScene(BenchmarkScenes::scenes[0]);
+	CollisionSystem* collisions = fixture.ecs->getSystem<CollisionSystem>();
+	collisions->broadphase = enumBroadphase::DYNAMIC_AABB_TREE;
+
+	int sleeping = 0;
+	for (int tick = 0; tick < 600 && sleeping == 0; tick++) {
+		fixture.engine->tickPhysics();
+
+		sleeping = 0;
+		for (ECS::uint entity = 0; entity < MAX_ENTITIES; entity++) {
+			if (fixture.ecs->hasComponent<PhysicsComponent>(entity) && fixture.ecs->getComponent<PhysicsComponent>(entity).isAsleep) sleeping++;
+		}
+	}
+	CHECK(sleeping > 0);
+
+	AABB before[MAX_ENTITIES];
+	for (ECS::uint entity = 0; entity < MAX_ENTITIES; entity++) {
+		before[entity] = collisions->getAABB(entity);
+	}
+	int treeUpdates = collisions->getTreeUpdates();
+
+	RaycastHit hit;
+	CHECK(fixture.engine->raycast(vec3(0, 0, 20), vec3(0, 0, -1), 40.f, hit));
+	std::vector<ECS::uint> overlaps;
+	fixture.engine->overlapAABB({ vec3(-20), vec3(20) }, overlaps);
+	CHECK(!overlaps.empty());
+
+	for (ECS::uint entity = 0; entity < MAX_ENTITIES; entity++) {
+		CHECK(sameBounds(collisions->getAABB(entity), before[entity]));
+	}
+	CHECK(collisions->getTreeUpdates() == treeUpdates);
+
+	// and the broadphase carries on from where it was
+	collisions->broadphase = enumBroadphase::SWEEP_AND_PRUNE;
+	PairSet sweepAndPrune = getPairSet(*collisions, collisions->findPairs(fixture.ecs.get()), false);
+	collisions->broadphase = enumBroadphase::DYNAMIC_AABB_TREE;
+	PairSet tree = getPairSet(*collisions, collisions->findPairs(fixture.ecs.get()), false);
+	CHECK(tree == sweepAndPrune);
+}
+
+// Continuous sweeps need bounds for sleepers too, but a sleeper's broadphase AABB has to keep its margin
+TEST(continuousSweepsLeaveBroadphaseBounds) {
+	std::unique_ptr<ECS::ECSManager> ecs = Tests::makeECS();
+	std::unique_ptr<PhysicsEngine> engine = std::make_unique<PhysicsEngine>();
+	engine->setEntityComponentSystemPtr(ecs.get());
+
+	ECS::uint floor = ecs->createEntity();
+	ecs->addComponent<TransformComponent>(floor, { vec3(0), quat(1, 0, 0, 0), vec3(20, 20, 1) });
+	ecs->addComponent<CollisionComponent>(floor, { enumGeometry::PLANE });
+	ECS::uint box = BenchmarkScenes::addBody(*ecs, enumGeometry::BOX, vec3(0, 0, 0.5f), quat(1, 0, 0, 0), vec3(1), 1.f);
+	// far enough from the box to never reach it, fast enough to be swept every tick
+	ECS::uint bullet = BenchmarkScenes::addBody(*ecs, enumGeometry::SPHERE, vec3(5, -5, 3), quat(1, 0, 0, 0), vec3(0.15f), 1.f, vec3(0, 40, 0));
+	ecs->getComponent<PhysicsComponent>(bullet).continuous = true;
+	ecs->getSystem<PhysicsSystem>()->generateInertiaTensors(ecs.get());
+
+	CollisionSystem* collisions = ecs->getSystem<CollisionSystem>();
+	for (enumBroadphase::type broadphase : { enumBroadphase::SWEEP_AND_PRUNE, enumBroadphase::DYNAMIC_AABB_TREE }) {
+		collisions->broadphase = broadphase;
+		ecs->getComponent<PhysicsComponent>(box).isAsleep = false;
+		engine->tickPhysics();
+
+		ecs->getComponent<PhysicsComponent>(box).isAsleep = true;
+		engine->tickPhysics();
+
+		const AABB& padded = collisions->getAABB(box);
+		AABB tight = collisions->calcAABB(ecs->getComponent<CollisionComponent>(box), ecs->getComponent<TransformComponent>(box));
+		CHECK(tight.min.x - padded.min.x > engine->speculativeMargin * 0.5f);
+		CHECK(padded.max.z - tight.max.z > engine->speculativeMargin * 0.5f);
+	}
+}
+
+// Mesh collisions look up triangles with the body's AABB, so every broadphase has to keep them current or bodies
+// drop through the terrain onto the floor under it
+TEST(meshTerrainHoldsBodiesInEveryBroadphase) {
+	const BenchmarkScenes::Scene* terrainScene = nullptr;
+	for (const BenchmarkScenes::Scene& scene : BenchmarkScenes::scenes) {
+		if (std::string(scene.name) == "mesh_terrain") terrainScene = &scene;
+	}
+	CHECK(terrainScene);
+	if (!terrainScene) return;
+
+	for (enumBroadphase::type broadphase : { enumBroadphase::BRUTE_FORCE, enumBroadphase::SWEEP_AND_PRUNE, enumBroadphase::DYNAMIC_AABB_TREE }) {
+		Tests::SceneFixture fixture = Tests::loadScene(*terrainScene);
+		fixture.ecs->getSystem<CollisionSystem>()->broadphase = broadphase;
+
+		for (int tick = 0; tick < 300; tick++) {
+			fixture.engine->tickPhysics();
+		}
+
+		// the surface buildMeshTerrain samples, anything resting on it has its centre above it
+		int below = 0;
+		PhysicsSystem* physicsSystem = fixture.ecs->getSystem<PhysicsSystem>();
+		for (int i = 0; i < physicsSystem->entityCount; i++) {
+			vec3 position = fixture.ecs->getComponent<TransformComponent>(physicsSystem->entities[i]).position;
+			if (std::abs(position.x) > 9.5f || std::abs(position.y) > 9.5f) continue;
+
+			float height = 0.6f + 0.4f * std::sin(position.x * 0.7f) * std::cos(position.y * 0.5f);
+			if (position.z < height) below++;
+		}
+		CHECK(below == 0);
+	}
+}
@@ -0,0 +1,100 @@
+#include <cmath>
+#include <memory>
+#include <string>
+
+#include "Tests.h"
+
+
+// Bullets fired at the thin walls of the bullets scene can only leave over the top of them, however the tick is
+// stepped. 0 substeps is the iterations mode
+TEST(bulletsStayInsideWalls) {
+	const BenchmarkScenes::Scene* bulletScene = nullptr;
+	for (const BenchmarkScenes::Scene& scene : BenchmarkScenes::scenes) {
+		if (std::string(scene.name) == "bullets") bulletScene = &scene;
+	}
+	CHECK(bulletScene);
+	if (!bulletScene) return;
+
+	// the walls are 0.1 thick either side of 8 and 10 high
+	const float innerFace = 7.95f;
+	const float outerFace = 8.05f;
+	const float wallHeight = 10.f;
+
+	for (int substeps : { 0, 2, 4, 8 }) {
+		Tests::SceneFixture fixture = Tests::loadScene(*bulletScene);
+		if (substeps > 0) {
+			fixture.engine->stepMode = enumStepMode::SUBSTEPS;
+			fixture.engine->substeps = substeps;
+		}
+
+		PhysicsSystem* physicsSystem = fixture.ecs->getSystem<PhysicsSystem>();
+		bool wentOver[MAX_ENTITIES] = {};
+		int tunnelled = 0;
+
+		for (int tick = 0; tick < 300; tick++) {
+			fixture.engine->tickPhysics();
+
+			for (int i = 0; i < physicsSystem->entityCount; i++) {
+				ECS::uint entity = physicsSystem->entities[i];
+				vec3 position = fixture.ecs->getComponent<TransformComponent>(entity).position;
+				float outwards = std::max(std::abs(position.x), std::abs(position.y));
+
+				if (outwards < innerFace) wentOver[entity] = false;
+				if (position.z > wallHeight) wentOver[entity] = true;
+
+				// counted once, it's marked as having gone over from then on
+				if (outwards > outerFace && !wentOver[entity]) {
+					tunnelled++;
+					wentOver[entity] = true;
+				}
+			}
+		}
+
+		CHECK(tunnelled == 0);
+	}
+}
+
+// Thin plates tumbling into a thin wall. Their corners come round faster than they move, and the corner that hits
+// sends them spinning harder still
+TEST(spinningPlatesStayInsideWall) {
+	// a wall 0.1 thick either side of 3
+	const float outerFace = 3.05f;
+	const vec3 spinAxes[3] = { vec3(0, 1, 0), vec3(0, 0, 1), normalize(vec3(1, 1, 1)) };
+
+	for (vec3 spinAxis : spinAxes) {
+		for (float spin : { 100.f, 200.f, 300.f }) {
+			std::unique_ptr<ECS::ECSManager> ecs = Tests::makeECS();
+			std::unique_ptr<PhysicsEngine> engine = std::make_unique<PhysicsEngine>();
+			engine->setEntityComponentSystemPtr(ecs.get());
+			engine->gravity = vec3(0);
+
+			ECS::uint wall = ecs->createEntity();
+			ecs->addComponent<TransformComponent>(wall, { vec3(3, 0, 0), quat(1, 0, 0, 0), vec3(0.1f, 40, 40) });
+			ecs->addComponent<CollisionComponent>(wall, { enumGeometry::BOX });
+
+			// side by side along the wall, each tilted differently and a little faster than the last
+			ECS::uint plates[12];
+			for (int i = 0; i < 12; i++) {
+				quat rotation = eulerToQuat(vec3(i * 29.f, 90.f + i * 15.f, i * 11.f));
+				vec3 velocity = vec3(30.f + i * 2.5f, 0, 0);
+				plates[i] = BenchmarkScenes::addBody(*ecs, enumGeometry::BOX, vec3(0, i * 1.5f - 8.f, 0), rotation, vec3(0.6f, 0.6f, 0.08f), 1.f, velocity);
+
+				PhysicsComponent& physics = ecs->getComponent<PhysicsComponent>(plates[i]);
+				physics.angVel = spinAxis * spin;
+				physics.continuous = true;
+			}
+			ecs->getSystem<PhysicsSystem>()->generateInertiaTensors(ecs.get());
+
+			int tunnelled = 0;
+			for (int tick = 0; tick < 30; tick++) {
+				engine->tickPhysics();
+
+				for (ECS::uint plate : plates) {
+					if (ecs->getComponent<TransformComponent>(plate).position.x > outerFace) tunnelled++;
+				}
+			}
+
+			CHECK(tunnelled == 0);
+		}
+	}
+}
@@ -0,0 +1,87 @@
+#include <cmath>
+#include <vector>
+
+#include "Tests.h"
+#include "ConvexHull.h"
+
+
+static bool near(float a, float b, float tolerance = 1e-4f) {
+	return std::abs(a - b) <= tolerance;
+}
+
+// Corners of a cube of side 2 about 'centre', with face centres, edge midpoints and inside points quickhull has to drop
+static std::vector<vec3> getCubePoints(vec3 centre) {
+	std::vector<vec3> points;
+	for (int x = -1; x <= 1; x++) {
+		for (int y = -1; y <= 1; y++) {
+			for (int z = -1; z <= 1; z++) {
+				points.push_back(centre + vec3(x, y, z));
+				points.push_back(centre + vec3(x, y, z) * 0.5f);
+			}
+		}
+	}
+	return points;
+}
+
+TEST(quickhullCube) {
+	std::vector<vec3> points = getCubePoints(vec3(0));
+	ConvexHull hull = ConvexHull::build(points.data(), (int)points.size());
+	CHECK(hull.isValid());
+
+	CHECK(hull.vertices.size() == 8);
+	for (vec3 vertex : hull.vertices) {
+		CHECK(std::abs(vertex.x) == 1.f && std::abs(vertex.y) == 1.f && std::abs(vertex.z) == 1.f);
+	}
+
+	// two triangles per side merge into one square face, facing out
+	CHECK(hull.faces.size() == 6);
+	for (const ConvexHull::Face& face : hull.faces) {
+		CHECK(face.indexCount == 4);
+		CHECK(near(face.offset, 1.f));
+		CHECK(near(std::abs(face.normal.x) + std::abs(face.normal.y) + std::abs(face.normal.z), 1.f));
+	}
+
+	// every corner meets three edges
+	for (int i = 0; i < (int)hull.vertices.size(); i++) {
+		CHECK(hull.neighbourOffsets[i + 1] - hull.neighbourOffsets[i] == 3);
+	}
+
+	CHECK(near(hull.volume, 8.f));
+	CHECK(length(hull.centroid) < 1e-4f);
+
+	// a solid box's m (b^2 + c^2) / 12 on each axis, at any scale
+	const float mass = 3.f;
+	mat3 inertia = hull.getInertia(mass, vec3(1));
+	mat3 scaledInertia = hull.getInertia(mass, vec3(1, 2, 3));
+	vec3 size = vec3(2, 4, 6);
+	for (int row = 0; row < 3; row++) {
+		for (int column = 0; column < 3; column++) {
+			float expected = row == column ? mass * 8.f / 12.f : 0.f;
+			CHECK(near(inertia[row][column], expected));
+		}
+	}
+	CHECK(near(scaledInertia[0][0], mass * (size.y * size.y + size.z * size.z) / 12.f));
+	CHECK(near(scaledInertia[1][1], mass * (size.x * size.x + size.z * size.z) / 12.f));
+	CHECK(near(scaledInertia[2][2], mass * (size.x * size.x + size.y * size.y) / 12.f));
+}
+
+// Mass properties are about the local origin, so an off-centre cube picks up the parallel axis term
+TEST(quickhullOffsetCube) {
+	vec3 centre = vec3(3, 0, 0);
+	std::vector<vec3> points = getCubePoints(centre);
+	ConvexHull hull = ConvexHull::build(points.data(), (int)points.size());
+
+	CHECK(hull.vertices.size() == 8 && hull.faces.size() == 6);
+	CHECK(near(hull.volume, 8.f));
+	CHECK(length(hull.centroid - centre) < 1e-4f);
+
+	mat3 inertia = hull.getInertia(1.f, vec3(1));
+	CHECK(near(inertia[0][0], 8.f / 12.f));
+	CHECK(near(inertia[1][1], 8.f / 12.f + 9.f));
+	CHECK(near(inertia[2][2], 8.f / 12.f + 9.f));
+}
+
+TEST(quickhullRejectsFlatPoints) {
+	std::vector<vec3> points = { vec3(0), vec3(1, 0, 0), vec3(0, 1, 0), vec3(1, 1, 0), vec3(0.5f, 0.5f, 0) };
+	CHECK(!ConvexHull::build(points.data(), (int)points.size()).isValid());
+}
@@ -0,0 +1,90 @@
+#include <cmath>
+
+#include "Tests.h"
+#include "GJK.h"
+
+
+static bool near(float a, float b, float tolerance = 1e-3f) {
+	return std::abs(a - b) <= tolerance;
+}
+
+static bool near(vec3 a, vec3 b, float tolerance = 1e-3f) {
+	return length(a - b) <= tolerance;
+}
+
+static ConvexShape makeBox(vec3 position, quat rotation, vec3 size) {
+	return ConvexShape::fromTransform(enumGeometry::BOX, { position, rotation, size });
+}
+
+// A sphere is a point core with its radius as margin, so against a 2x2x2 box GJK gives the distance from its centre
+TEST(gjkSphereBoxDistance) {
+	ConvexShape box = makeBox(vec3(0), quat(1, 0, 0, 0), vec3(2));
+
+	// facing the +x face
+	GJKResult face = GJK::distance(ConvexShape::fromSphere(vec3(3, 0.25f, 0), 0.5f), box, vec3(0), FLT_MAX);
+	CHECK(!face.overlapping && !face.separated);
+	CHECK(near(face.distance, 2.f));
+	CHECK(near(face.pointA, vec3(3, 0.25f, 0)));
+	CHECK(near(face.pointB, vec3(1, 0.25f, 0)));
+	CHECK(near(face.normal, vec3(-1, 0, 0)));
+
+	// off the +x +y edge
+	GJKResult edge = GJK::distance(ConvexShape::fromSphere(vec3(2, 2, 0.5f), 0.5f), box, vec3(0), FLT_MAX);
+	CHECK(near(edge.distance, std::sqrt(2.f)));
+	CHECK(near(edge.pointB, vec3(1, 1, 0.5f)));
+
+	// off the + corner, from a rotated box
+	quat turned = glm::angleAxis(glm::radians(90.f), vec3(0, 0, 1));
+	GJKResult corner = GJK::distance(ConvexShape::fromSphere(vec3(3), 0.5f), makeBox(vec3(0), turned, vec3(2)), vec3(0), FLT_MAX);
+	CHECK(near(corner.distance, std::sqrt(12.f)));
+	CHECK(near(corner.pointB, vec3(1)));
+
+	// further than asked for
+	GJKResult far = GJK::distance(ConvexShape::fromSphere(vec3(10, 0, 0), 0.5f), box, vec3(0), 1.f);
+	CHECK(far.separated);
+}
+
+// With the centre inside the box the cores overlap and EPA finds the depth, radius included
+TEST(epaSphereBoxDepth) {
+	ConvexShape box = makeBox(vec3(0), quat(1, 0, 0, 0), vec3(2));
+	ConvexShape sphere = ConvexShape::fromSphere(vec3(0.1f, 0.8f, 0.2f), 0.5f);
+
+	GJKResult closest = GJK::distance(sphere, box, vec3(0), FLT_MAX);
+	CHECK(closest.overlapping);
+
+	// nearest face is +y, 0.2 from the centre
+	PenetrationResult result;
+	CHECK(GJK::penetration(sphere, box, closest.normal, result));
+	CHECK(near(result.depth, 0.7f));
+	CHECK(near(result.normal, vec3(0, -1, 0)));
+	// EPA's points come off a face of the polytope, so they're only as close as its tolerance lets them get
+	CHECK(near(result.pointA, vec3(0.1f, 0.3f, 0.2f), 5e-3f));
+	CHECK(near(result.pointB, result.pointA - result.normal * result.depth, 5e-3f));
+}
+
+// A ground plane as one big triangle at z = 0, the way mesh terrain is swept
+TEST(gjkCastOntoPlane) {
+	ConvexShape ground = ConvexShape::fromTriangle(vec3(-100, -100, 0), vec3(100, -100, 0), vec3(0, 100, 0));
+	vec3 down = vec3(0, 0, -1);
+
+	float distance;
+	vec3 normal;
+	CHECK(GJK::cast(ConvexShape::fromSphere(vec3(1, 2, 3), 0.5f), down, ground, 10.f, distance, normal));
+	CHECK(near(distance, 2.5f));
+	CHECK(near(normal, vec3(0, 0, 1)));
+
+	// edge first, its lowest point is half the diagonal below the centre
+	quat tilted = glm::angleAxis(glm::radians(45.f), vec3(1, 0, 0));
+	CHECK(GJK::cast(makeBox(vec3(0, 0, 3), tilted, vec3(1)), down, ground, 10.f, distance, normal));
+	CHECK(near(distance, 3.f - std::sqrt(0.5f)));
+	CHECK(near(normal, vec3(0, 0, 1)));
+
+	// sliding down at an angle covers more distance to drop the same height
+	vec3 slanted = normalize(vec3(1, 0, -1));
+	CHECK(GJK::cast(ConvexShape::fromSphere(vec3(0, 0, 3), 0.5f), slanted, ground, 10.f, distance, normal));
+	CHECK(near(distance, 2.5f * std::sqrt(2.f)));
+
+	// moving away, or not far enough to reach it
+	CHECK(!GJK::cast(ConvexShape::fromSphere(vec3(0, 0, 3), 0.5f), -down, ground, 10.f, distance, normal));
+	CHECK(!GJK::cast(ConvexShape::fromSphere(vec3(0, 0, 3), 0.5f), down, ground, 2.f, distance, normal));
+}
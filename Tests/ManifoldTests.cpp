@@ -0,0 +1,58 @@
+#include <cstring>
+
+#include "Tests.h"
+
+
+// No two points of one manifold may share a feature ID, they'd warm start from the same cached impulses
+static bool uniqueFeatureIDs(const ManifoldPoint* points, int count) {
+	for (int i = 0; i < count; i++) {
+		for (int n = i + 1; n < count; n++) {
+			if (points[i].featureID == points[n].featureID) return false;
+		}
+	}
+	return true;
+}
+
+// An incident quad cut by every side of a unit reference face, so original, clipped and corner points all turn up
+TEST(clippedManifoldFeatureIDsAreUnique) {
+	const vec3 reference[4] = { vec3(-1, -1, 0), vec3(1, -1, 0), vec3(1, 1, 0), vec3(-1, 1, 0) };
+	const vec3 quad[4] = { vec3(0.5f, 0.5f, -0.01f), vec3(2, 3, -0.01f), vec3(0.9f, -0.5f, -0.01f), vec3(-0.6f, -3, -0.01f) };
+
+	ManifoldPoint points[MAX_FEATURE_POINTS * 2];
+	int count = CollisionSystem::clipFeatures(reference, 4, quad, 4, vec3(0, 0, 1), 0.02f, points);
+	CHECK(count > 4);
+	CHECK(uniqueFeatureIDs(points, count));
+
+	// a cylinder cap against a smaller square, every one of its 8 points is either kept or clipped
+	vec3 cap[MAX_FEATURE_POINTS];
+	for (int i = 0; i < MAX_FEATURE_POINTS; i++) {
+		float angle = i * (glm::two_pi<float>() / MAX_FEATURE_POINTS);
+		cap[i] = vec3(std::cos(angle) * 1.2f, std::sin(angle) * 1.2f, -0.01f);
+	}
+	count = CollisionSystem::clipFeatures(cap, MAX_FEATURE_POINTS, reference, 4, vec3(0, 0, -1), 0.02f, points);
+	CHECK(count > 4);
+	CHECK(uniqueFeatureIDs(points, count));
+}
+
+// Every contact the scenes with clipped manifolds generate has its own cache entry within its pair
+TEST(sceneContactFeatureIDsAreUnique) {
+	for (const char* sceneName : { "pyramids", "mixed_pile", "convex_pile", "hull_pile", "mesh_terrain" }) {
+		const BenchmarkScenes::Scene* scene = nullptr;
+		for (const BenchmarkScenes::Scene& candidate : BenchmarkScenes::scenes) {
+			if (std::strcmp(candidate.name, sceneName) == 0) scene = &candidate;
+		}
+
+		Tests::SceneFixture fixture = Tests::loadScene(*scene);
+		int duplicates = 0;
+		for (int tick = 0; tick < 150; tick++) {
+			fixture.engine->tickPhysics();
+
+			// sorted by key, so a repeated (entityA, entityB, featureID) sits next to itself
+			const std::vector<ContactCache::Entry>& entries = fixture.engine->getContactCache().getEntries();
+			for (size_t i = 1; i < entries.size(); i++) {
+				if (entries[i].key == entries[i - 1].key) duplicates++;
+			}
+		}
+		CHECK(duplicates == 0);
+	}
+}
@@ -0,0 +1,67 @@
+#include "Tests.h"
+#include "PairCache.h"
+
+
+TEST(pairCacheKeepsStateWhileTested) {
+	PairCache cache;
+	std::uint32_t key = PairCache::makeKey(3, 7);
+	CHECK(key == PairCache::makeKey(7, 3));
+
+	cache.beginTick();
+	CHECK(cache.fetch(key).separatingAxis == PairCache::noAxis);
+	cache.fetch(PairCache::makeKey(1, 2)).separatingAxis = 4;
+
+	// more pairs than the table started with, it grows without losing any
+	cache.beginTick();
+	CHECK(cache.fetch(PairCache::makeKey(1, 2)).separatingAxis == 4);
+	for (ECS::uint i = 10; i < 110; i++) {
+		cache.fetch(PairCache::makeKey(i, i + 1)).convexDirection = vec3(i);
+	}
+
+	cache.beginTick();
+	for (ECS::uint i = 10; i < 110; i++) {
+		CHECK(cache.fetch(PairCache::makeKey(i + 1, i)).convexDirection == vec3(i));
+	}
+
+	// (1, 2) missed a tick
+	cache.beginTick();
+	CHECK(cache.fetch(PairCache::makeKey(1, 2)).separatingAxis == PairCache::noAxis);
+}
+
+TEST(pairCacheForgetsRemovedEntities) {
+	PairCache cache;
+
+	cache.beginTick();
+	cache.fetch(PairCache::makeKey(5, 6)).separatingAxis = 2;
+	cache.fetch(PairCache::makeKey(6, 8)).separatingAxis = 3;
+	cache.fetch(PairCache::makeKey(8, 9)).separatingAxis = 4;
+
+	cache.remove(6);
+
+	cache.beginTick();
+	CHECK(cache.fetch(PairCache::makeKey(5, 6)).separatingAxis == PairCache::noAxis);
+	CHECK(cache.fetch(PairCache::makeKey(6, 8)).separatingAxis == PairCache::noAxis);
+	CHECK(cache.fetch(PairCache::makeKey(8, 9)).separatingAxis == 4);
+}
+
+// Pairs come and go every tick around one that stays, stale slots get reused and rebuilds keep what's live
+TEST(pairCacheSurvivesChurn) {
+	PairCache cache;
+	std::uint32_t kept = PairCache::makeKey(1, 2);
+
+	for (ECS::uint tick = 0; tick < 50; tick++) {
+		cache.beginTick();
+		PairCache::Entry& entry = cache.fetch(kept);
+		CHECK(entry.separatingAxis == (tick == 0 ? PairCache::noAxis : 7));
+		entry.separatingAxis = 7;
+
+		// last tick's batch carries over, the one before that doesn't
+		for (ECS::uint i = 0; i < 40; i++) {
+			std::uint32_t previousKey = PairCache::makeKey(100 + tick - 1, 200 + i);
+			if (tick > 0 && i % 2 == 0) CHECK(cache.fetch(previousKey).separatingAxis == 3);
+
+			cache.fetch(PairCache::makeKey(100 + tick, 200 + i)).separatingAxis = 3;
+		}
+		if (tick > 1) CHECK(cache.fetch(PairCache::makeKey(100 + tick - 2, 201)).separatingAxis == PairCache::noAxis);
+	}
+}
@@ -0,0 +1,68 @@
+#include <cstring>
+
+#include "Tests.h"
+
+
+// Bitwise, so -0 against 0 or any last bit difference counts
+static bool sameBits(float a, float b) {
+	return std::memcmp(&a, &b, sizeof(float)) == 0;
+}
+
+static bool sameBits(vec3 a, vec3 b) {
+	return sameBits(a.x, b.x) && sameBits(a.y, b.y) && sameBits(a.z, b.z);
+}
+
+// The batched solver on SimdLanes and on ScalarLanes has to give the same accumulated impulses and bodies to the bit,
+// tick after tick, in scenes with resting stacks, mixed shapes and hulls
+TEST(simdLanesMatchScalarLanes) {
+	CHECK(BatchedSolver::hasIntrinsics());
+
+	for (const char* sceneName : { "pyramids", "mixed_pile", "hull_pile" }) {
+		const BenchmarkScenes::Scene* scene = nullptr;
+		for (const BenchmarkScenes::Scene& candidate : BenchmarkScenes::scenes) {
+			if (std::strcmp(candidate.name, sceneName) == 0) scene = &candidate;
+		}
+
+		Tests::SceneFixture simd = Tests::loadScene(*scene);
+		Tests::SceneFixture scalar = Tests::loadScene(*scene);
+		simd.engine->solverBackend = enumSolverBackend::SIMD_BATCHED;
+		scalar.engine->solverBackend = enumSolverBackend::SIMD_BATCHED_SCALAR;
+
+		PhysicsSystem* simdBodies = simd.ecs->getSystem<PhysicsSystem>();
+		PhysicsSystem* scalarBodies = scalar.ecs->getSystem<PhysicsSystem>();
+
+		int matchingTicks = 0;
+		int batchedTicks = 0;
+		for (int tick = 0; tick < 200; tick++) {
+			simd.engine->tickPhysics();
+			scalar.engine->tickPhysics();
+
+			const std::vector<ContactCache::Entry>& simdImpulses = simd.engine->getContactCache().getEntries();
+			const std::vector<ContactCache::Entry>& scalarImpulses = scalar.engine->getContactCache().getEntries();
+
+			bool same = simdImpulses.size() == scalarImpulses.size();
+			for (size_t i = 0; same && i < simdImpulses.size(); i++) {
+				const ContactCache::Entry& a = simdImpulses[i];
+				const ContactCache::Entry& b = scalarImpulses[i];
+				same = a.key == b.key && sameBits(a.lambdaSum, b.lambdaSum)
+					&& sameBits(a.tangentLambdaSum1, b.tangentLambdaSum1) && sameBits(a.tangentLambdaSum2, b.tangentLambdaSum2);
+			}
+
+			for (unsigned int i = 0; same && i < simdBodies->entityCount; i++) {
+				ECS::uint entity = simdBodies->entities[i];
+				const PhysicsComponent& a = simd.ecs->getComponent<PhysicsComponent>(entity);
+				const PhysicsComponent& b = scalar.ecs->getComponent<PhysicsComponent>(entity);
+				same = entity == scalarBodies->entities[i] && sameBits(a.vel, b.vel) && sameBits(a.angVel, b.angVel)
+					&& sameBits(simd.ecs->getComponent<TransformComponent>(entity).position, scalar.ecs->getComponent<TransformComponent>(entity).position);
+			}
+
+			// once they differ they only drift further apart, report it once
+			if (!same) break;
+			matchingTicks++;
+			if (simd.engine->getBatchedSolver().getBatchCount() > 0) batchedTicks++;
+		}
+
+		CHECK(matchingTicks == 200);
+		CHECK(batchedTicks > 0);
+	}
+}
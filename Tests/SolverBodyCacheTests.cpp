@@ -0,0 +1,81 @@
+#include "Tests.h"
+#include "SolverBody.h"
+
+
+TEST(solverBodyCacheRoundTrip) {
+	std::unique_ptr<ECS::ECSManager> ecs = Tests::makeECS();
+	quat rotation = normalize(quat(0.9f, 0.1f, 0.3f, 0.2f));
+	ECS::uint entity = BenchmarkScenes::addBody(*ecs, enumGeometry::BOX, vec3(1, 2, 3), rotation, vec3(1), 0.5f, vec3(4, 5, 6));
+
+	std::unique_ptr<SolverBodyCache> bodies = std::make_unique<SolverBodyCache>();
+	bodies->build(ecs.get(), *ecs->getSystem<PhysicsSystem>());
+
+	int index = bodies->getBodyIndex(entity);
+	CHECK(index != SolverBodyCache::staticBody);
+	CHECK(bodies->getBodyCount() == 2);
+
+	SolverBody& body = (*bodies)[index];
+	CHECK(body.entityID == entity);
+	CHECK(body.vel == vec3(4, 5, 6));
+	CHECK(body.position == vec3(1, 2, 3));
+	CHECK(body.rotation == rotation);
+	CHECK(body.invMass == 0.5f);
+
+	// what the solver would have changed
+	quat solvedRotation = normalize(quat(0.7f, 0.4f, -0.1f, 0.5f));
+	body.vel = vec3(-1, 0, 2);
+	body.angVel = vec3(0, 3, 0);
+	body.position = vec3(7, 8, 9);
+	body.rotation = solvedRotation;
+	bodies->writeBack(ecs.get());
+
+	const PhysicsComponent& physics = ecs->getComponent<PhysicsComponent>(entity);
+	const TransformComponent& transform = ecs->getComponent<TransformComponent>(entity);
+	CHECK(physics.vel == vec3(-1, 0, 2));
+	CHECK(physics.angVel == vec3(0, 3, 0));
+	CHECK(transform.position == vec3(7, 8, 9));
+	CHECK(glm::length(transform.rotation - solvedRotation) < 1e-6f);
+}
+
+TEST(solverBodyCacheStaticBodies) {
+	std::unique_ptr<ECS::ECSManager> ecs = Tests::makeECS();
+	ECS::uint floor = ecs->createEntity();
+	ecs->addComponent<TransformComponent>(floor, { vec3(0), quat(1, 0, 0, 0), vec3(20, 20, 1) });
+	ecs->addComponent<CollisionComponent>(floor, { enumGeometry::PLANE });
+	ECS::uint awake = BenchmarkScenes::addBody(*ecs, enumGeometry::SPHERE, vec3(0, 0, 1), quat(1, 0, 0, 0), vec3(1), 1.f);
+	ECS::uint asleep = BenchmarkScenes::addBody(*ecs, enumGeometry::SPHERE, vec3(0, 0, 3), quat(1, 0, 0, 0), vec3(1), 1.f);
+	ecs->getComponent<PhysicsComponent>(asleep).isAsleep = true;
+
+	std::unique_ptr<SolverBodyCache> bodies = std::make_unique<SolverBodyCache>();
+	bodies->build(ecs.get(), *ecs->getSystem<PhysicsSystem>());
+
+	CHECK(bodies->getBodyIndex(floor) == SolverBodyCache::staticBody);
+	CHECK(bodies->getBodyIndex(asleep) == SolverBodyCache::staticBody);
+	CHECK(bodies->getBodyIndex(awake) != SolverBodyCache::staticBody);
+	CHECK(bodies->getBodyCount() == 2);
+
+	// impulses on the static body have to be no-ops
+	const SolverBody& staticBody = (*bodies)[SolverBodyCache::staticBody];
+	CHECK(staticBody.invMass == 0.f);
+	CHECK(staticBody.invInertiaWorld == mat3(0));
+}
+
+TEST(solverBodyCacheResetsStaleEntries) {
+	std::unique_ptr<ECS::ECSManager> ecs = Tests::makeECS();
+	ECS::uint first = BenchmarkScenes::addBody(*ecs, enumGeometry::BOX, vec3(0, 0, 1), quat(1, 0, 0, 0), vec3(1), 1.f);
+	ECS::uint second = BenchmarkScenes::addBody(*ecs, enumGeometry::BOX, vec3(0, 0, 3), quat(1, 0, 0, 0), vec3(1), 1.f);
+
+	std::unique_ptr<SolverBodyCache> bodies = std::make_unique<SolverBodyCache>();
+	bodies->build(ecs.get(), *ecs->getSystem<PhysicsSystem>());
+	CHECK(bodies->getBodyIndex(first) != SolverBodyCache::staticBody);
+	CHECK(bodies->getBodyIndex(second) != SolverBodyCache::staticBody);
+
+	// one falls asleep, the other leaves the physics system entirely
+	ecs->getComponent<PhysicsComponent>(first).isAsleep = true;
+	ecs->destroyEntity(second);
+	bodies->build(ecs.get(), *ecs->getSystem<PhysicsSystem>());
+
+	CHECK(bodies->getBodyIndex(first) == SolverBodyCache::staticBody);
+	CHECK(bodies->getBodyIndex(second) == SolverBodyCache::staticBody);
+	CHECK(bodies->getBodyCount() == 1);
+}
@@ -0,0 +1,28 @@
+#include <cstring>
+
+#include "Tests.h"
+
+
+// Tests [name]
+// Runs every test, or just the one named, and exits non-zero if any check failed
+int main(int argc, char** argv) {
+	const char* only = argc > 1 ? argv[1] : nullptr;
+
+	int testCount = 0;
+	for (const Tests::Test& test : Tests::getTests()) {
+		if (only && std::strcmp(only, test.name) != 0) continue;
+
+		int failuresBefore = Tests::getFailureCount();
+		test.run();
+		std::printf("%s %s\n", Tests::getFailureCount() == failuresBefore ? "ok    " : "FAILED", test.name);
+		testCount++;
+	}
+
+	if (testCount == 0) {
+		std::fprintf(stderr, "unknown test '%s'\n", only);
+		return 1;
+	}
+
+	std::printf("%d tests, %d failed checks\n", testCount, Tests::getFailureCount());
+	return Tests::getFailureCount() == 0 ? 0 : 1;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+#include "BenchmarkScenes.h"
+
+
+// Just enough of a test framework to run headless. TEST registers a function, CHECK reports a failure and carries on
+namespace Tests {
+	struct Test {
+		const char* name;
+		void (*run)();
+	};
+
+	inline std::vector<Test>& getTests() {
+		static std::vector<Test> tests;
+		return tests;
+	}
+
+	inline int& getFailureCount() {
+		static int failureCount = 0;
+		return failureCount;
+	}
+
+	inline void fail(const char* file, int line, const char* condition) {
+		std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", file, line, condition);
+		getFailureCount()++;
+	}
+
+	struct Registrar {
+		Registrar(const char* name, void (*run)()) { getTests().push_back({ name, run }); }
+	};
+
+	// A fresh ECS with the physics components and systems registered, too big for the stack
+	inline std::unique_ptr<ECS::ECSManager> makeECS() {
+		std::unique_ptr<ECS::ECSManager> ecs = std::make_unique<ECS::ECSManager>();
+		BenchmarkScenes::initECS(*ecs);
+		return ecs;
+	}
+
+	// A benchmark scene built the same way Benchmark builds it, ready to tick
+	struct SceneFixture {
+		std::unique_ptr<ECS::ECSManager> ecs;
+		std::unique_ptr<PhysicsEngine> engine;
+	};
+
+	inline SceneFixture loadScene(const BenchmarkScenes::Scene& scene) {
+		SceneFixture fixture = { makeECS(), std::make_unique<PhysicsEngine>() };
+		fixture.engine->setEntityComponentSystemPtr(fixture.ecs.get());
+
+		std::mt19937 random(12345);
+		scene.build(*fixture.ecs, *fixture.engine, random);
+		fixture.ecs->getSystem<PhysicsSystem>()->generateInertiaTensors(fixture.ecs.get());
+		return fixture;
+	}
+}
+
+
+#define TEST(name) \
+	static void name(); \
+	static Tests::Registrar name##Registrar(#name, name); \
+	static void name()
+
+#define CHECK(condition) do { if (!(condition)) Tests::fail(__FILE__, __LINE__, #condition); } while (0)
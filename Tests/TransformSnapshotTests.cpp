@@ -0,0 +1,36 @@
+#include <chrono>
+#include <thread>
+
+#include "Tests.h"
+
+
+// Render never reads a simulated body's components while physics runs on its own thread, so every body has to be in
+// the first snapshot it can acquire, and the last one has to match where the thread left them
+TEST(asyncSnapshotsCoverEveryBody) {
+	Tests::SceneFixture fixture = Tests::loadScene(BenchmarkScenes::scenes[0]);
+	PhysicsSystem* physicsSystem = fixture.ecs->getSystem<PhysicsSystem>();
+	CHECK(physicsSystem->entityCount > 0);
+
+	fixture.engine->startAsync();
+	const TransformSnapshot& first = fixture.engine->acquireTransforms();
+	bool allCovered = true;
+	for (int i = 0; i < physicsSystem->entityCount; i++) {
+		allCovered &= first.hasTransform[physicsSystem->entities[i]];
+	}
+	CHECK(allCovered);
+
+	std::chrono::steady_clock::time_point giveUp = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+	while (fixture.engine->acquireTransforms().tick < 3 && std::chrono::steady_clock::now() < giveUp) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	fixture.engine->stopAsync();
+
+	const TransformSnapshot& last = fixture.engine->acquireTransforms();
+	CHECK(last.tick >= 3);
+	bool allMatch = true;
+	for (int i = 0; i < physicsSystem->entityCount; i++) {
+		ECS::uint entity = physicsSystem->entities[i];
+		allMatch &= last.hasTransform[entity] && last.transforms[entity].position == fixture.ecs->getComponent<TransformComponent>(entity).position;
+	}
+	CHECK(allMatch);
+}